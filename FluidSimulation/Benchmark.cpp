@@ -0,0 +1,359 @@
+#include "Benchmark.h"
+#include "IncompressibleSimulation.h"
+#include "Scenario.h"
+#include "FrameEncoder.h"
+#include "Snapshot.h"
+#include "Trajectory.h"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <cmath>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	// simulate a number of steps and return the wall time in seconds
+	template <typename SimulationType>
+	double simulateSteps(SimulationType& simulation, float timeStep, int steps)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (int step = 0; step < steps; ++step)
+		{
+			simulation.performSimulationStep(timeStep);
+		}
+		const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		return duration.count();
+	}
+
+	// simulate one second of physical time and return the wall time in seconds
+	double simulateOneSecond(Simulation& simulation, float timeStep)
+	{
+		return simulateSteps(simulation, timeStep, int(ceil(1.f / timeStep)));
+	}
+
+	// number of fluid particles of a simulation
+	template <typename SimulationType>
+	int countFluidParticles(const SimulationType& simulation)
+	{
+		int fluidParticles = 0;
+		for (auto& particle : simulation.getParticles())
+		{
+			if (!particle.boundary)
+			{
+				++fluidParticles;
+			}
+		}
+		return fluidParticles;
+	}
+
+	// fill the lower part of a 2D simulation with a resting column of fluid between boundary planes
+	template <typename Real, typename Accumulator>
+	void createRestingColumn(BasicSimulation<2, Real, Accumulator>& simulation, int fluid_depth)
+	{
+		using vec = glm::vec<2, Real>;
+		const Real particle_size = simulation.getParticleSize();
+		const Real width = Real(simulation.getWidth());
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<2, Real>>(vec(0, 0), vec(0, 1)));
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<2, Real>>(vec(0, 0), vec(1, 0)));
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<2, Real>>(vec(width, 0), vec(-1, 0)));
+		const int columns = int(width / particle_size);
+		for (int y = 0; y < fluid_depth; ++y)
+		{
+			for (int x = 0; x < columns; ++x)
+			{
+				const vec position = (vec(Real(x), Real(y)) + Real(0.5)) * particle_size;
+				simulation.addParticle(position, glm::vec3(0.2f, 0.2f, 0.8f), false);
+			}
+		}
+	}
+
+	// average relative density error and height of the center of mass of the fluid particles
+	template <typename Real, typename Accumulator>
+	void measureRestingColumn(const BasicSimulation<2, Real, Accumulator>& simulation, double& densityError, double& centerHeight)
+	{
+		densityError = 0;
+		centerHeight = 0;
+		int fluidParticles = 0;
+		for (auto& particle : simulation.getParticles())
+		{
+			if (!particle.boundary)
+			{
+				densityError += glm::abs(double(particle.density) / double(simulation.getFluidDensity()) - 1);
+				centerHeight += double(particle.position.y);
+				++fluidParticles;
+			}
+		}
+		densityError /= glm::max(fluidParticles, 1);
+		centerHeight /= glm::max(fluidParticles, 1);
+	}
+
+	// positions of the particles in double precision, indexed by the id of the particle
+	template <typename Real, typename Accumulator>
+	std::vector<glm::dvec2> getPositionsById(const BasicSimulation<2, Real, Accumulator>& simulation)
+	{
+		std::vector<glm::dvec2> positions(simulation.getParticles().size());
+		for (auto& particle : simulation.getParticles())
+		{
+			positions.at(particle.id) = glm::dvec2(particle.position);
+		}
+		return positions;
+	}
+
+	// draw the particles as squares in their color on a black background, like the window but without the shader
+	void drawParticles(const Simulation& simulation, int width, int height, std::vector<char>& picture_data)
+	{
+		picture_data.assign(size_t(width) * height * 3, 0);
+		const int size = glm::max(int(simulation.getParticleSize()), 1);
+		for (auto& particle : simulation.getParticles())
+		{
+			const int left = int(particle.position.x) - size / 2;
+			const int bottom = int(particle.position.y) - size / 2;
+			for (int y = glm::max(bottom, 0); y < glm::min(bottom + size, height); ++y)
+			{
+				for (int x = glm::max(left, 0); x < glm::min(left + size, width); ++x)
+				{
+					char* pixel = &picture_data[(size_t(y) * width + x) * 3];
+					pixel[0] = char(255 * particle.color[2]);
+					pixel[1] = char(255 * particle.color[1]);
+					pixel[2] = char(255 * particle.color[0]);
+				}
+			}
+		}
+	}
+
+	// simulate a resting column with one precision and print the wall time and the accuracy,
+	// the positions are compared with the positions of a reference run, return the positions by id
+	template <typename Real, typename Accumulator>
+	std::vector<glm::dvec2> runRestingColumn(IO* io, const char* name, int fluid_depth, float timeStep, int steps, const std::vector<glm::dvec2>& reference)
+	{
+		BasicIncompressibleSimulation<2, Real, Accumulator> simulation(glm::ivec2(200, 4 * fluid_depth * 8), Real(8), 1, 0, Real(9.81), io, Real(1E-4));
+		createRestingColumn(simulation, fluid_depth);
+		const double time = simulateSteps(simulation, timeStep, steps);
+		double densityError;
+		double centerHeight;
+		measureRestingColumn(simulation, densityError, centerHeight);
+
+		// mean distance of the particles to the same particles of the reference run
+		const std::vector<glm::dvec2> positions = getPositionsById(simulation);
+		double deviation = 0;
+		for (size_t id = 0; id < positions.size() && id < reference.size(); ++id)
+		{
+			deviation += glm::length(positions[id] - reference[id]);
+		}
+		deviation /= double(glm::max(positions.size(), size_t(1)));
+
+		std::cout << name << "\t" << 1000 * time / steps << " ms/step\t" << "density error " << densityError
+				  << "\t" << "center of mass height " << centerHeight << "\t" << "deviation from double " << deviation << std::endl;
+		return positions;
+	}
+}
+
+void runViscosityBenchmark(IO* io, float viscosity, float explicitTimeStep, float implicitTimeStep)
+{
+	const int width = 400;
+	const int height = 600;
+	const float particle_size = 8;
+	const int fluid_depth = 20;
+
+	IncompressibleSimulation explicitSimulation(glm::ivec2(width, height), particle_size, 1, viscosity, 9.81f, io, 1E-3f);
+	createSimulationScenario(explicitSimulation, SimulationScenario::breakingDam, fluid_depth);
+	const double explicitTime = simulateOneSecond(explicitSimulation, explicitTimeStep);
+
+	IncompressibleSimulation implicitSimulation(glm::ivec2(width, height), particle_size, 1, viscosity, 9.81f, io, 1E-3f);
+	implicitSimulation.setViscosityMethod(ViscosityComputationMethod::implicitIntegration);
+	createSimulationScenario(implicitSimulation, SimulationScenario::breakingDam, fluid_depth);
+	const double implicitTime = simulateOneSecond(implicitSimulation, implicitTimeStep);
+
+	std::cout << std::endl;
+	std::cout << "Viscosity benchmark, one second of physical time, viscosity " << viscosity << std::endl;
+	std::cout << "explicit" << "\t" << "time step " << explicitTimeStep << "\t" << explicitTime << " s" << std::endl;
+	std::cout << "implicit" << "\t" << "time step " << implicitTimeStep << "\t" << implicitTime << " s" << std::endl;
+	std::cout << "speedup" << "\t\t" << explicitTime / implicitTime << std::endl;
+}
+
+void runDimensionBenchmark(IO* io, int steps)
+{
+	const float particle_size = 8;
+	const int fluid_depth = 10;
+	const float timeStep = 0.002f;
+
+	IncompressibleSimulation planarSimulation(glm::ivec2(400, 600), particle_size, 1, 0, 9.81f, io, 1E-3f);
+	createSimulationScenario(planarSimulation, SimulationScenario::breakingDam, fluid_depth);
+	const double planarTime = simulateSteps(planarSimulation, timeStep, steps);
+	const int planarParticles = countFluidParticles(planarSimulation);
+
+	BasicIncompressibleSimulation<3> volumeSimulation(glm::ivec3(200, 300, 120), particle_size, 1, 0, 9.81f, io, 1E-3f);
+	createSimulationScenario(volumeSimulation, SimulationScenario::breakingDam, fluid_depth);
+	const double volumeTime = simulateSteps(volumeSimulation, timeStep, steps);
+	const int volumeParticles = countFluidParticles(volumeSimulation);
+
+	std::cout << std::endl;
+	std::cout << "Dimension benchmark, breaking dam, " << steps << " steps" << std::endl;
+	std::cout << "2D" << "\t" << planarParticles << " particles\t" << 1000 * planarTime / steps << " ms/step\t"
+			  << 1E6 * planarTime / (double(steps) * planarParticles) << " us/particle" << std::endl;
+	std::cout << "3D" << "\t" << volumeParticles << " particles\t" << 1000 * volumeTime / steps << " ms/step\t"
+			  << 1E6 * volumeTime / (double(steps) * volumeParticles) << " us/particle" << std::endl;
+}
+
+void runPrecisionBenchmark(IO* io, int fluid_depth, int steps)
+{
+	const float timeStep = 0.002f;
+
+	std::cout << std::endl;
+	std::cout << "Precision benchmark, resting column of " << fluid_depth << " particles, " << steps << " steps" << std::endl;
+	// the double run is the reference of the positions
+	const std::vector<glm::dvec2> reference = runRestingColumn<double, double>(io, "double", fluid_depth, timeStep, steps, {});
+	runRestingColumn<float, float>(io, "float", fluid_depth, timeStep, steps, reference);
+	runRestingColumn<float, double>(io, "float/double", fluid_depth, timeStep, steps, reference);
+}
+
+void runEncoderBenchmark(IO* io, int frames, int workers)
+{
+	const int width = 400;
+	const int height = 600;
+	const float timeStep = 0.002f;
+
+	// pictures of a breaking dam, ten steps apart
+	IncompressibleSimulation simulation(glm::ivec2(width, height), 8, 1, 0, 9.81f, io, 1E-3f);
+	createSimulationScenario(simulation, SimulationScenario::breakingDam, 20);
+	std::vector<std::vector<char>> pictures(frames);
+	for (auto& picture : pictures)
+	{
+		simulateSteps(simulation, timeStep, 10);
+		drawParticles(simulation, width, height, picture);
+	}
+	const double rawSize = double(width) * height * 3;
+
+	std::cout << std::endl;
+	std::cout << "Encoder benchmark, " << frames << " pictures of " << width << "x" << height << ", " << workers << " workers" << std::endl;
+	const char* names[] = { "TGA", "RLE TGA", "PNG", "QOI" };
+	for (int encoding = 0; encoding < 4; ++encoding)
+	{
+		const std::unique_ptr<FrameEncoder> encoder = FrameEncoder::create(static_cast<FrameEncoding>(encoding));
+
+		// one thread
+		std::vector<char> encoded;
+		double encodedSize = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (auto& picture : pictures)
+		{
+			encoder->encode(picture.data(), width, height, encoded);
+			encodedSize += double(encoded.size());
+		}
+		const std::chrono::duration<double> serialTime = std::chrono::steady_clock::now() - start;
+
+		// the workers share the pictures like the workers of the image sink
+		start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (int worker = 0; worker < workers; ++worker)
+		{
+			threads.emplace_back([&, worker]()
+			{
+				std::vector<char> result;
+				for (size_t i = worker; i < pictures.size(); i += workers)
+				{
+					encoder->encode(pictures[i].data(), width, height, result);
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		const std::chrono::duration<double> parallelTime = std::chrono::steady_clock::now() - start;
+
+		std::cout << names[encoding] << "\t" << 100 * encodedSize / (rawSize * frames) << " % of raw size\t"
+				  << frames / serialTime.count() << " pictures/s\t" << rawSize * frames / (1E6 * serialTime.count()) << " MB/s\t"
+				  << frames / parallelTime.count() << " pictures/s with the workers" << std::endl;
+	}
+}
+
+void runTrajectoryBenchmark(IO* io, int frames)
+{
+	const float particleSize = 8;
+	const float timeStep = 0.002f;
+	const int keyframeInterval = 50;
+	// error bounds of the positions in particle sizes and of the velocities in particle sizes per second
+	const double errors[][2] = { { 0.001, 0.01 }, { 0.01, 0.1 }, { 0.05, 0.5 } };
+	const int settings = 3;
+
+	IncompressibleSimulation simulation(glm::ivec2(400, 600), particleSize, 1, 0, 9.81f, io, 1E-3f);
+	createSimulationScenario(simulation, SimulationScenario::breakingDam, 20);
+	const std::string snapshotName = io->get_file_name("benchmark.flsn");
+	std::vector<std::string> trajectoryNames;
+	std::vector<std::unique_ptr<TrajectoryWriter>> trajectoryWriters;
+	for (int setting = 0; setting < settings; ++setting)
+	{
+		trajectoryNames.push_back(io->get_file_name("benchmark_" + std::to_string(setting) + ".fltr"));
+		trajectoryWriters.emplace_back(new TrajectoryWriter(trajectoryNames.back(), particleSize, errors[setting][0], errors[setting][1], keyframeInterval));
+	}
+
+	// the fluid particles of each frame ordered by their ids, to measure the errors of the decoded trajectories
+	std::vector<std::vector<Particle>> recorded(frames);
+	// the time each writer spends encoding, the settings differ in how well the values compress
+	std::vector<double> encodeTimes(settings, 0);
+	{
+		SnapshotWriter snapshotWriter(snapshotName);
+		for (auto& frame : recorded)
+		{
+			simulateSteps(simulation, timeStep, 10);
+			snapshotWriter.writeFrame(simulation.getParticles(), 0);
+			for (int setting = 0; setting < settings; ++setting)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				trajectoryWriters[setting]->writeFrame(simulation.getParticles(), 0);
+				const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+				encodeTimes[setting] += duration.count();
+			}
+
+			for (auto& particle : simulation.getParticles())
+			{
+				if (!particle.boundary)
+				{
+					frame.push_back(particle);
+				}
+			}
+			std::sort(frame.begin(), frame.end(), [](const Particle& a, const Particle& b) { return a.id < b.id; });
+		}
+	}
+	trajectoryWriters.clear();
+	const double snapshotSize = double(std::filesystem::file_size(snapshotName));
+
+	std::cout << std::endl;
+	std::cout << "Trajectory benchmark, " << frames << " frames of " << recorded.front().size() << " fluid particles, a keyframe every "
+			  << keyframeInterval << " frames" << std::endl;
+	std::cout << "snapshots	" << snapshotSize / frames << " bytes/frame" << std::endl;
+	for (int setting = 0; setting < settings; ++setting)
+	{
+		const double trajectorySize = double(std::filesystem::file_size(trajectoryNames[setting]));
+		TrajectoryReader reader(trajectoryNames[setting]);
+		double positionError = 0;
+		double velocityError = 0;
+		TrajectoryFrame decoded;
+		const auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < reader.getFrames(); ++frame)
+		{
+			if (!reader.readFrame(frame, decoded) || decoded.ids.size() != recorded[frame].size())
+			{
+				std::cout << "frame " << frame << " wasn't decoded" << std::endl;
+				return;
+			}
+			for (size_t i = 0; i < decoded.ids.size(); ++i)
+			{
+				for (int axis = 0; axis < 2; ++axis)
+				{
+					positionError = glm::max(positionError, std::abs(decoded.positions[2 * i + axis] - recorded[frame][i].position[axis]));
+					velocityError = glm::max(velocityError, std::abs(decoded.velocities[2 * i + axis] - recorded[frame][i].velocity[axis]));
+				}
+			}
+		}
+		const std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - start;
+
+		std::cout << "errors " << errors[setting][0] << "/" << errors[setting][1] << "	" << trajectorySize / frames << " bytes/frame	"
+				  << snapshotSize / trajectorySize << " times smaller	"
+				  << "largest errors " << positionError / particleSize << "/" << velocityError / particleSize << "	"
+				  << 1000 * encodeTimes[setting] / frames << " ms/frame to encode	" << 1000 * decodeTime.count() / frames << " ms/frame to decode" << std::endl;
+	}
+}
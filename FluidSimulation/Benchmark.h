@@ -0,0 +1,48 @@
+#pragma once
+#include "IO.h"
+
+/**
+ *	Simulate one second of physical time of a breaking dam with explicit and with implicit viscosity
+ *	and print the wall time of both runs
+ *	@param io io used by the simulations
+ *	@param viscosity viscosity of the fluid
+ *	@param explicitTimeStep time step of the explicit run, small enough for the explicit viscosity to be stable
+ *	@param implicitTimeStep time step of the implicit run
+ */
+void runViscosityBenchmark(IO* io, float viscosity, float explicitTimeStep, float implicitTimeStep);
+
+/**
+ *	Simulate a breaking dam in 2D and in 3D without rendering and print the wall time per step and per particle of both,
+ *	e.g. to check that the dimension-generic code keeps the 2D performance
+ *	@param io io used by the simulations
+ *	@param steps number of simulation steps of each run
+ */
+void runDimensionBenchmark(IO* io, int steps);
+
+/**
+ *	Simulate a deep resting column of fluid with float, with float particle data and double sums and with double
+ *	and print the wall time per step, the mean relative density error, the height of the center of mass of each run
+ *	and the mean distance of its particles to the particles of the double run.
+ *	The deeper the column, the larger the pressure and the more the precision of the sums matters.
+ *	@param io io used by the simulations
+ *	@param fluid_depth depth of the fluid in particles
+ *	@param steps number of simulation steps of each run
+ */
+void runPrecisionBenchmark(IO* io, int fluid_depth, int steps);
+
+/**
+ *	Encode pictures of a breaking dam with every frame encoder and print the size compared to the raw pictures
+ *	and the encoded pictures per second, with one thread and with a pool of workers
+ *	@param io io used by the simulation which creates the pictures
+ *	@param frames number of pictures
+ *	@param workers number of threads of the pool
+ */
+void runEncoderBenchmark(IO* io, int frames, int workers);
+
+/**
+ *	Record a breaking dam as snapshots and as trajectories with several error bounds and print the bytes per frame of each,
+ *	the largest errors of the decoded trajectories and the time to decode a frame
+ *	@param io io whose folder receives the files
+ *	@param frames number of frames, ten simulation steps apart
+ */
+void runTrajectoryBenchmark(IO* io, int frames);
@@ -0,0 +1,89 @@
+#include "BoundaryDensityMap.h"
+#include <cmath>
+
+template <int Dim, typename Real>
+BasicBoundaryDensityMap<Dim, Real>::BasicBoundaryDensityMap(Real spacing, ivec size)
+{
+	this->spacing = spacing;
+	unsigned int count = 1;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		nodeCounts[axis] = int(ceil(Real(size[axis]) / spacing)) + 1;
+		count *= nodeCounts[axis];
+	}
+	nodes.resize(count);
+}
+
+template <int Dim, typename Real>
+unsigned int BasicBoundaryDensityMap<Dim, Real>::getNodeCount() const
+{
+	return static_cast<unsigned int>(nodes.size());
+}
+
+template <int Dim, typename Real>
+typename Dimension<Dim, Real>::vec BasicBoundaryDensityMap<Dim, Real>::getNodePosition(unsigned int node) const
+{
+	vec position;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		position[axis] = spacing * Real(node % nodeCounts[axis]);
+		node /= nodeCounts[axis];
+	}
+	return position;
+}
+
+template <int Dim, typename Real>
+void BasicBoundaryDensityMap<Dim, Real>::setNode(unsigned int node, const BoundarySample& sample)
+{
+	nodes[node] = sample;
+}
+
+template <int Dim, typename Real>
+typename BasicBoundaryDensityMap<Dim, Real>::BoundarySample BasicBoundaryDensityMap<Dim, Real>::sample(vec position) const
+{
+	BoundarySample result;
+	if (nodes.empty())
+	{
+		return result;
+	}
+
+	// cell of the lower left node and the weights of the position inside the cell
+	ivec cell;
+	vec t;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		const Real gridPosition = glm::clamp(position[axis] / spacing, Real(0), Real(nodeCounts[axis] - 1));
+		cell[axis] = glm::min(int(gridPosition), nodeCounts[axis] - 2);
+		t[axis] = gridPosition - Real(cell[axis]);
+	}
+
+	// each bit of the corner chooses the upper node along one axis
+	for (int corner = 0; corner < (1 << Dim); ++corner)
+	{
+		Real weight = 1;
+		unsigned int node = 0;
+		unsigned int stride = 1;
+		for (int axis = 0; axis < Dim; ++axis)
+		{
+			const bool upper = (corner >> axis) & 1;
+			weight *= upper ? t[axis] : 1 - t[axis];
+			node += stride * (cell[axis] + (upper ? 1 : 0));
+			stride *= nodeCounts[axis];
+		}
+		result.density += weight * nodes[node].density;
+		result.densityGradient += weight * nodes[node].densityGradient;
+		result.gradientSquared += weight * nodes[node].gradientSquared;
+	}
+	return result;
+}
+
+template <int Dim, typename Real>
+bool BasicBoundaryDensityMap<Dim, Real>::isEmpty() const
+{
+	return nodes.empty();
+}
+
+template class BasicBoundaryDensityMap<2, float>;
+template class BasicBoundaryDensityMap<2, double>;
+template class BasicBoundaryDensityMap<3, float>;
+template class BasicBoundaryDensityMap<3, double>;
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Dimension.h"
+
+/**
+ *	Contribution of the static boundary to the density and the pressure of a fluid particle at one position
+ */
+template <int Dim, typename Real = float>
+struct BasicBoundarySample
+{
+	// density of the boundary, sum_b m_b W(x - x_b)
+	Real density = 0;
+
+	// gradient of the boundary density, sum_b m_b nabla W(x - x_b)
+	typename Dimension<Dim, Real>::vec densityGradient = typename Dimension<Dim, Real>::vec(Real(0));
+
+	// sum_b m_b^2 |nabla W(x - x_b)|^2, needed for the diagonal of the pressure system
+	Real gradientSquared = 0;
+};
+
+template <int Dim, typename Real = float>
+class BasicBoundaryDensityMap
+{
+public:
+	using vec = typename Dimension<Dim, Real>::vec;
+	using ivec = typename Dimension<Dim, Real>::ivec;
+	using BoundarySample = BasicBoundarySample<Dim, Real>;
+
+	/**
+	 *	Create an empty map, sampling it returns a sample without boundary
+	 */
+	BasicBoundaryDensityMap() = default;
+
+	/**
+	 *	Create a map with nodes on a regular grid covering the simulation space, all nodes are initialized without boundary
+	 *	@param spacing the distance between two nodes, a fraction of the particle size
+	 *	@param size the size of the simulation space along each axis
+	 */
+	BasicBoundaryDensityMap(Real spacing, ivec size);
+
+	/**
+	 *	@return the number of nodes of the map
+	 */
+	unsigned int getNodeCount() const;
+
+	/**
+	 *	@return the position of a node in the simulation space
+	 */
+	vec getNodePosition(unsigned int node) const;
+
+	/**
+	 *	Store the precomputed boundary contribution at a node
+	 */
+	void setNode(unsigned int node, const BoundarySample& sample);
+
+	/**
+	 *	Interpolate the boundary contribution linearly along each axis between the 2^Dim surrounding nodes,
+	 *	positions outside of the simulation space are clamped to its border
+	 *	@param position the position of a fluid particle
+	 *	@return the boundary contribution at the position
+	 */
+	BoundarySample sample(vec position) const;
+
+	/**
+	 *	@return true if the map has no nodes, i.e. the boundary is represented by particles
+	 */
+	bool isEmpty() const;
+
+private:
+	std::vector<BoundarySample> nodes;
+	Real spacing = 0;
+
+	// number of nodes along each axis, the first axis changes fastest in the node index
+	ivec nodeCounts = ivec(0);
+};
+
+using BoundarySample = BasicBoundarySample<2>;
+using BoundaryDensityMap = BasicBoundaryDensityMap<2>;
@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 textureCoordinates;
+
+// covered fraction of each pixel
+uniform sampler2D coverage;
+
+uniform vec3 color = vec3(0.5f, 0.5f, 0.5f);
+
+void main()
+{
+	FragColor = vec4(color, texture(coverage, textureCoordinates).r);
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "BoundaryShape.h"
+#include <cmath>
+
+template <int Dim, typename Real>
+typename Dimension<Dim, Real>::vec BasicBoundaryShape<Dim, Real>::distanceGradient(vec position) const
+{
+	const Real epsilon = Real(0.01);
+	vec gradient;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		vec d = vec(Real(0));
+		d[axis] = epsilon;
+		gradient[axis] = signedDistance(position + d) - signedDistance(position - d);
+	}
+	const Real length = glm::length(gradient);
+	return length > 0 ? gradient / length : vec(Real(0));
+}
+
+
+template <int Dim, typename Real>
+BasicBoundaryPlane<Dim, Real>::BasicBoundaryPlane(vec point, vec normal)
+{
+	this->point = point;
+	this->normal = glm::normalize(normal);
+}
+
+template <int Dim, typename Real>
+Real BasicBoundaryPlane<Dim, Real>::signedDistance(vec position) const
+{
+	return glm::dot(position - point, normal);
+}
+
+template <int Dim, typename Real>
+typename Dimension<Dim, Real>::vec BasicBoundaryPlane<Dim, Real>::distanceGradient(vec position) const
+{
+	return normal;
+}
+
+
+template <int Dim, typename Real>
+BasicBoundaryBox<Dim, Real>::BasicBoundaryBox(vec min, vec max)
+{
+	center = (min + max) / Real(2);
+	halfSize = (max - min) / Real(2);
+}
+
+template <int Dim, typename Real>
+Real BasicBoundaryBox<Dim, Real>::signedDistance(vec position) const
+{
+	// distance of the position to the box in each direction, negative inside the box
+	const vec d = glm::abs(position - center) - halfSize;
+	vec outside;
+	Real largest = d[0];
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		outside[axis] = glm::max(d[axis], Real(0));
+		largest = glm::max(largest, d[axis]);
+	}
+	return glm::length(outside) + glm::min(largest, Real(0));
+}
+
+template <int Dim, typename Real>
+typename Dimension<Dim, Real>::vec BasicBoundaryBox<Dim, Real>::distanceGradient(vec position) const
+{
+	const vec offset = position - center;
+	const vec d = glm::abs(offset) - halfSize;
+	vec gradient = vec(Real(0));
+	int nearestAxis = 0;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		// positions on a center plane of the box use the positive side
+		const Real sign = offset[axis] < 0 ? Real(-1) : Real(1);
+		gradient[axis] = sign * glm::max(d[axis], Real(0));
+		if (d[axis] > d[nearestAxis])
+		{
+			nearestAxis = axis;
+		}
+	}
+
+	// outside the box the gradient points away from the nearest point of the box, inside it points to the nearest face
+	const Real length = glm::length(gradient);
+	if (length > 0)
+	{
+		return gradient / length;
+	}
+	gradient[nearestAxis] = offset[nearestAxis] < 0 ? Real(-1) : Real(1);
+	return gradient;
+}
+
+
+template <int Dim, typename Real>
+BasicBoundarySegment<Dim, Real>::BasicBoundarySegment(vec start, vec end, Real thickness)
+{
+	this->start = start;
+	this->end = end;
+	this->radius = thickness / 2;
+}
+
+template <int Dim, typename Real>
+Real BasicBoundarySegment<Dim, Real>::signedDistance(vec position) const
+{
+	// distance to the nearest point of the center line minus the half thickness
+	const vec direction = end - start;
+	const Real t = glm::clamp(glm::dot(position - start, direction) / glm::dot(direction, direction), Real(0), Real(1));
+	return glm::distance(position, start + t * direction) - radius;
+}
+
+template <int Dim, typename Real>
+typename Dimension<Dim, Real>::vec BasicBoundarySegment<Dim, Real>::distanceGradient(vec position) const
+{
+	// direction from the nearest point of the center line, undefined on the center line itself
+	const vec direction = end - start;
+	const Real t = glm::clamp(glm::dot(position - start, direction) / glm::dot(direction, direction), Real(0), Real(1));
+	const vec away = position - (start + t * direction);
+	const Real length = glm::length(away);
+	return length > 0 ? away / length : vec(Real(0));
+}
+
+
+template <int Dim, typename Real>
+BasicSampledBoundaryShape<Dim, Real>::BasicSampledBoundaryShape(const std::function<Real(vec)>& distance, Real spacing, typename Dimension<Dim, Real>::ivec size)
+{
+	this->spacing = spacing;
+	unsigned int count = 1;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		nodeCounts[axis] = int(ceil(Real(size[axis]) / spacing)) + 1;
+		count *= nodeCounts[axis];
+	}
+	distances.resize(count);
+
+	// sample the distance at every node, the first axis changes fastest in the node index
+	for (unsigned int index = 0; index < distances.size(); ++index)
+	{
+		vec position;
+		unsigned int rest = index;
+		for (int axis = 0; axis < Dim; ++axis)
+		{
+			position[axis] = spacing * Real(rest % nodeCounts[axis]);
+			rest /= nodeCounts[axis];
+		}
+		distances[index] = distance(position);
+	}
+}
+
+template <int Dim, typename Real>
+Real BasicSampledBoundaryShape<Dim, Real>::signedDistance(vec position) const
+{
+	// positions outside of the grid use the border of the grid
+	typename Dimension<Dim, Real>::ivec cell;
+	vec t;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		const Real gridPosition = glm::clamp(position[axis] / spacing, Real(0), Real(nodeCounts[axis] - 1));
+		cell[axis] = glm::min(int(gridPosition), nodeCounts[axis] - 2);
+		t[axis] = gridPosition - Real(cell[axis]);
+	}
+
+	// each bit of the corner chooses the upper node along one axis
+	Real result = 0;
+	for (int corner = 0; corner < (1 << Dim); ++corner)
+	{
+		Real weight = 1;
+		unsigned int node = 0;
+		unsigned int stride = 1;
+		for (int axis = 0; axis < Dim; ++axis)
+		{
+			const bool upper = (corner >> axis) & 1;
+			weight *= upper ? t[axis] : 1 - t[axis];
+			node += stride * (cell[axis] + (upper ? 1 : 0));
+			stride *= nodeCounts[axis];
+		}
+		result += weight * distances[node];
+	}
+	return result;
+}
+
+template class BasicBoundaryShape<2, float>;
+template class BasicBoundaryShape<2, double>;
+template class BasicBoundaryShape<3, float>;
+template class BasicBoundaryShape<3, double>;
+template class BasicBoundaryPlane<2, float>;
+template class BasicBoundaryPlane<2, double>;
+template class BasicBoundaryPlane<3, float>;
+template class BasicBoundaryPlane<3, double>;
+template class BasicBoundaryBox<2, float>;
+template class BasicBoundaryBox<2, double>;
+template class BasicBoundaryBox<3, float>;
+template class BasicBoundaryBox<3, double>;
+template class BasicBoundarySegment<2, float>;
+template class BasicBoundarySegment<2, double>;
+template class BasicBoundarySegment<3, float>;
+template class BasicBoundarySegment<3, double>;
+template class BasicSampledBoundaryShape<2, float>;
+template class BasicSampledBoundaryShape<2, double>;
+template class BasicSampledBoundaryShape<3, float>;
+template class BasicSampledBoundaryShape<3, double>;
@@ -0,0 +1,138 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+#include "Dimension.h"
+
+/**
+ *	Solid boundary described by its signed distance, negative inside the solid and positive in the fluid
+ */
+template <int Dim, typename Real = float>
+class BasicBoundaryShape
+{
+public:
+	using vec = typename Dimension<Dim, Real>::vec;
+
+	virtual ~BasicBoundaryShape() = default;
+
+	/**
+	 *	@param position a position in the simulation space
+	 *	@return the distance of the position to the surface of the shape, negative inside the shape
+	 */
+	virtual Real signedDistance(vec position) const = 0;
+
+	/**
+	 *	Gradient of the signed distance, the normal of the nearest surface point pointing into the fluid.
+	 *	The default implementation uses central differences, the plane, the box and the segment compute it analytically.
+	 *	@param position a position in the simulation space
+	 *	@return the gradient of the signed distance at the position
+	 */
+	virtual vec distanceGradient(vec position) const;
+};
+
+/**
+ *	Half-space behind a line (a plane in 3D), e.g. a wall or the floor of a container
+ */
+template <int Dim, typename Real = float>
+class BasicBoundaryPlane :
+	public BasicBoundaryShape<Dim, Real>
+{
+public:
+	using vec = typename Dimension<Dim, Real>::vec;
+
+	/**
+	 *	@param point a point on the surface
+	 *	@param normal normal of the surface pointing into the fluid
+	 */
+	BasicBoundaryPlane(vec point, vec normal);
+
+	Real signedDistance(vec position) const override;
+	vec distanceGradient(vec position) const override;
+
+private:
+	vec point;
+	vec normal;
+};
+
+/**
+ *	Solid axis-aligned box
+ */
+template <int Dim, typename Real = float>
+class BasicBoundaryBox :
+	public BasicBoundaryShape<Dim, Real>
+{
+public:
+	using vec = typename Dimension<Dim, Real>::vec;
+
+	/**
+	 *	@param min corner of the box with the smallest coordinates
+	 *	@param max corner of the box with the largest coordinates
+	 */
+	BasicBoundaryBox(vec min, vec max);
+
+	Real signedDistance(vec position) const override;
+	vec distanceGradient(vec position) const override;
+
+private:
+	vec center;
+	vec halfSize;
+};
+
+/**
+ *	Solid line segment with rounded ends and a given thickness, e.g. a ramp
+ */
+template <int Dim, typename Real = float>
+class BasicBoundarySegment :
+	public BasicBoundaryShape<Dim, Real>
+{
+public:
+	using vec = typename Dimension<Dim, Real>::vec;
+
+	/**
+	 *	@param start first end point of the center line
+	 *	@param end second end point of the center line
+	 *	@param thickness thickness of the segment perpendicular to the center line
+	 */
+	BasicBoundarySegment(vec start, vec end, Real thickness);
+
+	Real signedDistance(vec position) const override;
+	vec distanceGradient(vec position) const override;
+
+private:
+	vec start;
+	vec end;
+	Real radius;
+};
+
+/**
+ *	Arbitrary shape whose signed distance function is sampled once on a regular grid and interpolated linearly along each axis
+ */
+template <int Dim, typename Real = float>
+class BasicSampledBoundaryShape :
+	public BasicBoundaryShape<Dim, Real>
+{
+public:
+	using vec = typename Dimension<Dim, Real>::vec;
+
+	/**
+	 *	@param distance signed distance function of the shape, only evaluated at the grid nodes
+	 *	@param spacing distance between two grid nodes
+	 *	@param size the size of the simulation space along each axis
+	 */
+	BasicSampledBoundaryShape(const std::function<Real(vec)>& distance, Real spacing, typename Dimension<Dim, Real>::ivec size);
+
+	Real signedDistance(vec position) const override;
+
+private:
+	std::vector<Real> distances;
+	Real spacing;
+
+	// number of grid nodes along each axis, the first axis changes fastest in the node index
+	typename Dimension<Dim, Real>::ivec nodeCounts;
+};
+
+using BoundaryShape = BasicBoundaryShape<2>;
+using BoundaryPlane = BasicBoundaryPlane<2>;
+using BoundaryBox = BasicBoundaryBox<2>;
+using BoundarySegment = BasicBoundarySegment<2>;
+using SampledBoundaryShape = BasicSampledBoundaryShape<2>;
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 inTextureCoordinates;
+
+uniform mat4 projection;
+
+out vec2 textureCoordinates;
+
+void main()
+{
+	gl_Position = projection * vec4(aPos, 0.0, 1.0);
+	textureCoordinates = inTextureCoordinates;
+}
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "Checkpoint.h"
+#include "Profiler.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// the parameters are written as they are in memory
+static_assert(std::is_trivially_copyable<RunParameters>::value, "RunParameters must be trivially copyable");
+
+namespace
+{
+	const uint32_t checkpointVersion = 2;
+
+	struct CheckpointHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t parametersSize;
+		int32_t pictures;
+	};
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& file_name, const RunParameters& parameters)
+{
+	this->fileName = file_name;
+	this->parameters = parameters;
+	thread = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	checkpointQueued.notify_one();
+	thread.join();
+}
+
+bool CheckpointWriter::write(const Simulation& simulation, const FrameController& frameController, int pictures)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!pending.empty())
+		{
+			return false;
+		}
+	}
+
+	// the state is copied while the simulation doesn't change, the thread only writes the copy
+	PROFILE_SCOPE("copy checkpoint");
+	std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+	CheckpointHeader header = { { 'F', 'L', 'C', 'P' }, checkpointVersion, uint32_t(sizeof(RunParameters)), int32_t(pictures) };
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(&parameters), sizeof(parameters));
+	frameController.saveState(stream);
+	simulation.saveState(stream);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = stream.str();
+	}
+	checkpointQueued.notify_one();
+	return true;
+}
+
+int CheckpointWriter::getWrittenCheckpoints() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return writtenCheckpoints;
+}
+
+void CheckpointWriter::run()
+{
+	PROFILE_THREAD("checkpoint writer");
+	const std::string temporaryName = fileName + ".tmp";
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		checkpointQueued.wait(lock, [&]() { return !pending.empty() || stopping; });
+		if (pending.empty())
+		{
+			return;
+		}
+
+		// pending stays filled while it is written, so that write skips new checkpoints
+		lock.unlock();
+		bool written = false;
+		{
+			PROFILE_SCOPE("write checkpoint");
+			std::fstream file_out(temporaryName, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+			if (!file_out.is_open())
+			{
+				std::cout << "failed to open " << temporaryName << std::endl;
+			}
+			else
+			{
+				file_out.write(pending.data(), pending.size());
+				file_out.close();
+				written = !file_out.fail();
+			}
+		}
+		if (written)
+		{
+			// the complete checkpoint replaces the previous one at once
+			std::error_code error;
+			std::filesystem::rename(temporaryName, fileName, error);
+			if (error)
+			{
+				std::cout << "failed to replace " << fileName << ": " << error.message() << std::endl;
+				written = false;
+			}
+		}
+		lock.lock();
+
+		if (written)
+		{
+			++writtenCheckpoints;
+		}
+		pending.clear();
+	}
+}
+
+
+CheckpointReader::CheckpointReader(const std::string& file_name)
+{
+	std::ifstream file_in(file_name, std::ios_base::in | std::ios_base::binary);
+	if (!file_in.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+		return;
+	}
+
+	CheckpointHeader header;
+	file_in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file_in || std::memcmp(header.magic, "FLCP", 4) != 0 || header.version != checkpointVersion)
+	{
+		std::cout << file_name << " is no checkpoint of this version" << std::endl;
+		return;
+	}
+	if (header.parametersSize != sizeof(RunParameters))
+	{
+		std::cout << file_name << " was written by another build of the program" << std::endl;
+		return;
+	}
+	file_in.read(reinterpret_cast<char*>(&parameters), sizeof(parameters));
+	if (!file_in)
+	{
+		std::cout << file_name << " ends early" << std::endl;
+		return;
+	}
+	pictures = header.pictures;
+
+	std::ostringstream contents(std::ios_base::out | std::ios_base::binary);
+	contents << file_in.rdbuf();
+	state = contents.str();
+	open = true;
+}
+
+bool CheckpointReader::isOpen() const
+{
+	return open;
+}
+
+const RunParameters& CheckpointReader::getParameters() const
+{
+	return parameters;
+}
+
+int CheckpointReader::getPictures() const
+{
+	return pictures;
+}
+
+bool CheckpointReader::restore(Simulation& simulation, FrameController& frameController) const
+{
+	if (!open)
+	{
+		return false;
+	}
+	std::istringstream stream(state, std::ios_base::in | std::ios_base::binary);
+	if (!frameController.loadState(stream))
+	{
+		std::cout << "the checkpoint ends early" << std::endl;
+		return false;
+	}
+	return simulation.loadState(stream);
+}
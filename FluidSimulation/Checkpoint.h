@@ -0,0 +1,109 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "IO.h"
+#include "Simulation.h"
+#include "FrameController.h"
+
+/**
+ *	Saves the complete state of a run in a checkpoint file, so that the run can be continued with --resume after it was stopped.
+ *	Layout, all numbers in the byte order of the machine:
+ *	header:		"FLCP", uint32 version (1), uint32 size of RunParameters, int32 number of pictures saved so far
+ *	parameters:	the RunParameters as they are in memory
+ *	state:		the state of the frame controller, then the state of the simulation
+ *	The state is copied into memory on the simulation thread and written by a background thread into a temporary file,
+ *	which replaces the previous checkpoint only when it is complete. Stopping the program while a checkpoint is written
+ *	leaves the previous checkpoint intact.
+ */
+class CheckpointWriter
+{
+public:
+	/**
+	 *	Create a new checkpoint writer and start its thread
+	 *	@param file_name name of the checkpoint file, the temporary file gets the additional extension .tmp
+	 *	@param parameters the parameters of the run, written into each checkpoint
+	 */
+	CheckpointWriter(const std::string& file_name, const RunParameters& parameters);
+
+	/**
+	 *	Finish the checkpoint which is being written and stop the thread
+	 */
+	~CheckpointWriter();
+
+	CheckpointWriter(const CheckpointWriter&) = delete;
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	/**
+	 *	Copy the state of the run and write it in the background.
+	 *	The checkpoint is skipped if the previous one is still being written, the simulation never waits for the disk.
+	 *	@param pictures number of pictures of the run, including the pictures which are still queued for saving
+	 *	@return true if the checkpoint is written, false if it was skipped
+	 */
+	bool write(const Simulation& simulation, const FrameController& frameController, int pictures);
+
+	/**
+	 *	@return number of checkpoints completely written so far
+	 */
+	int getWrittenCheckpoints() const;
+
+private:
+	// writes the pending checkpoint until the writer is stopped
+	void run();
+
+	std::string fileName;
+	RunParameters parameters;
+
+	// the checkpoint which is being written, empty if the thread is idle
+	std::string pending;
+	bool stopping = false;
+	int writtenCheckpoints = 0;
+
+	mutable std::mutex mutex;
+	// notified when a checkpoint is pending or the writer is stopped
+	std::condition_variable checkpointQueued;
+	std::thread thread;
+};
+
+/**
+ *	Reads a checkpoint file written by a CheckpointWriter
+ */
+class CheckpointReader
+{
+public:
+	/**
+	 *	Read a checkpoint file, check isOpen for errors
+	 *	@param file_name name of the checkpoint file
+	 */
+	CheckpointReader(const std::string& file_name);
+
+	/**
+	 *	@return true if the file was read and has a valid header
+	 */
+	bool isOpen() const;
+
+	/**
+	 *	@return the parameters of the run, used to create the simulation before its state is restored
+	 */
+	const RunParameters& getParameters() const;
+
+	/**
+	 *	@return number of pictures of the run when the checkpoint was written
+	 */
+	int getPictures() const;
+
+	/**
+	 *	Restore the state of a simulation and a frame controller which were created with the parameters of the checkpoint
+	 *	@return false if the state doesn't fit the simulation or the file ends early
+	 */
+	bool restore(Simulation& simulation, FrameController& frameController) const;
+
+private:
+	bool open = false;
+	RunParameters parameters;
+	int pictures = 0;
+
+	// the contents of the file after the parameters
+	std::string state;
+};
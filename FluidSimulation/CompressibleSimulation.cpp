@@ -1,17 +1,21 @@
 #include "CompressibleSimulation.h"
+#include "Profiler.h"
 
-CompressibleSimulation::CompressibleSimulation(int width, int height, float particleSize, float fluidDensity, float viscosity, float gravity, IO* io, float stiffness)
-	: Simulation(width, height, particleSize, fluidDensity, viscosity, gravity, io)
+template <int Dim, typename Real, typename Accumulator>
+BasicCompressibleSimulation<Dim, Real, Accumulator>::BasicCompressibleSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io, Real stiffness)
+	: BasicSimulation<Dim, Real, Accumulator>(size, particleSize, fluidDensity, viscosity, gravity, io)
 {
 	this->stiffness = stiffness;
 }
 
-void CompressibleSimulation::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicCompressibleSimulation<Dim, Real, Accumulator>::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
 {
+	PROFILE_SCOPE("pressure solve");
 #pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isUpdatedThisStep(i))
 		{
 			continue;
 		}
@@ -23,7 +27,15 @@ void CompressibleSimulation::computePressures(const std::vector<std::vector<unsi
 	}
 }
 
-float CompressibleSimulation::getStiffness() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicCompressibleSimulation<Dim, Real, Accumulator>::getStiffness() const
 {
 	return stiffness;
-}
\ No newline at end of file
+}
+
+template class BasicCompressibleSimulation<2, float, float>;
+template class BasicCompressibleSimulation<2, double, double>;
+template class BasicCompressibleSimulation<2, float, double>;
+template class BasicCompressibleSimulation<3, float, float>;
+template class BasicCompressibleSimulation<3, double, double>;
+template class BasicCompressibleSimulation<3, float, double>;
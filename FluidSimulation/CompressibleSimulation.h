@@ -1,17 +1,25 @@
 #pragma once
 #include "IO.h"
 #include "Simulation.h"
-class CompressibleSimulation :
-    public Simulation
+template <int Dim, typename Real = float, typename Accumulator = Real>
+class BasicCompressibleSimulation :
+    public BasicSimulation<Dim, Real, Accumulator>
 {
 public:
-    CompressibleSimulation(int width, int height, float particleSize, float fluidDensity, float viscosity, float gravity, IO* io, float stiffness);
-    float getStiffness() const;
+    using typename BasicSimulation<Dim, Real, Accumulator>::ivec;
+
+    BasicCompressibleSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io, Real stiffness);
+    Real getStiffness() const;
 private:
+    using BasicSimulation<Dim, Real, Accumulator>::particles;
+    using BasicSimulation<Dim, Real, Accumulator>::fluidDensity;
+    using BasicSimulation<Dim, Real, Accumulator>::isUpdatedThisStep;
+
     // compute pressures with a state equation
-    void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference) override;
+    void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference) override;
 
     // stiffness for the pressure acceleration computation
-    float stiffness;
+    Real stiffness;
 };
 
+using CompressibleSimulation = BasicCompressibleSimulation<2>;
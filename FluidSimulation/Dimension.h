@@ -0,0 +1,120 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+/**
+ *	Types and constants which depend on the number of spatial dimensions of the simulation,
+ *	specialized for 2D and 3D so that the particle loops are compiled for a fixed dimension
+ *	@tparam Real scalar type of positions, velocities and all other particle quantities
+ */
+template <int Dim, typename Real = float>
+struct Dimension;
+
+template <typename Real>
+struct Dimension<2, Real>
+{
+	using vec = glm::vec<2, Real>;
+	using ivec = glm::ivec2;
+
+	// rotation of a velocity field in the plane, a scalar around the axis perpendicular to the plane
+	using rotation = Real;
+
+	/**
+	 *	@param smoothingLength the smoothing length h, the kernel support is 2 * h
+	 *	@return normalization factor of the cubic spline kernel
+	 */
+	static Real kernelNormalization(Real smoothingLength)
+	{
+		return Real(5) / (Real(14) * glm::pi<Real>() * smoothingLength * smoothingLength);
+	}
+
+	/**
+	 *	@return the area of a square with the given side length
+	 */
+	static Real volume(Real size)
+	{
+		return size * size;
+	}
+
+	/**
+	 *	@return the rotational part of the outer product of two vectors
+	 */
+	static rotation cross(vec a, vec b)
+	{
+		return a.x * b.y - a.y * b.x;
+	}
+
+	static Real magnitude(rotation r)
+	{
+		return glm::abs(r);
+	}
+};
+
+template <typename Real>
+struct Dimension<3, Real>
+{
+	using vec = glm::vec<3, Real>;
+	using ivec = glm::ivec3;
+
+	// rotation of a velocity field in space, a vector along the rotation axis
+	using rotation = glm::vec<3, Real>;
+
+	/**
+	 *	@param smoothingLength the smoothing length h, the kernel support is 2 * h
+	 *	@return normalization factor of the cubic spline kernel
+	 */
+	static Real kernelNormalization(Real smoothingLength)
+	{
+		return Real(1) / (Real(4) * glm::pi<Real>() * smoothingLength * smoothingLength * smoothingLength);
+	}
+
+	/**
+	 *	@return the volume of a cube with the given side length
+	 */
+	static Real volume(Real size)
+	{
+		return size * size * size;
+	}
+
+	/**
+	 *	@return the cross product of two vectors
+	 */
+	static rotation cross(vec a, vec b)
+	{
+		return rotation(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	static Real magnitude(rotation r)
+	{
+		return glm::length(r);
+	}
+};
+
+/**
+ *	Call a function for every integer point in the box from first to last (both inclusive), the last axis changes fastest
+ *	@param first the first point of the box
+ *	@param last the last point of the box, not smaller than first along any axis
+ *	@param function the function which is called with each point
+ */
+template <int Dim, typename Function>
+void forEachCell(const glm::vec<Dim, int>& first, const glm::vec<Dim, int>& last, Function function)
+{
+	glm::vec<Dim, int> cell = first;
+	while (true)
+	{
+		function(cell);
+
+		// increase the last axis, an axis which reaches its end starts again and increases the axis before it
+		int axis = Dim - 1;
+		while (axis >= 0 && cell[axis] == last[axis])
+		{
+			cell[axis] = first[axis];
+			--axis;
+		}
+		if (axis < 0)
+		{
+			return;
+		}
+		++cell[axis];
+	}
+}
@@ -0,0 +1,93 @@
+#include "FrameController.h"
+#include "Profiler.h"
+#include <glm/glm.hpp>
+#include <iostream>
+
+FrameController::FrameController(float timeStep, int substeps, float frameTime)
+{
+	this->timeStep = timeStep;
+	this->substeps = glm::max(substeps, 1);
+	this->frameTime = frameTime;
+}
+
+void FrameController::fastForward(int steps)
+{
+	fastForwardSteps += glm::max(steps, 0);
+}
+
+template <int Dim>
+bool FrameController::advanceFrame(BasicSimulation<Dim>& simulation)
+{
+	PROFILE_SCOPE("advance frame");
+	if (fastForwardSteps > 0)
+	{
+		// do the steps of one frame without rendering, so that the window stays responsive
+		const int fastSteps = glm::min(fastForwardSteps, substeps);
+		for (int i = 0; i < fastSteps; ++i)
+		{
+			simulation.performSimulationStep(timeStep);
+			simulatedTime += timeStep;
+			++steps;
+		}
+		fastForwardSteps -= fastSteps;
+		nextFrameTime = simulatedTime;
+		return false;
+	}
+
+	if (frameTime > 0)
+	{
+		// do as many steps as needed to reach the physical time of the next frame
+		nextFrameTime += frameTime;
+		do
+		{
+			simulation.performSimulationStep(timeStep);
+			simulatedTime += timeStep;
+			++steps;
+		} while (simulatedTime < nextFrameTime - 0.5 * timeStep);
+	}
+	else
+	{
+		for (int i = 0; i < substeps; ++i)
+		{
+			simulation.performSimulationStep(timeStep);
+			simulatedTime += timeStep;
+			++steps;
+		}
+	}
+	return true;
+}
+
+template bool FrameController::advanceFrame<2>(BasicSimulation<2>& simulation);
+template bool FrameController::advanceFrame<3>(BasicSimulation<3>& simulation);
+
+bool FrameController::isFastForwarding() const
+{
+	return fastForwardSteps > 0;
+}
+
+int FrameController::getSteps() const
+{
+	return steps;
+}
+
+float FrameController::getSimulatedTime() const
+{
+	return float(simulatedTime);
+}
+
+void FrameController::saveState(std::ostream& stream) const
+{
+	stream.write(reinterpret_cast<const char*>(&steps), sizeof(steps));
+	stream.write(reinterpret_cast<const char*>(&fastForwardSteps), sizeof(fastForwardSteps));
+	stream.write(reinterpret_cast<const char*>(&simulatedTime), sizeof(simulatedTime));
+	stream.write(reinterpret_cast<const char*>(&nextFrameTime), sizeof(nextFrameTime));
+}
+
+bool FrameController::loadState(std::istream& stream)
+{
+	stream.read(reinterpret_cast<char*>(&steps), sizeof(steps));
+	stream.read(reinterpret_cast<char*>(&fastForwardSteps), sizeof(fastForwardSteps));
+	stream.read(reinterpret_cast<char*>(&simulatedTime), sizeof(simulatedTime));
+	stream.read(reinterpret_cast<char*>(&nextFrameTime), sizeof(nextFrameTime));
+	return bool(stream);
+}
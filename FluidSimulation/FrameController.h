@@ -0,0 +1,78 @@
+#pragma once
+#include <iosfwd>
+#include "Simulation.h"
+
+class FrameController
+{
+public:
+	/**
+	 *	Create a new frame controller
+	 *	@param timeStep the time step passed to each simulation step
+	 *	@param substeps number of simulation steps between two frames, used if frameTime is 0
+	 *	@param frameTime physical time between two frames, 0 to use a fixed number of substeps instead
+	 */
+	FrameController(float timeStep, int substeps, float frameTime);
+
+	/**
+	 *	Skip rendering and saving of frames for the given number of simulation steps
+	 *	@param steps number of simulation steps without rendering
+	 */
+	void fastForward(int steps);
+
+	/**
+	 *	Advance the simulation to the next frame
+	 *	@param simulation the simulation which is advanced
+	 *	@return true if the frame should be rendered and saved, false while fast-forwarding
+	 */
+	template <int Dim>
+	bool advanceFrame(BasicSimulation<Dim>& simulation);
+
+	/**
+	 *	@return true if frames are currently skipped
+	 */
+	bool isFastForwarding() const;
+
+	/**
+	 *	@return the number of simulation steps performed so far
+	 */
+	int getSteps() const;
+
+	/**
+	 *	@return the physical time simulated so far
+	 */
+	float getSimulatedTime() const;
+
+	/**
+	 *	Write the step counter, the simulated time and the remaining fast-forward steps
+	 *	@param stream binary stream the state is appended to
+	 */
+	void saveState(std::ostream& stream) const;
+
+	/**
+	 *	Replace the counters by counters written with saveState
+	 *	@return false if the stream ends early
+	 */
+	bool loadState(std::istream& stream);
+
+private:
+	// time step of each simulation step
+	float timeStep;
+
+	// number of simulation steps between two frames
+	int substeps;
+
+	// physical time between two frames
+	float frameTime;
+
+	// remaining simulation steps without rendering
+	int fastForwardSteps = 0;
+
+	// number of simulation steps performed so far
+	int steps = 0;
+
+	// physical time simulated so far
+	double simulatedTime = 0;
+
+	// physical time of the next frame
+	double nextFrameTime = 0;
+};
@@ -0,0 +1,517 @@
+#include "FrameEncoder.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+namespace
+{
+	void appendBigEndian(std::vector<char>& result, uint32_t value)
+	{
+		result.push_back(char(value >> 24));
+		result.push_back(char(value >> 16));
+		result.push_back(char(value >> 8));
+		result.push_back(char(value));
+	}
+
+	// header of a TGA file with 24 bits per pixel and the origin in the lower left corner
+	void appendTgaHeader(std::vector<char>& result, char imageType, int width, int height)
+	{
+		const char tga_header[] = {
+			0,
+			0,
+			imageType,
+			0, 0,
+			0, 0,
+			0,
+			0, 0,
+			0, 0,
+			char(width & 0x00FF),
+			char((width & 0xFF00) / 256),
+			char(height & 0x00FF),
+			char((height & 0xFF00) / 256),
+			24,
+			0
+		};
+		result.insert(result.end(), tga_header, tga_header + sizeof(tga_header));
+	}
+
+	// the pixel at column x of row y counted from the top, as RGB
+	void getRgb(const unsigned char* picture_data, int width, int height, int x, int y, unsigned char* rgb)
+	{
+		const unsigned char* pixel = picture_data + (size_t(height - 1 - y) * width + x) * 3;
+		rgb[0] = pixel[2];
+		rgb[1] = pixel[1];
+		rgb[2] = pixel[0];
+	}
+
+	std::array<uint32_t, 256> createCrcTable()
+	{
+		std::array<uint32_t, 256> table;
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return table;
+	}
+
+	uint32_t crc32(const char* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::array<uint32_t, 256> table = createCrcTable();
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc = table[(crc ^ uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t adler32(const std::vector<char>& data)
+	{
+		uint32_t a = 1;
+		uint32_t b = 0;
+		size_t i = 0;
+		while (i < data.size())
+		{
+			// 5552 bytes is the largest block whose sums don't overflow before the modulo
+			const size_t end = std::min(i + 5552, data.size());
+			for (; i < end; ++i)
+			{
+				a += uint8_t(data[i]);
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	// writes the bits of a deflate stream, the first bit is the lowest bit of the first byte
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<char>& result) : result(result) {}
+
+		void write(uint32_t value, int count)
+		{
+			bits |= value << used;
+			used += count;
+			while (used >= 8)
+			{
+				result.push_back(char(bits & 0xFF));
+				bits >>= 8;
+				used -= 8;
+			}
+		}
+
+		// Huffman codes are written starting with their highest bit
+		void writeCode(uint32_t code, int length)
+		{
+			uint32_t reversed = 0;
+			for (int i = 0; i < length; ++i)
+			{
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			}
+			write(reversed, length);
+		}
+
+		void flush()
+		{
+			if (used > 0)
+			{
+				result.push_back(char(bits & 0xFF));
+			}
+			bits = 0;
+			used = 0;
+		}
+
+	private:
+		std::vector<char>& result;
+		uint32_t bits = 0;
+		int used = 0;
+	};
+
+	// fixed Huffman code of a literal or length symbol
+	void writeLiteralLength(BitWriter& writer, int symbol)
+	{
+		if (symbol < 144)
+		{
+			writer.writeCode(0x30 + symbol, 8);
+		}
+		else if (symbol < 256)
+		{
+			writer.writeCode(0x190 + symbol - 144, 9);
+		}
+		else if (symbol < 280)
+		{
+			writer.writeCode(symbol - 256, 7);
+		}
+		else
+		{
+			writer.writeCode(0xC0 + symbol - 280, 8);
+		}
+	}
+
+	void writeMatch(BitWriter& writer, int length, int distance)
+	{
+		static const int lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const int lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const int distanceBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+											4097, 6145, 8193, 12289, 16385, 24577 };
+		static const int distanceExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		int code = 28;
+		while (lengthBase[code] > length)
+		{
+			--code;
+		}
+		writeLiteralLength(writer, 257 + code);
+		writer.write(length - lengthBase[code], lengthExtra[code]);
+
+		code = 29;
+		while (distanceBase[code] > distance)
+		{
+			--code;
+		}
+		writer.writeCode(code, 5);
+		writer.write(distance - distanceBase[code], distanceExtra[code]);
+	}
+
+	// zlib stream with one deflate block with the fixed Huffman codes, matches are found with hash chains
+	void deflate(const std::vector<char>& data, std::vector<char>& result)
+	{
+		const int windowSize = 32768;
+		const int hashSize = 1 << 15;
+		const int maxChain = 16;
+		const int minMatch = 3;
+		const int maxMatch = 258;
+
+		// compression method 8 with a 32 KiB window, fastest compression level, the header is a multiple of 31
+		result.push_back(char(0x78));
+		result.push_back(char(0x01));
+
+		BitWriter writer(result);
+		// final block with the fixed Huffman codes
+		writer.write(1, 1);
+		writer.write(1, 2);
+
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+		const int size = static_cast<int>(data.size());
+		std::vector<int> head(hashSize, -1);
+		std::vector<int> previous(windowSize, -1);
+		auto hash = [&](int position)
+		{
+			return ((bytes[position] << 10) ^ (bytes[position + 1] << 5) ^ bytes[position + 2]) & (hashSize - 1);
+		};
+		auto insert = [&](int position)
+		{
+			if (position + minMatch <= size)
+			{
+				const int h = hash(position);
+				previous[position % windowSize] = head[h];
+				head[h] = position;
+			}
+		};
+
+		int position = 0;
+		while (position < size)
+		{
+			int bestLength = 0;
+			int bestDistance = 0;
+			if (position + minMatch <= size)
+			{
+				int candidate = head[hash(position)];
+				const int maxLength = std::min(maxMatch, size - position);
+				for (int chain = 0; chain < maxChain && candidate >= 0 && position - candidate <= windowSize; ++chain)
+				{
+					int length = 0;
+					while (length < maxLength && bytes[candidate + length] == bytes[position + length])
+					{
+						++length;
+					}
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = position - candidate;
+						if (length == maxLength)
+						{
+							break;
+						}
+					}
+					// the entry of a position which left the window may already belong to a newer position
+					const int next = previous[candidate % windowSize];
+					if (next >= candidate)
+					{
+						break;
+					}
+					candidate = next;
+				}
+			}
+
+			if (bestLength >= minMatch)
+			{
+				writeMatch(writer, bestLength, bestDistance);
+				for (int i = 0; i < bestLength; ++i)
+				{
+					insert(position + i);
+				}
+				position += bestLength;
+			}
+			else
+			{
+				writeLiteralLength(writer, bytes[position]);
+				insert(position);
+				++position;
+			}
+		}
+		writeLiteralLength(writer, 256);
+		writer.flush();
+		appendBigEndian(result, adler32(data));
+	}
+
+	void appendPngChunk(std::vector<char>& result, const char* type, const std::vector<char>& data)
+	{
+		appendBigEndian(result, static_cast<uint32_t>(data.size()));
+		const size_t start = result.size();
+		result.insert(result.end(), type, type + 4);
+		result.insert(result.end(), data.begin(), data.end());
+		appendBigEndian(result, crc32(result.data() + start, result.size() - start));
+	}
+}
+
+std::unique_ptr<FrameEncoder> FrameEncoder::create(FrameEncoding encoding)
+{
+	switch (encoding)
+	{
+	case FrameEncoding::rleTga:
+		return std::make_unique<RleTgaFrameEncoder>();
+	case FrameEncoding::png:
+		return std::make_unique<PngFrameEncoder>();
+	case FrameEncoding::qoi:
+		return std::make_unique<QoiFrameEncoder>();
+	case FrameEncoding::tga:
+	default:
+		return std::make_unique<TgaFrameEncoder>();
+	}
+}
+
+
+void TgaFrameEncoder::encode(const char* picture_data, int width, int height, std::vector<char>& result) const
+{
+	result.clear();
+	appendTgaHeader(result, 2, width, height);
+	result.insert(result.end(), picture_data, picture_data + size_t(width) * height * 3);
+}
+
+std::string TgaFrameEncoder::getExtension() const
+{
+	return "tga";
+}
+
+
+void RleTgaFrameEncoder::encode(const char* picture_data, int width, int height, std::vector<char>& result) const
+{
+	result.clear();
+	appendTgaHeader(result, 10, width, height);
+	for (int y = 0; y < height; ++y)
+	{
+		const char* row = picture_data + size_t(y) * width * 3;
+		auto samePixel = [&](int a, int b)
+		{
+			return std::memcmp(row + 3 * a, row + 3 * b, 3) == 0;
+		};
+
+		int x = 0;
+		while (x < width)
+		{
+			// a run packet repeats one pixel up to 128 times
+			int run = 1;
+			while (x + run < width && run < 128 && samePixel(x, x + run))
+			{
+				++run;
+			}
+			if (run > 1)
+			{
+				result.push_back(char(0x80 | (run - 1)));
+				result.insert(result.end(), row + 3 * x, row + 3 * x + 3);
+				x += run;
+				continue;
+			}
+
+			// a raw packet holds up to 128 pixels and ends before two equal pixels
+			int count = 1;
+			while (x + count < width && count < 128 && !(x + count + 1 < width && samePixel(x + count, x + count + 1)))
+			{
+				++count;
+			}
+			result.push_back(char(count - 1));
+			result.insert(result.end(), row + 3 * x, row + 3 * (x + count));
+			x += count;
+		}
+	}
+}
+
+std::string RleTgaFrameEncoder::getExtension() const
+{
+	return "tga";
+}
+
+
+void PngFrameEncoder::encode(const char* picture_data, int width, int height, std::vector<char>& result) const
+{
+	const unsigned char* pixels = reinterpret_cast<const unsigned char*>(picture_data);
+	const size_t rowSize = size_t(width) * 3;
+
+	// filter the rows, starting with the highest one
+	std::vector<char> filtered;
+	filtered.reserve((rowSize + 1) * height);
+	std::vector<unsigned char> row(rowSize);
+	std::vector<unsigned char> previousRow(rowSize, 0);
+	std::vector<unsigned char> candidates[3] = { std::vector<unsigned char>(rowSize), std::vector<unsigned char>(rowSize), std::vector<unsigned char>(rowSize) };
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			getRgb(pixels, width, height, x, y, &row[3 * x]);
+		}
+
+		// filter 0 keeps the bytes, filter 1 subtracts the pixel to the left, filter 2 subtracts the pixel above
+		int bestFilter = 0;
+		long bestSum = -1;
+		for (int filter = 0; filter < 3; ++filter)
+		{
+			long sum = 0;
+			for (size_t i = 0; i < rowSize; ++i)
+			{
+				unsigned char predictor = 0;
+				if (filter == 1 && i >= 3)
+				{
+					predictor = row[i - 3];
+				}
+				else if (filter == 2)
+				{
+					predictor = previousRow[i];
+				}
+				candidates[filter][i] = static_cast<unsigned char>(row[i] - predictor);
+				sum += std::abs(static_cast<signed char>(candidates[filter][i]));
+			}
+			if (bestSum < 0 || sum < bestSum)
+			{
+				bestSum = sum;
+				bestFilter = filter;
+			}
+		}
+		filtered.push_back(char(bestFilter));
+		filtered.insert(filtered.end(), candidates[bestFilter].begin(), candidates[bestFilter].end());
+		std::swap(row, previousRow);
+	}
+
+	std::vector<char> header;
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	// 8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+	const char format[] = { 8, 2, 0, 0, 0 };
+	header.insert(header.end(), format, format + sizeof(format));
+
+	std::vector<char> compressed;
+	deflate(filtered, compressed);
+
+	result.clear();
+	const char signature[] = { char(0x89), 'P', 'N', 'G', '\r', '\n', char(0x1A), '\n' };
+	result.insert(result.end(), signature, signature + sizeof(signature));
+	appendPngChunk(result, "IHDR", header);
+	appendPngChunk(result, "IDAT", compressed);
+	appendPngChunk(result, "IEND", std::vector<char>());
+}
+
+std::string PngFrameEncoder::getExtension() const
+{
+	return "png";
+}
+
+
+void QoiFrameEncoder::encode(const char* picture_data, int width, int height, std::vector<char>& result) const
+{
+	const unsigned char* pixels = reinterpret_cast<const unsigned char*>(picture_data);
+	result.clear();
+	result.insert(result.end(), { 'q', 'o', 'i', 'f' });
+	appendBigEndian(result, width);
+	appendBigEndian(result, height);
+	// three channels, sRGB with linear alpha
+	result.push_back(3);
+	result.push_back(0);
+
+	// the alpha of the pixels which were not seen yet is 0, the alpha of all pixels of the picture is 255
+	unsigned char seen[64][4] = {};
+	unsigned char previous[4] = { 0, 0, 0, 255 };
+	int run = 0;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			unsigned char pixel[4] = { 0, 0, 0, 255 };
+			getRgb(pixels, width, height, x, y, pixel);
+			if (std::memcmp(pixel, previous, 4) == 0)
+			{
+				++run;
+				if (run == 62)
+				{
+					result.push_back(char(0xC0 | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0)
+			{
+				result.push_back(char(0xC0 | (run - 1)));
+				run = 0;
+			}
+
+			const int index = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+			if (std::memcmp(seen[index], pixel, 4) == 0)
+			{
+				result.push_back(char(index));
+			}
+			else
+			{
+				std::memcpy(seen[index], pixel, 4);
+				const signed char dr = static_cast<signed char>(pixel[0] - previous[0]);
+				const signed char dg = static_cast<signed char>(pixel[1] - previous[1]);
+				const signed char db = static_cast<signed char>(pixel[2] - previous[2]);
+				const int dr_dg = dr - dg;
+				const int db_dg = db - dg;
+				if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+				{
+					result.push_back(char(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+				}
+				else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+				{
+					result.push_back(char(0x80 | (dg + 32)));
+					result.push_back(char(((dr_dg + 8) << 4) | (db_dg + 8)));
+				}
+				else
+				{
+					result.push_back(char(0xFE));
+					result.insert(result.end(), pixel, pixel + 3);
+				}
+			}
+			std::memcpy(previous, pixel, 4);
+		}
+	}
+	if (run > 0)
+	{
+		result.push_back(char(0xC0 | (run - 1)));
+	}
+	result.insert(result.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+}
+
+std::string QoiFrameEncoder::getExtension() const
+{
+	return "qoi";
+}
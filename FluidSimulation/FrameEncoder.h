@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include "IO.h"
+
+/**
+ *	Encodes a picture into the contents of an image file. The pictures are given as BGR with the lowest row first,
+ *	as read from the window. The encoders have no state, one encoder can be used by several threads at once.
+ */
+class FrameEncoder
+{
+public:
+	virtual ~FrameEncoder() = default;
+
+	/**
+	 *	Encode a picture
+	 *	@param picture_data width * height * 3 bytes BGR, the lowest row first
+	 *	@param result the contents of the image file, the previous contents are replaced
+	 */
+	virtual void encode(const char* picture_data, int width, int height, std::vector<char>& result) const = 0;
+
+	/**
+	 *	@return the file extension of the images without the dot
+	 */
+	virtual std::string getExtension() const = 0;
+
+	/**
+	 *	Create the encoder of an image format
+	 */
+	static std::unique_ptr<FrameEncoder> create(FrameEncoding encoding);
+};
+
+/**
+ *	Uncompressed 24 bit TGA (image type 2)
+ */
+class TgaFrameEncoder : public FrameEncoder
+{
+public:
+	void encode(const char* picture_data, int width, int height, std::vector<char>& result) const override;
+	std::string getExtension() const override;
+};
+
+/**
+ *	Run-length encoded 24 bit TGA (image type 10), the packets don't cross rows
+ */
+class RleTgaFrameEncoder : public FrameEncoder
+{
+public:
+	void encode(const char* picture_data, int width, int height, std::vector<char>& result) const override;
+	std::string getExtension() const override;
+};
+
+/**
+ *	24 bit PNG, each row uses the filter with the smallest sum of absolute differences and the image data is compressed
+ *	with a single deflate block with the fixed Huffman codes
+ */
+class PngFrameEncoder : public FrameEncoder
+{
+public:
+	void encode(const char* picture_data, int width, int height, std::vector<char>& result) const override;
+	std::string getExtension() const override;
+};
+
+/**
+ *	QOI, the "Quite OK Image Format", with three channels
+ */
+class QoiFrameEncoder : public FrameEncoder
+{
+public:
+	void encode(const char* picture_data, int width, int height, std::vector<char>& result) const override;
+	std::string getExtension() const override;
+};
@@ -0,0 +1,246 @@
+#include "FrameSink.h"
+#include "Profiler.h"
+#include <iostream>
+#include <sstream>
+#include <glm/glm.hpp>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+// the video is binary, which Windows has to be told
+#define PIPE_WRITE_MODE "wb"
+#else
+#define PIPE_WRITE_MODE "w"
+#endif
+
+ImageFrameSink::ImageFrameSink(IO* io, std::unique_ptr<FrameEncoder> encoder, int workers)
+{
+	this->io = io;
+	this->encoder = std::move(encoder);
+	maxQueued = size_t(glm::max(workers, 1));
+	for (int i = 0; i < workers; ++i)
+	{
+		this->workers.emplace_back(&ImageFrameSink::work, this);
+	}
+}
+
+ImageFrameSink::~ImageFrameSink()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	pictureQueued.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+bool ImageFrameSink::writeFrame(const char* picture_data, int width, int height)
+{
+	if (workers.empty())
+	{
+		io->save_picture(picture_data, width, height, *encoder);
+		return true;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	pictureTaken.wait(lock, [&]() { return queue.size() < maxQueued; });
+	Picture picture;
+	if (!freeBuffers.empty())
+	{
+		picture.data = std::move(freeBuffers.back());
+		freeBuffers.pop_back();
+	}
+	picture.data.assign(picture_data, picture_data + size_t(width) * height * 3);
+	picture.width = width;
+	picture.height = height;
+	queue.push_back(std::move(picture));
+	lock.unlock();
+	pictureQueued.notify_one();
+	return true;
+}
+
+void ImageFrameSink::work()
+{
+	PROFILE_THREAD("picture encoder");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		pictureQueued.wait(lock, [&]() { return !queue.empty() || stopping; });
+		if (queue.empty())
+		{
+			return;
+		}
+		Picture picture = std::move(queue.front());
+		queue.erase(queue.begin());
+		lock.unlock();
+		pictureTaken.notify_one();
+
+		io->save_picture(picture.data.data(), picture.width, picture.height, *encoder);
+
+		lock.lock();
+		freeBuffers.push_back(std::move(picture.data));
+	}
+}
+
+
+Y4mFrameSink::Y4mFrameSink(IO* io, int frames_per_second)
+{
+	this->io = io;
+	this->framesPerSecond = frames_per_second;
+}
+
+Y4mFrameSink::Y4mFrameSink(IO* io, const std::string& file_name, int frames_per_second)
+	: Y4mFrameSink(io, frames_per_second)
+{
+	file.open(file_name, std::ios_base::out | std::ios_base::binary);
+	if (!file.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+	}
+}
+
+Y4mFrameSink* Y4mFrameSink::openEncoder(IO* io, int frames_per_second, const std::string& command)
+{
+	Y4mFrameSink* sink = new Y4mFrameSink(io, frames_per_second);
+	sink->pipe = popen(command.c_str(), PIPE_WRITE_MODE);
+	if (!sink->pipe)
+	{
+		std::cout << "failed to start " << command << std::endl;
+	}
+	return sink;
+}
+
+Y4mFrameSink::~Y4mFrameSink()
+{
+	if (pipe)
+	{
+		pclose(pipe);
+	}
+}
+
+bool Y4mFrameSink::write(const char* data, size_t size)
+{
+	if (pipe)
+	{
+		return std::fwrite(data, 1, size, pipe) == size;
+	}
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.write(data, size);
+	return file.good();
+}
+
+bool Y4mFrameSink::writeFrame(const char* picture_data, int width, int height)
+{
+	PROFILE_SCOPE("write video frame");
+	if (!headerWritten)
+	{
+		std::stringstream header;
+		header << "YUV4MPEG2 W" << width << " H" << height << " F" << framesPerSecond << ":1 Ip A1:1 C444\n";
+		if (!write(header.str().c_str(), header.str().size()))
+		{
+			return false;
+		}
+		headerWritten = true;
+	}
+
+	// convert to limited range BT.601, the video starts with the highest row
+	const size_t pixels = size_t(width) * size_t(height);
+	planes.resize(3 * pixels);
+	for (int y = 0; y < height; ++y)
+	{
+		const unsigned char* row = reinterpret_cast<const unsigned char*>(picture_data) + size_t(height - 1 - y) * width * 3;
+		for (int x = 0; x < width; ++x)
+		{
+			const int b = row[3 * x];
+			const int g = row[3 * x + 1];
+			const int r = row[3 * x + 2];
+			const size_t pixel = size_t(y) * width + x;
+			planes[pixel] = char(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			planes[pixels + pixel] = char(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			planes[2 * pixels + pixel] = char(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+
+	const char frame_header[] = "FRAME\n";
+	if (!write(frame_header, sizeof(frame_header) - 1) || !write(planes.data(), planes.size()))
+	{
+		return false;
+	}
+	io->count_picture();
+	return true;
+}
+
+
+ArchiveFrameSink::ArchiveFrameSink(IO* io, const std::string& file_name)
+{
+	this->io = io;
+	file.open(file_name, std::ios_base::out | std::ios_base::binary);
+	if (!file.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+	}
+}
+
+template <typename T>
+void ArchiveFrameSink::writeNumber(T value)
+{
+	// little endian independent of the machine
+	char bytes[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); ++i)
+	{
+		bytes[i] = char((value >> (8 * i)) & 0xFF);
+	}
+	file.write(bytes, sizeof(T));
+}
+
+ArchiveFrameSink::~ArchiveFrameSink()
+{
+	if (!file.is_open() || !headerWritten)
+	{
+		return;
+	}
+	const uint64_t tableOffset = static_cast<uint64_t>(file.tellp());
+	for (auto& entry : seekTable)
+	{
+		writeNumber<uint64_t>(entry.first);
+		writeNumber<uint64_t>(entry.second);
+	}
+	writeNumber<uint64_t>(tableOffset);
+	writeNumber<uint32_t>(static_cast<uint32_t>(seekTable.size()));
+	file.write("FLFI", 4);
+}
+
+bool ArchiveFrameSink::writeFrame(const char* picture_data, int width, int height)
+{
+	PROFILE_SCOPE("write archive frame");
+	if (!file.is_open())
+	{
+		return false;
+	}
+	if (!headerWritten)
+	{
+		file.write("FLFA", 4);
+		writeNumber<uint32_t>(1);
+		writeNumber<uint32_t>(width);
+		writeNumber<uint32_t>(height);
+		writeNumber<uint32_t>(3);
+		headerWritten = true;
+	}
+
+	const uint64_t offset = static_cast<uint64_t>(file.tellp());
+	const uint64_t size = uint64_t(width) * uint64_t(height) * 3;
+	file.write(picture_data, size);
+	if (!file.good())
+	{
+		return false;
+	}
+	seekTable.push_back(std::make_pair(offset, size));
+	io->count_picture();
+	return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "IO.h"
+#include "FrameEncoder.h"
+#include <string>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ *	Destination of the pictures of the simulation. The pictures are given as BGR with the lowest row first,
+ *	as read from the window, and all pictures of one sink have the same size.
+ */
+class FrameSink
+{
+public:
+	virtual ~FrameSink() = default;
+
+	/**
+	 *	Write the next picture
+	 *	@param picture_data width * height * 3 bytes BGR, the lowest row first
+	 *	@return true if the picture was written
+	 */
+	virtual bool writeFrame(const char* picture_data, int width, int height) = 0;
+};
+
+/**
+ *	Saves every picture as its own image file in the folder of the io.
+ *	The pictures are encoded and saved by a pool of worker threads, writeFrame only copies the picture
+ *	and waits if all workers are busy and one picture per worker is queued.
+ */
+class ImageFrameSink : public FrameSink
+{
+public:
+	/**
+	 *	Create a new image sink and start its workers
+	 *	@param io io which saves the pictures
+	 *	@param encoder the format of the images
+	 *	@param workers number of worker threads, 0 to encode and save each picture in writeFrame
+	 */
+	ImageFrameSink(IO* io, std::unique_ptr<FrameEncoder> encoder, int workers);
+
+	// save the queued pictures and stop the workers
+	~ImageFrameSink();
+
+	bool writeFrame(const char* picture_data, int width, int height) override;
+
+private:
+	struct Picture
+	{
+		std::vector<char> data;
+		int width;
+		int height;
+	};
+
+	// encodes and saves queued pictures until the sink is destroyed and the queue is empty
+	void work();
+
+	IO* io;
+	std::unique_ptr<FrameEncoder> encoder;
+
+	// the pictures waiting for a worker, and the buffers of pictures which are saved, ready for reuse
+	std::vector<Picture> queue;
+	std::vector<std::vector<char>> freeBuffers;
+	size_t maxQueued;
+	bool stopping = false;
+
+	std::mutex mutex;
+	// notified when a picture was queued or the sink is destroyed
+	std::condition_variable pictureQueued;
+	// notified when a worker took a picture from the queue
+	std::condition_variable pictureTaken;
+	std::vector<std::thread> workers;
+};
+
+/**
+ *	Appends the pictures to one raw YUV4MPEG2 video (4:4:4, progressive), either a file or the standard input of an encoder process
+ */
+class Y4mFrameSink : public FrameSink
+{
+public:
+	/**
+	 *	Create a new video file
+	 *	@param io io which counts the pictures
+	 *	@param file_name name of the video file
+	 *	@param frames_per_second frame rate written in the header of the video
+	 */
+	Y4mFrameSink(IO* io, const std::string& file_name, int frames_per_second);
+
+	/**
+	 *	Start an encoder process which reads the video from its standard input
+	 *	@param io io which counts the pictures
+	 *	@param frames_per_second frame rate written in the header of the video
+	 *	@param command command line of the encoder, e.g. ffmpeg -f yuv4mpegpipe -i - video.mp4
+	 */
+	static Y4mFrameSink* openEncoder(IO* io, int frames_per_second, const std::string& command);
+
+	// close the file or wait until the encoder has finished
+	~Y4mFrameSink();
+
+	bool writeFrame(const char* picture_data, int width, int height) override;
+
+private:
+	Y4mFrameSink(IO* io, int frames_per_second);
+	bool write(const char* data, size_t size);
+
+	IO* io;
+	int framesPerSecond;
+	std::ofstream file;
+	// standard input of the encoder, nullptr if the video is written to a file
+	std::FILE* pipe = nullptr;
+	bool headerWritten = false;
+
+	// the Y, U and V planes of one picture
+	std::vector<char> planes;
+};
+
+/**
+ *	Appends the pictures to one archive with a seek table, so that a single picture can be read without reading the ones before it.
+ *	Layout, all numbers little endian:
+ *	header:		"FLFA", uint32 version (1), uint32 width, uint32 height, uint32 bytes per pixel (3)
+ *	frames:		the picture data as given to writeFrame, one after another
+ *	seek table:	uint64 offset and uint64 size of each frame
+ *	footer:		uint64 offset of the seek table, uint32 number of frames, "FLFI"
+ *	The seek table and the footer are written when the sink is destroyed.
+ */
+class ArchiveFrameSink : public FrameSink
+{
+public:
+	/**
+	 *	Create a new archive
+	 *	@param io io which counts the pictures
+	 *	@param file_name name of the archive file
+	 */
+	ArchiveFrameSink(IO* io, const std::string& file_name);
+
+	// write the seek table and the footer and close the file
+	~ArchiveFrameSink();
+
+	bool writeFrame(const char* picture_data, int width, int height) override;
+
+private:
+	template <typename T>
+	void writeNumber(T value);
+
+	IO* io;
+	std::ofstream file;
+	bool headerWritten = false;
+
+	// offset and size of each frame in the file
+	std::vector<std::pair<uint64_t, uint64_t>> seekTable;
+};
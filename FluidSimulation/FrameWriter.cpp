@@ -0,0 +1,133 @@
+#include "FrameWriter.h"
+#include "Profiler.h"
+#include "LatencyHistogram.h"
+#include <glm/glm.hpp>
+
+FrameWriter::FrameWriter(FrameSink* sink, int width, int height, int capacity, FrameWritePolicy policy)
+{
+	this->sink = sink;
+	this->width = width;
+	this->height = height;
+	this->policy = policy;
+	buffers.resize(glm::max(capacity, 1));
+	for (auto& buffer : buffers)
+	{
+		buffer.resize(size_t(width) * size_t(height) * 3);
+	}
+	thread = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	frameQueued.notify_one();
+	thread.join();
+}
+
+char* FrameWriter::acquireFrame()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const int capacity = static_cast<int>(buffers.size());
+	if (queued == capacity)
+	{
+		if (policy == FrameWritePolicy::drop)
+		{
+			++droppedFrames;
+			return nullptr;
+		}
+		frameWritten.wait(lock, [&]() { return queued < capacity; });
+	}
+	acquired = true;
+	return buffers[(first + queued) % capacity].data();
+}
+
+void FrameWriter::submitFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!acquired)
+		{
+			return;
+		}
+		acquired = false;
+		++queued;
+		++submittedFrames;
+	}
+	frameQueued.notify_one();
+}
+
+void FrameWriter::run()
+{
+	PROFILE_THREAD("frame writer");
+	LatencyHistogram& writeLatency = LatencyHistogram::get("write frame");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		frameQueued.wait(lock, [&]() { return queued > 0 || stopping; });
+		if (queued == 0)
+		{
+			return;
+		}
+
+		// the buffer stays queued while it is saved, so that acquireFrame doesn't hand it out
+		char* buffer = buffers[first].data();
+		lock.unlock();
+		const auto start = std::chrono::steady_clock::now();
+		const bool written = sink->writeFrame(buffer, width, height);
+		const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		writeLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration));
+		lock.lock();
+
+		busyTime += duration;
+		if (written)
+		{
+			++writtenFrames;
+		}
+		first = (first + 1) % static_cast<int>(buffers.size());
+		--queued;
+		frameWritten.notify_one();
+	}
+}
+
+int FrameWriter::getQueueDepth() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queued;
+}
+
+int FrameWriter::getWrittenFrames() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return writtenFrames;
+}
+
+int FrameWriter::getSubmittedFrames() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return submittedFrames;
+}
+
+int FrameWriter::getDroppedFrames() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return droppedFrames;
+}
+
+float FrameWriter::getThroughput() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return busyTime.count() > 0 ? static_cast<float>(writtenFrames / busyTime.count()) : 0.f;
+}
+
+int FrameWriter::getWidth() const
+{
+	return width;
+}
+
+int FrameWriter::getHeight() const
+{
+	return height;
+}
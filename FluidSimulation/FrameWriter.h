@@ -0,0 +1,103 @@
+#pragma once
+#include "IO.h"
+#include "FrameSink.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/**
+ *	Saves the pictures of the simulation on a background thread. The pictures are copied into a ring of
+ *	pre-allocated frame buffers, the simulation only waits for the writer if all buffers are in use.
+ */
+class FrameWriter
+{
+public:
+	/**
+	 *	Create a new frame writer and start its thread
+	 *	@param sink sink which saves the pictures, only used by the writer thread
+	 *	@param width the width of each picture
+	 *	@param height the height of each picture
+	 *	@param capacity number of frame buffers in the ring
+	 *	@param policy what happens to a new picture if all frame buffers are in use
+	 */
+	FrameWriter(FrameSink* sink, int width, int height, int capacity, FrameWritePolicy policy);
+
+	/**
+	 *	Save all pictures which are still queued and stop the thread
+	 */
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	/**
+	 *	Get the next free frame buffer, waits for the writer if the ring is full and the policy is block
+	 *	@return a buffer for width * height * 3 bytes BGR, nullptr if the ring is full and the policy is drop
+	 */
+	char* acquireFrame();
+
+	/**
+	 *	Queue the frame buffer returned by the last call of acquireFrame for saving
+	 */
+	void submitFrame();
+
+	/**
+	 *	@return number of pictures which are queued or being saved
+	 */
+	int getQueueDepth() const;
+
+	/**
+	 *	@return number of pictures saved so far
+	 */
+	int getWrittenFrames() const;
+
+	/**
+	 *	@return number of pictures submitted so far, they are saved or still queued
+	 */
+	int getSubmittedFrames() const;
+
+	/**
+	 *	@return number of pictures dropped because the ring was full
+	 */
+	int getDroppedFrames() const;
+
+	/**
+	 *	@return pictures saved per second of busy time of the writer thread, 0 before the first picture
+	 */
+	float getThroughput() const;
+
+	int getWidth() const;
+	int getHeight() const;
+
+private:
+	// saves the queued pictures until the writer is stopped and the queue is empty
+	void run();
+
+	FrameSink* sink;
+	int width;
+	int height;
+	FrameWritePolicy policy;
+
+	// the ring of frame buffers, the queued pictures are in the buffers first to first + queued - 1 (modulo the capacity)
+	std::vector<std::vector<char>> buffers;
+	int first = 0;
+	int queued = 0;
+
+	// true between acquireFrame and submitFrame
+	bool acquired = false;
+	bool stopping = false;
+
+	int submittedFrames = 0;
+	int writtenFrames = 0;
+	int droppedFrames = 0;
+	std::chrono::duration<double> busyTime = std::chrono::duration<double>(0);
+
+	mutable std::mutex mutex;
+	// notified when a picture was queued or the writer is stopped
+	std::condition_variable frameQueued;
+	// notified when a picture was saved and its buffer is free again
+	std::condition_variable frameWritten;
+	std::thread thread;
+};
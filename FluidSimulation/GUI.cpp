@@ -7,10 +7,13 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Shader.h"
+#include "Profiler.h"
 #include <vector>
 
 GUI::GUI(int width, int height, float particleSize)
 {
+	this->particleSize = particleSize;
+
 	// Initialize GLFW and create new GLFW window
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -37,13 +40,15 @@ GUI::GUI(int width, int height, float particleSize)
 	// Set the callback functions
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetKeyCallback(window, key_callback);
+	glfwSetWindowUserPointer(window, this);
 
 	// Activate blending
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// Create and link new shader program
+	// Create and link new shader programs
 	shader = new Shader("VertexShader.glsl", "FragmentShader.glsl");
+	boundaryShader = new Shader("BoundaryVertexShader.glsl", "BoundaryFragmentShader.glsl");
 
 	// data for the vertex buffer object
 	const float right = particleSize / 2;
@@ -89,14 +94,13 @@ bool GUI::update()
 }
 
 
-void GUI::draw(const std::vector<Particle>& particles) const
+void GUI::draw(const std::vector<Particle>& particles)
 {
+	PROFILE_SCOPE("rendering");
 	// Clear framebuffer with a black color
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 	
-	glBindVertexArray(vao);
-	
 	int width;
 	int height;
 	glfwGetWindowSize(window, &width, &height);
@@ -105,6 +109,19 @@ void GUI::draw(const std::vector<Particle>& particles) const
 		0.f, 2.f / float(height), 0.f, 0.f,
 		0.f, 0.f, 1.f, 0.f,
 		-1.f, -1.f, 0.f, 1.f);
+
+	// Draw the boundary below the particles
+	if (boundaryTexture != 0)
+	{
+		boundaryShader->use();
+		glUniformMatrix4fv(glGetUniformLocation(boundaryShader->id, "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+		glBindTexture(GL_TEXTURE_2D, boundaryTexture);
+		glBindVertexArray(boundaryVao);
+		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+		shader->use();
+	}
+
+	glBindVertexArray(vao);
 	int projectionLoc = glGetUniformLocation(shader->id, "projection");
 	glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
 	for (auto& particle : particles)
@@ -113,6 +130,11 @@ void GUI::draw(const std::vector<Particle>& particles) const
 		glm::mat4 model = glm::mat4(1.0f);
 		glm::vec3 position = glm::vec3(particle.position, 0.f);
 		model = glm::translate(model, position);
+		// merged particles are larger than the quad in the vertex buffer
+		if (particle.size > 0)
+		{
+			model = glm::scale(model, glm::vec3(particle.size / particleSize, particle.size / particleSize, 1.f));
+		}
 		int modelLoc = glGetUniformLocation(shader->id, "model");
 		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
 		int colorLoc = glGetUniformLocation(shader->id, "color");
@@ -123,14 +145,60 @@ void GUI::draw(const std::vector<Particle>& particles) const
 	glfwSwapBuffers(window);
 }
 
-char* GUI::get_picture_data() const
+void GUI::set_boundary(const std::vector<float>& coverage, int width, int height)
 {
-	int width;
-	int height;
-	glfwGetWindowSize(window, &width, &height);
-	char* buffer = new char[width * height * 3];
+	// one value per pixel, without interpolation between the pixels
+	if (boundaryTexture == 0)
+	{
+		glGenTextures(1, &boundaryTexture);
+	}
+	glBindTexture(GL_TEXTURE_2D, boundaryTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_FLOAT, coverage.data());
+
+	// quad covering the simulated domain, in pixels like the particles
+	const float vertexBuffer[] = {
+		float(width), 0.f, 1.f, 0.f,
+		float(width), float(height), 1.f, 1.f,
+		0.f, float(height), 0.f, 1.f,
+		0.f, 0.f, 0.f, 0.f
+	};
+	if (boundaryVao == 0)
+	{
+		glGenVertexArrays(1, &boundaryVao);
+		glGenBuffers(1, &boundaryVbo);
+	}
+	glBindVertexArray(boundaryVao);
+	glBindBuffer(GL_ARRAY_BUFFER, boundaryVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexBuffer), vertexBuffer, GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(vao);
+}
+
+void GUI::get_picture_data(char* buffer, int width, int height) const
+{
+	PROFILE_SCOPE("readback");
+	// rows are packed without padding, the buffer has no room for it
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, buffer);
-	return buffer;
+}
+
+
+bool GUI::fast_forward_requested()
+{
+	const bool requested = fastForwardRequested;
+	fastForwardRequested = false;
+	return requested;
 }
 
 
@@ -150,6 +218,11 @@ void GUI::key_callback(GLFWwindow* window, int key, int scancode, int action, in
 			// Close window if escape key is pressed
 			glfwSetWindowShouldClose(window, GLFW_TRUE);
 			break;
+
+		case GLFW_KEY_F:
+			// Skip rendering for a while if F is pressed
+			static_cast<GUI*>(glfwGetWindowUserPointer(window))->fastForwardRequested = true;
+			break;
 		}
 	}
 }
@@ -158,4 +231,5 @@ GUI::~GUI()
 {
 	glfwTerminate();
 	delete shader;
+	delete boundaryShader;
 }
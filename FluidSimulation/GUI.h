@@ -2,16 +2,29 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "Shader.h"
+#include "Renderer.h"
 #include <vector>
 #include "Particle.h"
 
-class GUI
+class GUI : public Renderer
 {
 private:
 	GLFWwindow* window;
 	Shader* shader;
 	unsigned int vao;
 	unsigned int vbo;
+
+	// size of the quad in the vertex buffer
+	float particleSize;
+
+	// the solid boundary as a texture on a quad covering the simulated domain, the texture is 0 without boundary
+	Shader* boundaryShader;
+	unsigned int boundaryVao = 0;
+	unsigned int boundaryVbo = 0;
+	unsigned int boundaryTexture = 0;
+
+	// true if the user pressed the fast-forward key since the last call of fast_forward_requested
+	bool fastForwardRequested = false;
 	
 public:
 	/**
@@ -25,21 +38,41 @@ public:
 	 *	poll events and return true iff window should not close yet
 	 *	@return true if window should not close, false if window should close
 	 */
-	bool update();
+	bool update() override;
 
 	/**
 	 *	draw all particles whose positions are given
 	 *	@param particles particles which are drawn
 	 */
-	void draw(const std::vector<Particle>& particles) const;
+	void draw(const std::vector<Particle>& particles) override;
+
+	/**
+	 *	set the solid boundary which is drawn below the particles
+	 *	@param coverage the covered fraction of each pixel of the simulated domain, the lowest row first
+	 *	@param width the width of the simulated domain in pixels
+	 *	@param height the height of the simulated domain in pixels
+	 */
+	void set_boundary(const std::vector<float>& coverage, int width, int height) override;
 
-	char* get_picture_data() const;
+	/**
+	 *	read the pixels of the lower left part of the window into a buffer
+	 *	@param buffer buffer for width * height * 3 bytes, the pixels are stored as BGR without padding
+	 *	@param width the width of the read part
+	 *	@param height the height of the read part
+	 */
+	void get_picture_data(char* buffer, int width, int height) const override;
+
+	/**
+	 *	return true iff the user pressed the fast-forward key (F) since the last call
+	 *	@return true if the simulation should skip rendering for a while
+	 */
+	bool fast_forward_requested() override;
 
 	// callback which is called by glfw when a key is pressed
 	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 	// callback which is called by glfw when window size changes
 	static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 	
-	~GUI();
+	~GUI() override;
 };
 
@@ -1,15 +1,33 @@
 ﻿#include "IO.h"
+#include "FrameEncoder.h"
+#include "Metrics.h"
+#include "Profiler.h"
+#include "LatencyHistogram.h"
+#include "RunConfiguration.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <ctime>
+#include <algorithm>
 #include <glm/glm.hpp>
 
 IO::IO(const IO& io)
 {
 	this->folder_name = io.folder_name;
-	this->pictures = io.pictures;
+	this->pictures = io.pictures.load();
+	this->metrics = io.metrics;
+}
+
+IO::IO(const std::string& folder_name)
+{
+	this->folder_name = folder_name;
+	pictures = 0;
+	if (!std::filesystem::is_directory(folder_name))
+	{
+		std::cout << "folder " << folder_name << " doesn't exist" << std::endl;
+	}
+	metrics = std::make_shared<MetricsSink>(folder_name, MetricsFormat::text);
 }
 
 IO::IO()
@@ -17,7 +35,11 @@ IO::IO()
 	pictures = 0;
 	time_t now = time(nullptr);
 	struct tm local_time;
+#ifdef _WIN32
 	localtime_s(&local_time, &now);
+#else
+	localtime_r(&now, &local_time);
+#endif
 	std::stringstream name;
 	
 	std::stringstream month;
@@ -85,27 +107,27 @@ IO::IO()
 	{
 		std::cout << "create_directory failed." << std::endl;
 	}
+	metrics = std::make_shared<MetricsSink>(folder_name, MetricsFormat::text);
 }
 
-void IO::decide_parameters(SimulationScenario& scenario, int& width, int& height, int& fluid_depth, float& particle_size,
-	PressureComputationMethod& method, float& max_error, float& stiffness, float& viscosity, float& gravity, float& timeStep)
+void IO::decide_parameters(RunParameters& parameters)
 {
 	// Let the user decide about the window width
 	std::cout << std::endl;
 	std::cout << "Type in the window width, default is 400" << std::endl;
-	std::cin >> width;
-	if (width < 200 || width > 1000)
+	std::cin >> parameters.width;
+	if (parameters.width < 1)
 	{
-		width = 400;
+		parameters.width = 400;
 	}
 
 	// Let the user decide about the window height
 	std::cout << std::endl;
 	std::cout << "Type in the window height, default is 600" << std::endl;
-	std::cin >> height;
-	if (height < 200 || height > 1000)
+	std::cin >> parameters.height;
+	if (parameters.height < 1)
 	{
-		height = 600;
+		parameters.height = 600;
 	}
 
 	// Let the user decide what scenario to simulate
@@ -136,6 +158,10 @@ void IO::decide_parameters(SimulationScenario& scenario, int& width, int& height
 			std::cout << "resting fluid" << std::endl;
 			break;
 
+		case SimulationScenario::periodicChannel:
+			std::cout << "periodic channel, a short piece of an infinitely long flowing fluid" << std::endl;
+			break;
+
 		default:
 			break;
 		}
@@ -146,106 +172,380 @@ void IO::decide_parameters(SimulationScenario& scenario, int& width, int& height
 	// choose first scenario if user gives invalid input
 	if (scenario_int < 0 || scenario_int >= static_cast<int>(SimulationScenario::last))
 	{
-		scenario = SimulationScenario::breakingDam;
+		parameters.scenario = SimulationScenario::breakingDam;
 	}
 	else
 	{
-		scenario = static_cast<SimulationScenario>(scenario_int);
+		parameters.scenario = static_cast<SimulationScenario>(scenario_int);
 	}
 
 	// Let the user decide about the depth of the fluid
 	std::cout << std::endl;
-	std::cout << "Type in the depth of the fluid (1-500), default is 20" << std::endl;
-	std::cin >> fluid_depth;
-	if (fluid_depth < 1 || fluid_depth > 500)
+	std::cout << "Type in the depth of the fluid in particles (at least 1), default is 20" << std::endl;
+	std::cin >> parameters.fluid_depth;
+	if (parameters.fluid_depth < 1)
 	{
-		fluid_depth = 20;
+		parameters.fluid_depth = 20;
 	}
 
 	// Let the user decide about the method of pressure computation
 	std::cout << std::endl;
 	std::cout << "0" << "\t" << "incompressible" << std::endl;
 	std::cout << "1" << "\t" << "compressible" << std::endl;
+	std::cout << "2" << "\t" << "predictive-corrective" << std::endl;
+	std::cout << "3" << "\t" << "position based" << std::endl;
 	int method_int;
 	std::cin >> method_int;
 
 	// choose incompressible pressure computation if user gives invalid input
-	if (method_int < 0 || method_int >= 2)
+	if (method_int < 0 || method_int >= 4)
 	{
-		method = PressureComputationMethod::incompressible;
+		parameters.method = PressureComputationMethod::incompressible;
 	}
 	else
 	{
-		method = static_cast<PressureComputationMethod>(method_int);
+		parameters.method = static_cast<PressureComputationMethod>(method_int);
 	}
 
 
-	// If pressure computation method is incompressible, decide about the maximum density error
-	if (method == PressureComputationMethod::incompressible)
+	// If pressure computation method is incompressible or predictive-corrective, decide about the maximum density error
+	if (parameters.method == PressureComputationMethod::incompressible || parameters.method == PressureComputationMethod::predictiveCorrective)
 	{
 		std::cout << std::endl;
 		std::cout << "Type in the maximum density error (1E-6 - 1), default is 1E-3" << std::endl;
-		std::cin >> max_error;
-		if (max_error < 1E-6f || max_error > 1)
+		std::cin >> parameters.max_error;
+		if (parameters.max_error < 1E-6f || parameters.max_error > 1)
+		{
+			parameters.max_error = 1E-3f;
+		}
+	}
+
+	// If pressure computation method is predictive-corrective, decide about the number of iterations
+	if (parameters.method == PressureComputationMethod::predictiveCorrective)
+	{
+		std::cout << std::endl;
+		std::cout << "Type in the minimum number of iterations (at least 1), default is 3" << std::endl;
+		std::cin >> parameters.min_iterations;
+		if (parameters.min_iterations < 1)
 		{
-			max_error = 1E-3f;
+			parameters.min_iterations = 3;
 		}
+
+		std::cout << std::endl;
+		std::cout << "Type in the maximum number of iterations (at least " << parameters.min_iterations << "), default is 50" << std::endl;
+		std::cout << "Choose the minimum number for a fixed number of iterations" << std::endl;
+		std::cin >> parameters.max_iterations;
+		if (parameters.max_iterations < parameters.min_iterations)
+		{
+			parameters.max_iterations = glm::max(parameters.min_iterations, 50);
+		}
+	}
+
+	// If pressure computation method is position based, decide about the fixed number of iterations
+	if (parameters.method == PressureComputationMethod::positionBased)
+	{
+		std::cout << std::endl;
+		std::cout << "Type in the number of iterations (at least 1), default is 4" << std::endl;
+		std::cin >> parameters.max_iterations;
+		if (parameters.max_iterations < 1)
+		{
+			parameters.max_iterations = 4;
+		}
+		parameters.min_iterations = parameters.max_iterations;
 	}
 
 
 	// If pressure computation method is compressible, decide about the stiffness
-	if (method == PressureComputationMethod::compressible)
+	if (parameters.method == PressureComputationMethod::compressible)
 	{
 		std::cout << std::endl;
 		std::cout << "Type in the stiffness (0 - 1E+10), default is 1E+6" << std::endl;
-		std::cin >> stiffness;
-		if (stiffness < 0.f || stiffness > 1E+10f)
+		std::cin >> parameters.stiffness;
+		if (parameters.stiffness < 0.f || parameters.stiffness > 1E+10f)
 		{
-			stiffness = 1E+6f;
+			parameters.stiffness = 1E+6f;
 		}
 	}
 
 	// Let the user decide about the particle size
 	std::cout << std::endl;
-	std::cout << "Type in the particle size (1-40), default is 8" << std::endl;
-	std::cin >> particle_size;
-	if (particle_size < 1 || particle_size > 40)
+	std::cout << "Type in the particle size in pixels (larger than 0), default is 8" << std::endl;
+	std::cin >> parameters.particle_size;
+	if (!(parameters.particle_size > 0) || parameters.width <= 6 * parameters.particle_size || parameters.height <= 3 * parameters.particle_size)
 	{
-		particle_size = 8;
+		// the walls of three particles have to fit into the window
+		parameters.particle_size = glm::min(8.f, glm::min(float(parameters.width) / 7, float(parameters.height) / 4));
 	}
 
 	// Let the user decide about the viscosity
 	std::cout << std::endl;
 	std::cout << "Type in the viscosity (0 - 2000), default is 200" << std::endl;
-	std::cin >> viscosity;
-	if (viscosity < 0 || viscosity > 2000)
+	std::cin >> parameters.viscosity;
+	if (parameters.viscosity < 0 || parameters.viscosity > 2000)
+	{
+		parameters.viscosity = 200;
+	}
+
+	// Let the user decide about the integration of the viscosity
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "explicit viscosity" << std::endl;
+	std::cout << "1" << "\t" << "implicit viscosity, allows larger time steps for high viscosities" << std::endl;
+	int viscosity_method_int;
+	std::cin >> viscosity_method_int;
+
+	// choose explicit viscosity if user gives invalid input
+	if (viscosity_method_int < 0 || viscosity_method_int >= 2)
+	{
+		parameters.viscosity_method = ViscosityComputationMethod::explicitIntegration;
+	}
+	else
 	{
-		viscosity = 200;
+		parameters.viscosity_method = static_cast<ViscosityComputationMethod>(viscosity_method_int);
 	}
 
 	// Let the user decide about the gravity
 	/*std::cout << std::endl;
 	std::cout << "Type in the gravity (0 - 50), default is 9.81" << std::endl;
-	std::cin >> gravity;
-	if (gravity < 0 || gravity > 50)
+	std::cin >> parameters.gravity;
+	if (parameters.gravity < 0 || parameters.gravity > 50)
 	{
-		gravity = 9.81;
+		parameters.gravity = 9.81;
 	}*/
 	// gravity is fixed to 9.81
-	gravity = 9.81f;
+	parameters.gravity = 9.81f;
 
 	// Let the user decide about the time step
 	std::cout << std::endl;
 	std::cout << "Type in the time step (0.0001 - 1), default is 0.01" << std::endl;
-	std::cin >> timeStep;
-	if (timeStep < 0.0001f || timeStep > 1.f)
+	std::cin >> parameters.timeStep;
+	if (parameters.timeStep < 0.0001f || parameters.timeStep > 1.f)
+	{
+		parameters.timeStep = 0.01f;
+	}
+
+	// Let the user decide whether the time step is divided into adaptive substeps
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "fixed time step" << std::endl;
+	std::cout << "1" << "\t" << "adaptive time step, the time step above is the time between two pictures" << std::endl;
+	int adaptive_int;
+	std::cin >> adaptive_int;
+	parameters.adaptive_time_step = adaptive_int == 1;
+	parameters.min_time_step = parameters.timeStep;
+	parameters.max_time_step = parameters.timeStep;
+	if (parameters.adaptive_time_step)
+	{
+		std::cout << std::endl;
+		std::cout << "Type in the minimum time step (0.00001 - " << parameters.timeStep << "), default is " << parameters.timeStep / 100 << std::endl;
+		std::cin >> parameters.min_time_step;
+		if (parameters.min_time_step < 0.00001f || parameters.min_time_step > parameters.timeStep)
+		{
+			parameters.min_time_step = parameters.timeStep / 100;
+		}
+
+		std::cout << std::endl;
+		std::cout << "Type in the maximum time step (" << parameters.min_time_step << " - " << parameters.timeStep << "), default is " << parameters.timeStep << std::endl;
+		std::cin >> parameters.max_time_step;
+		if (parameters.max_time_step < parameters.min_time_step || parameters.max_time_step > parameters.timeStep)
+		{
+			parameters.max_time_step = parameters.timeStep;
+		}
+	}
+
+	// Let the user decide how many simulation steps are done between two pictures
+	std::cout << std::endl;
+	std::cout << "Type in the physical time between two pictures (0 - 10), default is 0 for a fixed number of steps per picture" << std::endl;
+	std::cin >> parameters.frame_time;
+	if (parameters.frame_time < parameters.timeStep || parameters.frame_time > 10.f)
+	{
+		parameters.frame_time = 0;
+	}
+	parameters.substeps = 1;
+	if (parameters.frame_time == 0)
+	{
+		std::cout << std::endl;
+		std::cout << "Type in the number of simulation steps per picture (at least 1), default is 1" << std::endl;
+		std::cin >> parameters.substeps;
+		if (parameters.substeps < 1)
+		{
+			parameters.substeps = 1;
+		}
+	}
+
+	// Let the user decide how many steps are simulated without rendering, also used when F is pressed
+	std::cout << std::endl;
+	std::cout << "Type in the number of steps simulated without rendering at the start and after pressing F (at least 0), default is 0" << std::endl;
+	std::cin >> parameters.fast_forward_steps;
+	if (parameters.fast_forward_steps < 0)
 	{
-		timeStep = 0.01f;
+		parameters.fast_forward_steps = 0;
 	}
 
+	// If pressure computation method is compressible, decide whether calm particles are frozen
+	parameters.sleeping = false;
+	if (parameters.method == PressureComputationMethod::compressible)
+	{
+		std::cout << std::endl;
+		std::cout << "0" << "\t" << "all particles are simulated" << std::endl;
+		std::cout << "1" << "\t" << "calm particles fall asleep" << std::endl;
+		int sleeping_int;
+		std::cin >> sleeping_int;
+		parameters.sleeping = sleeping_int == 1;
+	}
+
+	// If pressure computation method is compressible, decide about individual time steps for slow particles,
+	// the time levels need a fixed time step
+	parameters.multirate_levels = 0;
+	if (parameters.method == PressureComputationMethod::compressible && !parameters.adaptive_time_step)
+	{
+		std::cout << std::endl;
+		std::cout << "Type in the number of time levels for slow particles (0 - " << RunParameters::max_multirate_levels << "), default is 0 for the same time step for all particles. The time step times 2^levels has to be stable for the stiffness" << std::endl;
+		std::cin >> parameters.multirate_levels;
+		if (parameters.multirate_levels < 0 || parameters.multirate_levels > RunParameters::max_multirate_levels)
+		{
+			parameters.multirate_levels = 0;
+		}
+	}
+
+	// If pressure computation method is compressible, decide whether particles deep inside the fluid are merged
+	parameters.adaptive_resolution = false;
+	if (parameters.method == PressureComputationMethod::compressible)
+	{
+		std::cout << std::endl;
+		std::cout << "0" << "\t" << "all particles have the same size" << std::endl;
+		std::cout << "1" << "\t" << "particles deep inside the fluid are merged and split again near the surface" << std::endl;
+		int adaptive_resolution_int;
+		std::cin >> adaptive_resolution_int;
+		parameters.adaptive_resolution = adaptive_resolution_int == 1;
+	}
+
+	// Let the user decide how the fluid particles interact with the boundary
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "boundary particles are neighbors of the fluid particles" << std::endl;
+	std::cout << "1" << "\t" << "boundary density map, one lookup per fluid particle, the walls are free-slip" << std::endl;
+	std::cout << "2" << "\t" << "boundary shapes (planes, boxes, segments) without boundary particles, the boundary is not drawn" << std::endl;
+	int boundary_method_int;
+	std::cin >> boundary_method_int;
+
+	// choose boundary particles if user gives invalid input
+	if (boundary_method_int < 0 || boundary_method_int >= 3)
+	{
+		parameters.boundary_method = BoundaryHandlingMethod::particles;
+	}
+	else
+	{
+		parameters.boundary_method = static_cast<BoundaryHandlingMethod>(boundary_method_int);
+	}
+
+	// Let the user decide whether the simulation waits for saving the pictures
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "the simulation waits if saving the pictures falls behind" << std::endl;
+	std::cout << "1" << "\t" << "pictures are dropped if saving them falls behind" << std::endl;
+	int frame_policy_int;
+	std::cin >> frame_policy_int;
+	parameters.frame_policy = frame_policy_int == 1 ? FrameWritePolicy::drop : FrameWritePolicy::block;
+
+	// Let the user decide how the pictures are saved
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "one TGA file per picture" << std::endl;
+	std::cout << "1" << "\t" << "one raw Y4M video" << std::endl;
+	std::cout << "2" << "\t" << "one frame archive with a seek table" << std::endl;
+	std::cout << "3" << "\t" << "pipe the Y4M video to ffmpeg, which has to be installed" << std::endl;
+	std::cout << "4" << "\t" << "no pictures" << std::endl;
+	int frame_format_int;
+	std::cin >> frame_format_int;
+
+	// choose single pictures if user gives invalid input
+	if (frame_format_int < 0 || frame_format_int >= 5)
+	{
+		parameters.frame_format = FrameOutputFormat::images;
+	}
+	else
+	{
+		parameters.frame_format = static_cast<FrameOutputFormat>(frame_format_int);
+	}
+
+	// If every picture is saved as its own file, let the user decide about the image format
+	parameters.frame_encoding = FrameEncoding::tga;
+	if (parameters.frame_format == FrameOutputFormat::images)
+	{
+		std::cout << std::endl;
+		std::cout << "0" << "\t" << "uncompressed TGA" << std::endl;
+		std::cout << "1" << "\t" << "run-length encoded TGA" << std::endl;
+		std::cout << "2" << "\t" << "PNG" << std::endl;
+		std::cout << "3" << "\t" << "QOI" << std::endl;
+		int frame_encoding_int;
+		std::cin >> frame_encoding_int;
+		if (frame_encoding_int >= 0 && frame_encoding_int < 4)
+		{
+			parameters.frame_encoding = static_cast<FrameEncoding>(frame_encoding_int);
+		}
+
+		std::cout << std::endl;
+		std::cout << "Type in the number of threads which encode the pictures (at least 0), default is 0 for a quarter of the cores" << std::endl;
+		std::cin >> parameters.encoder_threads;
+		if (parameters.encoder_threads < 0)
+		{
+			parameters.encoder_threads = 0;
+		}
+	}
+
+	// Let the user decide whether the particles are saved as well
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "only the pictures are saved" << std::endl;
+	std::cout << "1" << "\t" << "the fluid particles of each picture are saved in a snapshot file as well" << std::endl;
+	int save_snapshots_int;
+	std::cin >> save_snapshots_int;
+	parameters.save_snapshots = save_snapshots_int == 1;
+
+	// Let the user decide whether the trajectory of the particles is recorded, with much smaller files than the snapshots
+	std::cout << std::endl;
+	std::cout << "Type in the largest position error per axis of the recorded trajectory in particle sizes (0 - 1), default is 0 for no trajectory" << std::endl;
+	std::cin >> parameters.trajectory_position_error;
+	if (parameters.trajectory_position_error < 0 || parameters.trajectory_position_error > 1)
+	{
+		parameters.trajectory_position_error = 0;
+	}
+	if (parameters.trajectory_position_error > 0)
+	{
+		std::cout << "Type in the largest velocity error per axis of the recorded trajectory in particle sizes per second (0.0001 - 100), default is 0.1" << std::endl;
+		std::cin >> parameters.trajectory_velocity_error;
+		if (parameters.trajectory_velocity_error < 0.0001f || parameters.trajectory_velocity_error > 100)
+		{
+			parameters.trajectory_velocity_error = 0.1f;
+		}
+		std::cout << "Type in the number of pictures between two keyframes of the trajectory (1 - 10000), default is 50" << std::endl;
+		std::cin >> parameters.trajectory_keyframe_interval;
+		if (parameters.trajectory_keyframe_interval < 1 || parameters.trajectory_keyframe_interval > 10000)
+		{
+			parameters.trajectory_keyframe_interval = 50;
+		}
+	}
 
+	// Let the user decide about the format of the measured values
+	std::cout << std::endl;
+	std::cout << "0" << "\t" << "the measured values are saved as text files" << std::endl;
+	std::cout << "1" << "\t" << "the measured values are saved as binary files, one column after another" << std::endl;
+	int metrics_format_int;
+	std::cin >> metrics_format_int;
+	parameters.metrics_format = metrics_format_int == 1 ? MetricsFormat::binary : MetricsFormat::text;
+	set_metrics_format(parameters.metrics_format);
+
+	// Let the user decide how often the state of the simulation is saved, a run can be continued from the last checkpoint
+	std::cout << std::endl;
+	std::cout << "Type in the number of pictures between two checkpoints (at least 0), default is 0 for no checkpoints" << std::endl;
+	std::cin >> parameters.checkpoint_interval;
+	if (parameters.checkpoint_interval < 0)
+	{
+		parameters.checkpoint_interval = 0;
+	}
+
+	save_parameters(parameters);
+}
+
+void IO::save_parameters(const RunParameters& parameters) const
+{
 	// print parameters in a file
-	std::string file_name = folder_name + "\\parameters.txt";
+	std::string file_name = get_file_name("parameters.txt");
 	std::fstream file_out(file_name, std::ios_base::out);
 	if (!file_out.is_open())
 	{
@@ -254,88 +554,195 @@ void IO::decide_parameters(SimulationScenario& scenario, int& width, int& height
 	else
 	{
 		std::stringstream stream;
-		stream << "Fensterbreite: " << width << std::endl;
-		stream << "Fensterhöhe: " << width << std::endl;
-		stream << "Szenario: " << scenario_int << std::endl;
-		stream << "Flüssigkeitstiefe: " << fluid_depth << std::endl;
-		stream << "Druckberechnung: " << method_int << std::endl;
-		stream << "Partikelgröße: " << particle_size << std::endl;
-		stream << "Viskosität: " << viscosity << std::endl;
-		if (method == PressureComputationMethod::incompressible)
+		stream << "Dimensionen: " << parameters.dimensions << std::endl;
+		stream << "Fensterbreite: " << parameters.width << std::endl;
+		stream << "Fensterhöhe: " << parameters.height << std::endl;
+		if (parameters.dimensions == 3)
+		{
+			stream << "Raumtiefe: " << parameters.depth << std::endl;
+		}
+		stream << "Szenario: " << static_cast<int>(parameters.scenario) << std::endl;
+		stream << "Flüssigkeitstiefe: " << parameters.fluid_depth << std::endl;
+		stream << "Druckberechnung: " << static_cast<int>(parameters.method) << std::endl;
+		stream << "Partikelgröße: " << parameters.particle_size << std::endl;
+		stream << "Viskosität: " << parameters.viscosity << std::endl;
+		stream << "Viskositätsintegration: " << static_cast<int>(parameters.viscosity_method) << std::endl;
+		if (parameters.method == PressureComputationMethod::incompressible || parameters.method == PressureComputationMethod::predictiveCorrective)
+		{
+			stream << "Maximaler Dichtefehler: " << parameters.max_error << std::endl;
+		}
+		if (parameters.method == PressureComputationMethod::predictiveCorrective)
+		{
+			stream << "Minimale Iterationen: " << parameters.min_iterations << std::endl;
+			stream << "Maximale Iterationen: " << parameters.max_iterations << std::endl;
+		}
+		if (parameters.method == PressureComputationMethod::positionBased)
+		{
+			stream << "Iterationen: " << parameters.max_iterations << std::endl;
+		}
+		if (parameters.method == PressureComputationMethod::compressible)
 		{
-			stream << "Maximaler Dichtefehler: " << max_error << std::endl;
+			stream << "Steifigkeitskonstante: " << parameters.stiffness << std::endl;
 		}
-		if (method == PressureComputationMethod::compressible)
+		stream << "Zeitschritt: " << parameters.timeStep << std::endl;
+		if (parameters.adaptive_time_step)
 		{
-			stream << "Steifigkeitskonstante: " << stiffness << std::endl;
+			stream << "Minimaler Zeitschritt: " << parameters.min_time_step << std::endl;
+			stream << "Maximaler Zeitschritt: " << parameters.max_time_step << std::endl;
 		}
-		stream << "Zeitschritt: " << timeStep << std::endl;
+		if (parameters.frame_time > 0)
+		{
+			stream << "Zeit pro Bild: " << parameters.frame_time << std::endl;
+		}
+		else
+		{
+			stream << "Schritte pro Bild: " << parameters.substeps << std::endl;
+		}
+		stream << "Schritte ohne Darstellung: " << parameters.fast_forward_steps << std::endl;
+		stream << "Schlafende Partikel: " << parameters.sleeping << std::endl;
+		if (parameters.method == PressureComputationMethod::compressible)
+		{
+			stream << "Zeitebenen: " << parameters.multirate_levels << std::endl;
+			stream << "Adaptive Auflösung: " << parameters.adaptive_resolution << std::endl;
+		}
+		stream << "Randbehandlung: " << static_cast<int>(parameters.boundary_method) << std::endl;
+		stream << "Bilder verwerfen: " << static_cast<int>(parameters.frame_policy) << std::endl;
+		stream << "Bildausgabe: " << static_cast<int>(parameters.frame_format) << std::endl;
+		if (parameters.frame_format == FrameOutputFormat::images)
+		{
+			stream << "Bildformat: " << static_cast<int>(parameters.frame_encoding) << std::endl;
+			stream << "Threads für Bilder: " << parameters.encoder_threads << std::endl;
+		}
+		stream << "Partikel speichern: " << parameters.save_snapshots << std::endl;
+		if (parameters.trajectory_position_error > 0)
+		{
+			stream << "Positionsfehler der Trajektorie: " << parameters.trajectory_position_error << std::endl;
+			stream << "Geschwindigkeitsfehler der Trajektorie: " << parameters.trajectory_velocity_error << std::endl;
+			stream << "Bilder pro Schlüsselbild: " << parameters.trajectory_keyframe_interval << std::endl;
+		}
+		stream << "Messwertformat: " << static_cast<int>(parameters.metrics_format) << std::endl;
+		stream << "Bilder pro Sicherungspunkt: " << parameters.checkpoint_interval << std::endl;
 		file_out << stream.str();
 	}
+
+	// the same parameters as a run configuration, which repeats the run with --config
+	std::string configuration_name = get_file_name("configuration.txt");
+	std::fstream configuration_out(configuration_name, std::ios_base::out);
+	if (!configuration_out.is_open())
+	{
+		std::cout << "failed to open " << configuration_name << std::endl;
+	}
+	else
+	{
+		writeRunConfiguration(configuration_out, parameters);
+	}
 }
 
 
-void IO::save_picture(char* picture_data, int width, int height)
+void IO::save_picture(const char* picture_data, int width, int height, const FrameEncoder& encoder)
 {
-	if (pictures > 20000)
+	PROFILE_SCOPE("save picture");
+	static LatencyHistogram& pictureLatency = LatencyHistogram::get("save picture");
+	LatencyTimer pictureTimer(pictureLatency);
+	// each thread which saves pictures keeps its buffer for the encoded files
+	thread_local std::vector<char> encoded;
 	{
-		// don't save more than 20.000 pictures
-		return;
+		PROFILE_SCOPE("encode picture");
+		encoder.encode(picture_data, width, height, encoded);
 	}
+
+	// the number is reserved before the file is written, so that several threads can save pictures at once
+	const int picture = pictures++;
 	std::stringstream name;
-	name << pictures << ".tga";
-	std::string file_name = folder_name + "\\" + name.str();
-	std::fstream file_out(file_name, std::ios_base::app | std::ios_base::binary);
+	name << picture << "." << encoder.getExtension();
+	std::string file_name = folder_name + "/" + name.str();
+	std::fstream file_out(file_name, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
 	if (!file_out.is_open())
 	{
 		std::cout << "failed to open " << file_name << std::endl;
 	}
 	else
 	{
-		char tga_header[] = {
-			0,
-			0,
-			2,
-			0, 0,
-			0, 0,
-			0,
-			0, 0,
-			0, 0,
-			char(width & 0x00FF),
-			char((width & 0xFF00) / 256),
-			char(height & 0x00FF),
-			char((height & 0xFF00) / 256),
-			24,
-			0
-		};
-		file_out.write(tga_header, 18);
-		file_out.write(picture_data, width * height * 3);
+		file_out.write(encoded.data(), encoded.size());
 		file_out.close();
-		++pictures;
 	}
 }
 
-void IO::print_average_density(float average_density) const
+void IO::count_picture()
 {
-	std::string file_name = folder_name + "\\average_density.txt";
-	std::fstream file_out(file_name, std::ios_base::in | std::ios_base::out | std::ios_base::app);
-	if (!file_out.is_open())
-	{
-		std::cout << "failed to open " << file_name << std::endl;
-	}
-	else
+	++pictures;
+}
+
+int IO::get_pictures() const
+{
+	return pictures;
+}
+
+void IO::set_pictures(int pictures)
+{
+	this->pictures = pictures;
+}
+
+std::string IO::get_file_name(const std::string& name) const
+{
+	return folder_name + "/" + name;
+}
+
+void IO::set_metrics_format(MetricsFormat format)
+{
+	metrics = std::make_shared<MetricsSink>(folder_name, format);
+	metrics_series.assign(metrics_series.size(), -1);
+}
+
+void IO::flush_metrics() const
+{
+	metrics->flush();
+}
+
+void IO::hold_metrics()
+{
+	holding_metrics = true;
+}
+
+void IO::release_metrics(bool keep)
+{
+	holding_metrics = false;
+	if (keep)
 	{
-		std::stringstream line_stream;
-		if (pictures == 0)
+		for (const HeldRow& row : held_rows)
 		{
-			line_stream << "Simulationsschritt" << "\t" << "Durchschnittsdichte" << "\n";
+			metrics->record(row.series, row.values);
 		}
-		line_stream << pictures << "\t" << average_density << "\n";
-		file_out << line_stream.str();
 	}
+	held_rows.clear();
+}
+
+void IO::record(MetricsSeries series, const char* name, std::initializer_list<const char*> columns, std::initializer_list<double> values) const
+{
+	int& handle = metrics_series[static_cast<size_t>(series)];
+	if (handle < 0)
+	{
+		handle = metrics->addSeries(name, columns);
+	}
+	record(handle, values);
+}
+
+void IO::record(int series, std::initializer_list<double> values) const
+{
+	if (holding_metrics)
+	{
+		held_rows.push_back({ series, std::vector<double>(values) });
+		return;
+	}
+	metrics->record(series, values);
+}
+
+void IO::print_average_density(int step, float average_density) const
+{
+	record(MetricsSeries::averageDensity, "average_density", { "Simulationsschritt", "Durchschnittsdichte" }, { double(step), average_density });
 }
 
-void IO::print_cfl_condition(const std::vector<Particle>& particles, float timeStep, float particleSize) const
+void IO::print_cfl_condition(int step, const std::vector<Particle>& particles, float timeStep, float particleSize) const
 {
 	float max_speed = 0;
 	for (const Particle& particle : particles)
@@ -347,40 +754,66 @@ void IO::print_cfl_condition(const std::vector<Particle>& particles, float timeS
 		}
 	}
 	bool cfl_condition = max_speed < particleSize / timeStep;
-	std::string file_name = folder_name + "\\cfl_condition.txt";
-	std::fstream file_out(file_name, std::ios_base::in | std::ios_base::out | std::ios_base::app);
-	if (!file_out.is_open())
-	{
-		std::cout << "failed to open " << file_name << std::endl;
-	}
-	else
-	{
-		std::stringstream line_stream;
-		if (pictures == 1)
-		{
-			line_stream << "Simulationsschritt" << "\t" << "Durchschnittsdichte" << "\n";
-		}
-		line_stream << pictures << "\t" << cfl_condition << "\n";
-		file_out << line_stream.str();
-	}
+	record(MetricsSeries::cflCondition, "cfl_condition", { "Simulationsschritt", "CFL-Bedingung" }, { double(step), double(cfl_condition) });
 }
 
-void IO::print_iterations(int iterations) const
+void IO::print_iterations(int step, int iterations) const
 {
-	std::string file_name = folder_name + "\\iterations.txt";
-	std::fstream file_out(file_name, std::ios_base::in | std::ios_base::out | std::ios_base::app);
-	if (!file_out.is_open())
-	{
-		std::cout << "failed to open " << file_name << std::endl;
-	}
-	else
+	record(MetricsSeries::iterations, "iterations", { "Simulationsschritt", "Iterationen" }, { double(step), double(iterations) });
+}
+
+void IO::print_iteration_time(int step, float seconds) const
+{
+	record(MetricsSeries::iterationTime, "iteration_time", { "Simulationsschritt", "Zeit pro Iteration" }, { double(step), seconds });
+}
+
+void IO::print_viscosity_iterations(int step, int iterations) const
+{
+	record(MetricsSeries::viscosityIterations, "viscosity_iterations", { "Simulationsschritt", "Iterationen" }, { double(step), double(iterations) });
+}
+
+void IO::print_time_step(int step, float time_step, int rollbacks) const
+{
+	record(MetricsSeries::timeStep, "time_step", { "Simulationsschritt", "Zeitschritt", "Wiederholungen" }, { double(step), time_step, double(rollbacks) });
+}
+
+void IO::print_sleeping_particles(int step, int awake_particles, float estimated_saved_time) const
+{
+	record(MetricsSeries::sleepingParticles, "sleeping_particles", { "Simulationsschritt", "Wache Partikel", "Geschätzte eingesparte Zeit" },
+		{ double(step), double(awake_particles), estimated_saved_time });
+}
+
+void IO::print_particle_updates(int step, int particle_updates) const
+{
+	record(MetricsSeries::particleUpdates, "particle_updates", { "Simulationsschritt", "Partikelaktualisierungen" }, { double(step), double(particle_updates) });
+}
+
+void IO::print_particle_count(int step, int particles, int merged_particles) const
+{
+	record(MetricsSeries::particleCount, "particle_count", { "Simulationsschritt", "Partikel", "Verschmolzene Partikel" },
+		{ double(step), double(particles), double(merged_particles) });
+}
+
+void IO::print_frame_writer(int step, int queue_depth, float frames_per_second, int dropped_frames) const
+{
+	record(MetricsSeries::frameWriter, "frame_writer", { "Simulationsschritt", "Warteschlange", "Bilder pro Sekunde", "Verworfene Bilder" },
+		{ double(step), double(queue_depth), frames_per_second, double(dropped_frames) });
+}
+
+void IO::print_latencies(int step) const
+{
+	// one series per phase, each row holds the percentiles since the previous row. The latencies are printed once a second,
+	// so their series are looked up by name each time.
+	for (LatencyHistogram* histogram : LatencyHistogram::getAll())
 	{
-		std::stringstream line_stream;
-		if (pictures == 0)
+		const LatencySummary summary = histogram->getIntervalSummary();
+		if (summary.count == 0)
 		{
-			line_stream << "Simulationsschritt" << "\t" << "Iterationen" << "\n";
+			continue;
 		}
-		line_stream << pictures << "\t" << iterations << "\n";
-		file_out << line_stream.str();
+		std::string name = "latency_" + histogram->getName();
+		std::replace(name.begin(), name.end(), ' ', '_');
+		record(metrics->addSeries(name, { "Simulationsschritt", "Anzahl", "Median", "95. Perzentil", "99. Perzentil", "Maximum" }),
+			{ double(step), double(summary.count), summary.median, summary.percentile95, summary.percentile99, summary.maximum });
 	}
-}
+}
\ No newline at end of file
@@ -1,23 +1,137 @@
 ﻿#pragma once
 #include <string>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <initializer_list>
 #include "Particle.h"
 
-enum class SimulationScenario { breakingDam, leakyDam, droppingFluid, flowingFluid, restingFluid, last };
-enum class PressureComputationMethod { incompressible, compressible };
+enum class SimulationScenario { breakingDam, leakyDam, droppingFluid, flowingFluid, restingFluid, periodicChannel, last };
+enum class PressureComputationMethod { incompressible, compressible, predictiveCorrective, positionBased };
+enum class ViscosityComputationMethod { explicitIntegration, implicitIntegration };
+enum class BoundaryHandlingMethod { particles, densityMap, shapes };
+enum class FrameWritePolicy { block, drop };
+enum class FrameOutputFormat { images, video, archive, encoder, none };
+enum class FrameEncoding { tga, rleTga, png, qoi };
+enum class MetricsFormat { text, binary };
+
+class FrameEncoder;
+class MetricsSink;
+
+/**
+ *	The parameters of a simulation run, chosen by the user in IO::decide_parameters or given by a run configuration (RunConfiguration.h).
+ *	The defaults are the defaults of the prompts. The structure is saved as it is in checkpoints.
+ */
+struct RunParameters
+{
+	SimulationScenario scenario = SimulationScenario::breakingDam;
+	// number of spatial dimensions, 2 or 3, 3D runs have no window and save no pictures yet
+	int dimensions = 2;
+	int width = 400;
+	int height = 600;
+	// size of the simulation space along the z-axis, only used in 3D
+	int depth = 120;
+	int fluid_depth = 20;
+	float particle_size = 8;
+	PressureComputationMethod method = PressureComputationMethod::incompressible;
+	float max_error = 1E-3f;
+	int min_iterations = 3;
+	int max_iterations = 50;
+	float stiffness = 1E+6f;
+	float viscosity = 200;
+	ViscosityComputationMethod viscosity_method = ViscosityComputationMethod::explicitIntegration;
+	float gravity = 9.81f;
+	float timeStep = 0.01f;
+	bool adaptive_time_step = false;
+	float min_time_step = 0.01f;
+	float max_time_step = 0.01f;
+	int substeps = 1;
+	float frame_time = 0;
+	int fast_forward_steps = 0;
+	bool sleeping = false;
+	// the slowest particles take 2^multirate_levels time steps at once
+	int multirate_levels = 0;
+	static const int max_multirate_levels = 8;
+	bool adaptive_resolution = false;
+	BoundaryHandlingMethod boundary_method = BoundaryHandlingMethod::particles;
+	FrameWritePolicy frame_policy = FrameWritePolicy::block;
+	FrameOutputFormat frame_format = FrameOutputFormat::images;
+	FrameEncoding frame_encoding = FrameEncoding::tga;
+	// threads which encode the pictures, 0 for a quarter of the cores
+	int encoder_threads = 0;
+	bool save_snapshots = false;
+	// largest error of each axis of the positions of the recorded trajectory in particle sizes, 0 for no trajectory
+	float trajectory_position_error = 0;
+	// largest error of each axis of the velocities of the recorded trajectory in particle sizes per second
+	float trajectory_velocity_error = 0.1f;
+	// pictures between two keyframes of the trajectory
+	int trajectory_keyframe_interval = 50;
+	MetricsFormat metrics_format = MetricsFormat::text;
+	// pictures between two checkpoints, 0 for no checkpoints
+	int checkpoint_interval = 0;
+};
 
 class IO
 {
 private:
 	std::string folder_name;
-	int pictures;
+	// incremented by the threads of the frame writer
+	std::atomic<int> pictures;
+	// the time series of the print functions, shared by the copies of the io
+	std::shared_ptr<MetricsSink> metrics;
+	// the series of the print functions, each is looked up in the metrics sink at its first row and then recorded by its number
+	enum class MetricsSeries { averageDensity, cflCondition, iterations, iterationTime, viscosityIterations, timeStep, sleepingParticles,
+							   particleUpdates, particleCount, frameWriter, last };
+	mutable std::vector<int> metrics_series = std::vector<int>(static_cast<size_t>(MetricsSeries::last), -1);
+	// a row of a print function which is held back until release_metrics
+	struct HeldRow
+	{
+		int series;
+		std::vector<double> values;
+	};
+	bool holding_metrics = false;
+	mutable std::vector<HeldRow> held_rows;
+	// record a row of a print function, or hold it back, the name and the columns are only used at the first row
+	void record(MetricsSeries series, const char* name, std::initializer_list<const char*> columns, std::initializer_list<double> values) const;
+	// record a row of a series of the metrics sink, or hold it back
+	void record(int series, std::initializer_list<double> values) const;
 public:
 	IO(const IO& io);
 	IO();
-	void decide_parameters(SimulationScenario& scenario, int& width, int& height, int& fluid_depth, float& particle_size,
-						   PressureComputationMethod& method, float& max_error, float& stiffness, float& viscosity, float& gravity, float& timeStep);
-	void save_picture(char* picture_data, int width, int height);
-	void print_average_density(float average_density) const;
-	void print_cfl_condition(const std::vector<Particle>& particles, float timeStep, float particleSize) const;
-	void print_iterations(int iterations) const;
+	// continue a run in the existing folder of that run
+	IO(const std::string& folder_name);
+	void decide_parameters(RunParameters& parameters);
+	// write the parameters to parameters.txt and as a run configuration to configuration.txt in the folder of this run
+	void save_parameters(const RunParameters& parameters) const;
+	// encode a picture and save it as the next numbered image file, can be called by several threads at once
+	void save_picture(const char* picture_data, int width, int height, const FrameEncoder& encoder);
+	// count a picture which was saved without save_picture, e.g. in a video
+	void count_picture();
+	// number of pictures saved so far, the next picture gets this number
+	int get_pictures() const;
+	void set_pictures(int pictures);
+	// choose the format of the files of the print functions, before anything is printed
+	void set_metrics_format(MetricsFormat format);
+	// write the values of the print functions which are still buffered
+	void flush_metrics() const;
+	// hold back the rows of the print functions, e.g. of a substep which may be rolled back
+	void hold_metrics();
+	// record the rows held back since hold_metrics if keep is true, otherwise discard them
+	void release_metrics(bool keep);
+	// name of a file in the folder of this simulation run
+	std::string get_file_name(const std::string& name) const;
+	// the print functions add a row to a time series, the step is the number of simulation steps performed before the row
+	void print_average_density(int step, float average_density) const;
+	void print_cfl_condition(int step, const std::vector<Particle>& particles, float timeStep, float particleSize) const;
+	void print_iterations(int step, int iterations) const;
+	void print_iteration_time(int step, float seconds) const;
+	void print_viscosity_iterations(int step, int iterations) const;
+	void print_time_step(int step, float time_step, int rollbacks) const;
+	// the saved time is estimated from the time of the awake particles, assuming that every particle costs the same
+	void print_sleeping_particles(int step, int awake_particles, float estimated_saved_time) const;
+	void print_particle_updates(int step, int particle_updates) const;
+	void print_particle_count(int step, int particles, int merged_particles) const;
+	void print_frame_writer(int step, int queue_depth, float frames_per_second, int dropped_frames) const;
+	// percentiles of the durations of each phase since the last call
+	void print_latencies(int step) const;
 };
@@ -1,14 +1,18 @@
 #include "IncompressibleSimulation.h"
+#include "Profiler.h"
 
-IncompressibleSimulation::IncompressibleSimulation(int width, int height, float particleSize, float fluidDensity, float viscosity, float gravity, IO* io, float error)
-	: Simulation(width, height, particleSize, fluidDensity, viscosity, gravity, io)
+template <int Dim, typename Real, typename Accumulator>
+BasicIncompressibleSimulation<Dim, Real, Accumulator>::BasicIncompressibleSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io, Real error)
+	: BasicSimulation<Dim, Real, Accumulator>(size, particleSize, fluidDensity, viscosity, gravity, io)
 {
 	this->max_error = error;
 }
 
 
-void IncompressibleSimulation::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicIncompressibleSimulation<Dim, Real, Accumulator>::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
 {
+	PROFILE_SCOPE("pressure solve");
 	/*
 	std::vector<glm::vec2> d_diagonal;
 	d_diagonal.resize(particles.size());
@@ -151,30 +155,38 @@ void IncompressibleSimulation::computePressures(const std::vector<std::vector<un
 
 
 	
-	std::vector<float> source;
+	std::vector<Accumulator> source;
 	source.resize(particles.size());
-	std::vector<float> a_diagonal;
+	std::vector<Accumulator> a_diagonal;
 	a_diagonal.resize(particles.size());
+	// sum of the kernel gradients of the boundary density map and the boundary shapes, divided by the particle mass like the sums over boundary particles
+	std::vector<vec> boundary_nabla_w;
+	boundary_nabla_w.resize(particles.size());
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
 		source[i] = 0;
 		a_diagonal[i] = 0;
-		if (particles[i].boundary)
+		boundary_nabla_w[i] = vec(Real(0));
+		if (!isUpdatedThisStep(i))
 		{
 			continue;
 		}
 
-		glm::vec2 sum_nabla_w_ij = glm::vec2(0, 0);
+		const BoundarySample boundary = getBoundarySample(i);
+		boundary_nabla_w[i] = boundary.densityGradient / particleMass;
+		vec sum_nabla_w_ij = boundary_nabla_w[i];
+		source[i] = glm::dot(particles[i].velocity, boundary_nabla_w[i]);
 		for (auto& j : neighborVector[i])
 		{
-			glm::vec2 nabla_w_ij = kernelGradient(particles[i].position, particles[j].position);
+			vec nabla_w_ij = kernelGradient(particles[i].position, particles[j].position);
 			sum_nabla_w_ij += nabla_w_ij;
 			source[i] += glm::dot(particles[i].velocity - particles[j].velocity, nabla_w_ij);
 		}
+		a_diagonal[i] = glm::dot(sum_nabla_w_ij, boundary_nabla_w[i]) + boundary.gradientSquared / (particleMass * particleMass);
 		for (auto& j : neighborVector[i])
 		{
-			glm::vec2 nabla_w_ij = kernelGradient(particles[i].position, particles[j].position);
+			vec nabla_w_ij = kernelGradient(particles[i].position, particles[j].position);
 			a_diagonal[i] += glm::dot(sum_nabla_w_ij + nabla_w_ij, nabla_w_ij);
 		}
 		source[i] *= -timeDifference * particleMass;
@@ -183,32 +195,34 @@ void IncompressibleSimulation::computePressures(const std::vector<std::vector<un
 		particles[i].pressure /= 2;
 	}
 
-	float error;
+	Accumulator error;
 	int iterations = 0;
 	do
 	{
+		PROFILE_SCOPE("pressure iteration");
 		error = 0;
 		int amountParticles = 0;
 
-		std::vector<glm::vec2> acc = computePressureAccelerations(neighborVector);
+		std::vector<vec> acc = computePressureAccelerations(neighborVector);
 		#pragma loop(hint_parallel(0))
 		for (unsigned int i = 0; i < particles.size(); ++i)
 		{
-			if (particles[i].boundary)
+			if (!isUpdatedThisStep(i))
 			{
 				continue;
 			}
-			float a_p = 0;
+			// the boundary has no acceleration
+			Accumulator a_p = glm::dot(acc[i], boundary_nabla_w[i]);
 			for (auto& j : neighborVector[i])
 			{
-				glm::vec2 nabla_w_ij = kernelGradient(particles[i].position, particles[j].position);
+				vec nabla_w_ij = kernelGradient(particles[i].position, particles[j].position);
 				a_p += glm::dot(acc[i] - acc[j], nabla_w_ij);
 			}
 			a_p *= timeDifference * timeDifference * particleMass;
 
 			if (a_diagonal[i] != 0)
 			{
-				particles[i].pressure += 0.5f * (source[i] - a_p) / a_diagonal[i];
+				particles[i].pressure += Real(Accumulator(0.5) * (source[i] - a_p) / a_diagonal[i]);
 				if (particles[i].pressure < 0)
 				{
 					particles[i].pressure = 0;
@@ -221,10 +235,11 @@ void IncompressibleSimulation::computePressures(const std::vector<std::vector<un
 			}
 			
 		}
-		error /= static_cast<float>(amountParticles);
+		error /= static_cast<Accumulator>(amountParticles);
 		++iterations;
 	} while (error >= max_error || iterations < 2);
-	io->print_iterations(iterations);
+	lastSolverIterations = iterations;
+	io->print_iterations(steps, iterations);
 	
 	/*
 	std::vector<float> diagonal;
@@ -296,4 +311,11 @@ void IncompressibleSimulation::computePressures(const std::vector<std::vector<un
 		error /= float(amountParticles);
 	} while (error >= 0.001);
 	*/
-}
\ No newline at end of file
+}
+
+template class BasicIncompressibleSimulation<2, float, float>;
+template class BasicIncompressibleSimulation<2, double, double>;
+template class BasicIncompressibleSimulation<2, float, double>;
+template class BasicIncompressibleSimulation<3, float, float>;
+template class BasicIncompressibleSimulation<3, double, double>;
+template class BasicIncompressibleSimulation<3, float, double>;
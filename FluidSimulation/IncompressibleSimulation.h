@@ -1,16 +1,33 @@
 #pragma once
 #include "IO.h"
 #include "Simulation.h"
-class IncompressibleSimulation :
-    public Simulation
+template <int Dim, typename Real = float, typename Accumulator = Real>
+class BasicIncompressibleSimulation :
+    public BasicSimulation<Dim, Real, Accumulator>
 {
 public:
-    IncompressibleSimulation(int width, int height, float particleSize, float fluidDensity, float viscosity, float gravity, IO* io, float max_error);
+    using typename BasicSimulation<Dim, Real, Accumulator>::vec;
+    using typename BasicSimulation<Dim, Real, Accumulator>::ivec;
+    using typename BasicSimulation<Dim, Real, Accumulator>::BoundarySample;
+    using BasicSimulation<Dim, Real, Accumulator>::kernelGradient;
+
+    BasicIncompressibleSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io, Real max_error);
 private:
+    using BasicSimulation<Dim, Real, Accumulator>::particles;
+    using BasicSimulation<Dim, Real, Accumulator>::fluidDensity;
+    using BasicSimulation<Dim, Real, Accumulator>::particleMass;
+    using BasicSimulation<Dim, Real, Accumulator>::io;
+    using BasicSimulation<Dim, Real, Accumulator>::steps;
+    using BasicSimulation<Dim, Real, Accumulator>::lastSolverIterations;
+    using BasicSimulation<Dim, Real, Accumulator>::isUpdatedThisStep;
+    using BasicSimulation<Dim, Real, Accumulator>::getBoundarySample;
+    using BasicSimulation<Dim, Real, Accumulator>::computePressureAccelerations;
+
     // compute pressures solving a linear system
-	void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference) override;
+	void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference) override;
 
     // desired density error
-    float max_error;
+    Real max_error;
 };
 
+using IncompressibleSimulation = BasicIncompressibleSimulation<2>;
@@ -0,0 +1,171 @@
+#include "LatencyHistogram.h"
+#include <memory>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+
+namespace
+{
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+	};
+
+	Registry& getRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+}
+
+LatencyHistogram& LatencyHistogram::get(const std::string& name)
+{
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (auto& histogram : registry.histograms)
+	{
+		if (histogram->name == name)
+		{
+			return *histogram;
+		}
+	}
+	registry.histograms.emplace_back(new LatencyHistogram(name));
+	return *registry.histograms.back();
+}
+
+std::vector<LatencyHistogram*> LatencyHistogram::getAll()
+{
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	std::vector<LatencyHistogram*> histograms;
+	for (auto& histogram : registry.histograms)
+	{
+		histograms.push_back(histogram.get());
+	}
+	return histograms;
+}
+
+void LatencyHistogram::printSummaries(std::ostream& stream)
+{
+	stream << std::left << std::setw(24) << "phase" << std::right << std::setw(10) << "count" << std::setw(12) << "p50 ms"
+		   << std::setw(12) << "p95 ms" << std::setw(12) << "p99 ms" << std::setw(12) << "max ms" << std::endl;
+	for (LatencyHistogram* histogram : getAll())
+	{
+		const LatencySummary summary = histogram->getSummary();
+		if (summary.count == 0)
+		{
+			continue;
+		}
+		stream << std::left << std::setw(24) << histogram->name << std::right << std::fixed << std::setprecision(3)
+			   << std::setw(10) << summary.count << std::setw(12) << 1E3 * summary.median << std::setw(12) << 1E3 * summary.percentile95
+			   << std::setw(12) << 1E3 * summary.percentile99 << std::setw(12) << 1E3 * summary.maximum << std::endl;
+	}
+	stream << std::defaultfloat;
+}
+
+LatencyHistogram::LatencyHistogram(const std::string& name) : name(name), intervalStart(bucketCount, 0)
+{
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+	const unsigned long long nanoseconds = duration.count() > 0 ? static_cast<unsigned long long>(duration.count()) : 0;
+	buckets[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+	unsigned long long previous = maximum.load(std::memory_order_relaxed);
+	while (nanoseconds > previous && !maximum.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed))
+	{
+	}
+	previous = intervalMaximum.load(std::memory_order_relaxed);
+	while (nanoseconds > previous && !intervalMaximum.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed))
+	{
+	}
+}
+
+const std::string& LatencyHistogram::getName() const
+{
+	return name;
+}
+
+LatencySummary LatencyHistogram::getSummary() const
+{
+	std::vector<unsigned long long> counts(bucketCount);
+	for (int bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		counts[bucket] = buckets[bucket].load(std::memory_order_relaxed);
+	}
+	return summarize(counts.data(), maximum.load(std::memory_order_relaxed));
+}
+
+LatencySummary LatencyHistogram::getIntervalSummary()
+{
+	std::lock_guard<std::mutex> lock(intervalMutex);
+	// the maximum is taken first, so that a duration recorded meanwhile is at worst counted in the next interval
+	const unsigned long long maximum = intervalMaximum.exchange(0, std::memory_order_relaxed);
+	std::vector<unsigned long long> counts(bucketCount);
+	for (int bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		const unsigned long long count = buckets[bucket].load(std::memory_order_relaxed);
+		counts[bucket] = count - intervalStart[bucket];
+		intervalStart[bucket] = count;
+	}
+	return summarize(counts.data(), maximum);
+}
+
+int LatencyHistogram::getBucket(unsigned long long nanoseconds)
+{
+	// short durations are counted exactly, longer ones by their power of two and their next bits
+	if (nanoseconds < 2 * subBuckets)
+	{
+		return static_cast<int>(nanoseconds);
+	}
+	const int exponent = std::ilogb(double(nanoseconds));
+	if (exponent > maxExponent)
+	{
+		return bucketCount - 1;
+	}
+	const int shift = exponent - subBucketBits;
+	return shift * subBuckets + static_cast<int>(nanoseconds >> shift);
+}
+
+unsigned long long LatencyHistogram::getBucketEnd(int bucket)
+{
+	if (bucket < 2 * subBuckets)
+	{
+		return bucket;
+	}
+	const int shift = bucket / subBuckets - 1;
+	const unsigned long long first = static_cast<unsigned long long>(bucket % subBuckets + subBuckets) << shift;
+	return first + (1ULL << shift) - 1;
+}
+
+LatencySummary LatencyHistogram::summarize(const unsigned long long* counts, unsigned long long maximum)
+{
+	LatencySummary summary;
+	for (int bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		summary.count += counts[bucket];
+	}
+	if (summary.count == 0)
+	{
+		return summary;
+	}
+
+	// the percentile is the end of the bucket of the duration with its rank, but never beyond the maximum
+	const double fractions[3] = { 0.5, 0.95, 0.99 };
+	double* percentiles[3] = { &summary.median, &summary.percentile95, &summary.percentile99 };
+	int percentile = 0;
+	long long counted = 0;
+	for (int bucket = 0; bucket < bucketCount && percentile < 3; ++bucket)
+	{
+		counted += counts[bucket];
+		while (percentile < 3 && counted >= std::ceil(fractions[percentile] * double(summary.count)))
+		{
+			*percentiles[percentile] = 1E-9 * double(std::min(getBucketEnd(bucket), maximum));
+			++percentile;
+		}
+	}
+	summary.maximum = 1E-9 * double(maximum);
+	return summary;
+}
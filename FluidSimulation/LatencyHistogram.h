@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <ostream>
+
+/**
+ *	Tail percentiles of a duration
+ */
+struct LatencySummary
+{
+	long long count = 0;
+	// seconds
+	double median = 0;
+	double percentile95 = 0;
+	double percentile99 = 0;
+	double maximum = 0;
+};
+
+/**
+ *	Histogram of the durations of a phase, which is always recorded. The buckets grow logarithmically and are divided linearly
+ *	into 64 buckets each, as in a HDR histogram, so that a percentile is exact to 1/64 from one nanosecond to 18 minutes.
+ *	Recording a duration only increments atomic counters without a lock, so several threads can record at once.
+ *	The histograms are registered by their names and live until the program ends.
+ */
+class LatencyHistogram
+{
+public:
+	/**
+	 *	Find or create the histogram of a phase, which is slow. The callers keep the reference, e.g. in a static variable.
+	 *	@param name name of the phase
+	 */
+	static LatencyHistogram& get(const std::string& name);
+
+	/**
+	 *	@return all histograms in the order they were created
+	 */
+	static std::vector<LatencyHistogram*> getAll();
+
+	/**
+	 *	Print the percentiles of all histograms since the start of the program
+	 */
+	static void printSummaries(std::ostream& stream);
+
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	void record(std::chrono::nanoseconds duration);
+
+	const std::string& getName() const;
+
+	/**
+	 *	@return percentiles of all recorded durations
+	 */
+	LatencySummary getSummary() const;
+
+	/**
+	 *	@return percentiles of the durations recorded since the last call, for periodic reports by one thread
+	 */
+	LatencySummary getIntervalSummary();
+
+private:
+	static const int subBucketBits = 6;
+	static const int subBuckets = 1 << subBucketBits;
+	// largest power of two of a duration in nanoseconds, longer durations are counted in the last bucket
+	static const int maxExponent = 40;
+	static const int bucketCount = (maxExponent - subBucketBits + 2) * subBuckets;
+
+	explicit LatencyHistogram(const std::string& name);
+
+	static int getBucket(unsigned long long nanoseconds);
+	// largest duration in nanoseconds counted in a bucket
+	static unsigned long long getBucketEnd(int bucket);
+	static LatencySummary summarize(const unsigned long long* counts, unsigned long long maximum);
+
+	std::string name;
+	std::atomic<unsigned long long> buckets[bucketCount] = {};
+	std::atomic<unsigned long long> maximum{ 0 };
+	std::atomic<unsigned long long> intervalMaximum{ 0 };
+
+	// counts of the buckets at the last interval summary
+	std::mutex intervalMutex;
+	std::vector<unsigned long long> intervalStart;
+};
+
+/**
+ *	Records its own lifetime in a histogram
+ */
+class LatencyTimer
+{
+public:
+	explicit LatencyTimer(LatencyHistogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~LatencyTimer()
+	{
+		histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+	}
+
+	LatencyTimer(const LatencyTimer&) = delete;
+	LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+	LatencyHistogram& histogram;
+	std::chrono::steady_clock::time_point start;
+};
@@ -1,164 +1,579 @@
+#ifndef FLUID_HEADLESS
 #include "GUI.h"
+#endif
+#include "SoftwareRenderer.h"
 #include "Simulation.h"
 #include "IncompressibleSimulation.h"
 #include "CompressibleSimulation.h"
+#include "PredictiveCorrectiveSimulation.h"
+#include "PositionBasedSimulation.h"
+#include "Scenario.h"
+#include "Benchmark.h"
+#include "FrameController.h"
+#include "FrameWriter.h"
+#include "FrameSink.h"
+#include "Snapshot.h"
+#include "Checkpoint.h"
+#include "Trajectory.h"
+#include "Profiler.h"
+#include "LatencyHistogram.h"
+#include "RunConfiguration.h"
 #include <glm/glm.hpp>
 #include <vector>
 #include <queue>
 #include <random>
 #include <ctime>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <csignal>
 #include "IO.h"
 
 
+// set by SIGINT and SIGTERM, e.g. by Ctrl+C or the job scheduler of a compute node, so that the run ends with complete files
+volatile std::sig_atomic_t stopRequested = 0;
 
-void createSimulationScenario(Simulation& simulation, const SimulationScenario environment, const int fluid_depth)
+void requestStop(int signal)
+{
+	stopRequested = 1;
+	// a second signal ends the run at once, e.g. if the last picture can't be written
+	std::signal(signal, SIG_DFL);
+}
+
+/**
+ *	Create the simulation chosen by the parameters, with its scenario
+ */
+template <int Dim>
+BasicSimulation<Dim>* createSimulation(const RunParameters& parameters, IO* io)
+{
+	// the z-axis of a 3D simulation has the size depth
+	typename Dimension<Dim>::ivec size(parameters.depth);
+	size[0] = parameters.width;
+	size[1] = parameters.height;
+
+	BasicSimulation<Dim>* simulation;
+	switch (parameters.method)
+	{
+	case PressureComputationMethod::compressible:
+		simulation = new BasicCompressibleSimulation<Dim>(size, parameters.particle_size, 1, parameters.viscosity, parameters.gravity, io, parameters.stiffness);
+		break;
+	case PressureComputationMethod::predictiveCorrective:
+		simulation = new BasicPredictiveCorrectiveSimulation<Dim>(size, parameters.particle_size, 1, parameters.viscosity, parameters.gravity, io,
+			parameters.max_error, parameters.min_iterations, parameters.max_iterations);
+		break;
+	case PressureComputationMethod::positionBased:
+		simulation = new BasicPositionBasedSimulation<Dim>(size, parameters.particle_size, 1, parameters.viscosity, parameters.gravity, io, parameters.max_iterations);
+		break;
+	case PressureComputationMethod::incompressible:
+	default:
+		simulation = new BasicIncompressibleSimulation<Dim>(size, parameters.particle_size, 1, parameters.viscosity, parameters.gravity, io, parameters.max_error);
+		break;
+	}
+
+	simulation->setViscosityMethod(parameters.viscosity_method);
+	if (parameters.adaptive_time_step)
+	{
+		simulation->setAdaptiveTimeStep(parameters.min_time_step, parameters.max_time_step);
+	}
+	if (parameters.sleeping)
+	{
+		// a particle which moves less than 10% of its size per second and is compressed less than 0.1% for 50 steps falls asleep
+		simulation->setSleeping(0.1f * parameters.particle_size, 1E-3f, 50);
+	}
+	simulation->setMultirate(parameters.multirate_levels);
+	if (parameters.adaptive_resolution)
+	{
+		// merge particles more than 6 particle sizes below the surface, split them again at 4 particle sizes,
+		// merged particles are merged again 18 particle sizes below the surface and split at 12
+		simulation->setAdaptiveResolution(6 * parameters.particle_size, 4 * parameters.particle_size, 1.f);
+	}
+
+	createSimulationScenario(*simulation, parameters.scenario, parameters.fluid_depth, parameters.boundary_method);
+	if (parameters.boundary_method == BoundaryHandlingMethod::densityMap)
+	{
+		// a quarter of the particle size keeps the interpolation error of the map well below the density error of the solvers
+		simulation->createBoundaryDensityMap(parameters.particle_size / 4);
+	}
+	return simulation;
+}
+
+/**
+ *	Print the latencies and the profile of the run and save them in its folder, after the writer threads have finished
+ */
+void saveRunStatistics(IO* io, int steps)
+{
+	io->print_latencies(steps);
+	LatencyHistogram::printSummaries(std::cout);
+	std::ofstream latencies(io->get_file_name("latencies.txt"));
+	LatencyHistogram::printSummaries(latencies);
+#ifdef FLUID_PROFILING
+	// the writer threads have finished, so their phases are complete
+	Profiler::printStatistics(std::cout);
+	std::ofstream profile(io->get_file_name("profile.txt"));
+	Profiler::printStatistics(profile);
+	Profiler::writeTrace(io->get_file_name("trace.json"));
+#endif
+}
+
+/**
+ *	Run a 3D simulation until max_frames frames are simulated or the run is stopped, 0 for no limit.
+ *	There is no renderer for 3D particles, only the metrics of the simulation and the latencies are saved.
+ */
+void runVolumeSimulation(const RunParameters& parameters, IO* io, int max_frames)
+{
+	BasicSimulation<3>* simulation = createSimulation<3>(parameters, io);
+	FrameController frameController(parameters.timeStep, parameters.substeps, parameters.frame_time);
+	frameController.fastForward(parameters.fast_forward_steps);
+
+	int frames = 0;
+	LatencyHistogram& frameLatency = LatencyHistogram::get("frame");
+	auto lastLatencies = std::chrono::steady_clock::now();
+	while (!stopRequested && (max_frames == 0 || frames < max_frames))
+	{
+		PROFILE_SCOPE("frame");
+		LatencyTimer frameTimer(frameLatency);
+		if (!frameController.advanceFrame(*simulation))
+		{
+			continue;
+		}
+		if (std::chrono::steady_clock::now() - lastLatencies >= std::chrono::seconds(1))
+		{
+			io->print_latencies(simulation->getSteps());
+			lastLatencies = std::chrono::steady_clock::now();
+		}
+		++frames;
+	}
+
+	saveRunStatistics(io, simulation->getSteps());
+	if (stopRequested)
+	{
+		std::cout << "Stopped after " << frames << " frames" << std::endl;
+	}
+	delete simulation;
+}
+
+/**
+ *	Give the renderer the area of the boundary shapes, which have no particles that could be drawn
+ */
+void drawBoundaryShapes(const Simulation& simulation, Renderer& renderer)
 {
-	std::random_device rd;
-	std::mt19937 mt(rd());
-	std::uniform_real_distribution<double> dist(0.0f, 1.0f);
-	
-	const float particle_size = simulation.getParticleSize();
 	const int width = simulation.getWidth();
 	const int height = simulation.getHeight();
-	
-	// Add boundary particles
-	for (int x = 0; x < 3 * int(particle_size); x += int(particle_size))
+	std::vector<float> coverage(size_t(width) * size_t(height));
+	for (int y = 0; y < height; ++y)
 	{
-		for (int y = 0; y <= height; y += int(particle_size))
+		for (int x = 0; x < width; ++x)
 		{
-			simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
-			simulation.addParticle(glm::vec2(width - x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
+			// a pixel whose center lies on the surface is half covered
+			const float distance = simulation.getBoundaryDistance(glm::vec2(float(x) + 0.5f, float(y) + 0.5f));
+			coverage[size_t(y) * size_t(width) + size_t(x)] = glm::clamp(0.5f - distance, 0.f, 1.f);
 		}
 	}
+	renderer.set_boundary(coverage, width, height);
+}
+
+/**
+ *	Read an optional integer argument, e.g. the number of frames of a benchmark
+ *	@param index the position of the argument, the value is kept if there are fewer arguments
+ *	@return false if the argument isn't an integer, the reason is printed
+ */
+bool readIntegerArgument(int argc, char* argv[], int index, int& value)
+{
+	if (index < argc && !parseInteger(argv[index], value))
+	{
+		std::cout << "unknown argument " << argv[index] << std::endl;
+		return false;
+	}
+	return true;
+}
 
-	for (int x = 3 * int(particle_size); x <= width - 3 * int(particle_size); x += int(particle_size))
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
 	{
-		for (int y = 0; y < 3 * int(particle_size); y += int(particle_size))
+		// compare explicit and implicit viscosity with a high viscosity
+		IO* io = new IO();
+		runViscosityBenchmark(io, 2000, 0.01f, 0.05f);
+		delete io;
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-dimensions")
+	{
+		// headless 2D and 3D runs, the 3D simulation has no renderer yet
+		int steps = 200;
+		if (!readIntegerArgument(argc, argv, 2, steps))
 		{
-			simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
+			return 1;
 		}
+		IO* io = new IO();
+		runDimensionBenchmark(io, steps);
+		delete io;
+		return 0;
 	}
-	
-	switch(environment)
+
+	if (argc > 2 && std::string(argv[1]) == "--dump-snapshot")
 	{
-	case SimulationScenario::leakyDam:
-		for (int x = width / 2 + (width / 2) % int(particle_size); x < width / 2 + (width / 2) % int(particle_size) + 6 * particle_size; x += int(particle_size))
+		// print the index of a snapshot file, or the particles of one frame if a frame is given
+		int frame = -1;
+		if (!readIntegerArgument(argc, argv, 3, frame))
 		{
-			for (int y = 3 * int(particle_size); y < height / 6; y += int(particle_size))
-			{
-				simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
-			}
+			return 1;
+		}
+		return dumpSnapshot(argv[2], frame);
+	}
 
-			for (int y = height / 6 + 5 * int(particle_size); y <= height; y += int(particle_size))
-			{
-				simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
-			}
+	if (argc > 2 && std::string(argv[1]) == "--dump-trajectory")
+	{
+		// print the index of a trajectory file, or the decoded particles of one frame if a frame is given
+		int frame = -1;
+		if (!readIntegerArgument(argc, argv, 3, frame))
+		{
+			return 1;
 		}
-	case SimulationScenario::breakingDam:
-		for (int x = 3 * int(particle_size); x < width / 2; x += int(particle_size))
+		return dumpTrajectory(argv[2], frame);
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-trajectory")
+	{
+		// bytes per frame of the snapshots and of trajectories with several error bounds
+		int frames = 200;
+		if (!readIntegerArgument(argc, argv, 2, frames))
 		{
-			for (int y = 3 * int(particle_size); y < (3 + fluid_depth) * int(particle_size); y += int(particle_size))
-			{
-				simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
-			}
+			return 1;
 		}
-		break;
+		IO* io = new IO();
+		runTrajectoryBenchmark(io, frames);
+		delete io;
+		return 0;
+	}
 
-	case SimulationScenario::droppingFluid:
-		for (int x = width / 3; x <= 2 * width / 3; x += int(particle_size))
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-encoders")
+	{
+		// size and speed of the image formats, no window needed
+		int frames = 50;
+		if (!readIntegerArgument(argc, argv, 2, frames))
 		{
-			for (int y = 3 * int(particle_size); y <= (height / 3) + fluid_depth * int(particle_size); y += int(particle_size))
-			{
-				if (y <= height / 3)
-				{
-					simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
-				}
-				else
-				{
-					simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
-				}
-			}
+			return 1;
 		}
-		break;
+		IO* io = new IO();
+		runEncoderBenchmark(io, frames, glm::max(int(std::thread::hardware_concurrency()) / 4, 1));
+		delete io;
+		return 0;
+	}
 
-	case SimulationScenario::flowingFluid:
-		for (int x = 3 * int(particle_size); x <= width / 2; x += int(particle_size))
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-precision")
+	{
+		// a deep column where the sums over many particles are large compared to their differences
+		int depth = 100;
+		int steps = 500;
+		if (!readIntegerArgument(argc, argv, 2, depth) || !readIntegerArgument(argc, argv, 3, steps))
 		{
-			for (int i = 0; i < fluid_depth + 3; ++i)
-			{
-				bool boundary = i < 3 ? true : false;
-				simulation.addParticle(glm::vec2(x, int(3 * particle_size + width / 4 - x / 2 + i * particle_size)), 
-								       glm::vec3(0.5f, 0.5f, 0.5f), boundary);
-			}
+			return 1;
 		}
-		break;
+		IO* io = new IO();
+		runPrecisionBenchmark(io, depth, steps);
+		delete io;
+		return 0;
+	}
 
-	case SimulationScenario::restingFluid:
-		for (int x = 3 * int(particle_size); x <= width - 3 * int(particle_size); x += int(particle_size))
+	// --headless runs without a window and draws the pictures on the CPU, --frames ends the run after a number of pictures,
+	// --config and --<parameter> <value> give the parameters of the run instead of the prompts, --resume continues a run
+	bool headless = false;
+	int max_frames = 0;
+	std::string checkpoint_file;
+	std::string configuration_file;
+	std::vector<std::pair<std::string, std::string>> assignments;
+	for (int argument = 1; argument < argc; ++argument)
+	{
+		const std::string name = argv[argument];
+		const bool hasValue = argument + 1 < argc;
+		if (name == "--headless")
+		{
+			headless = true;
+		}
+#ifdef FLUID_PROFILING
+		else if (name == "--counters")
+		{
+			// read by the profiler
+		}
+#endif
+		else if (name == "--frames" && hasValue)
 		{
-			for (int y = 3 * int(particle_size); y < (3 + fluid_depth) * int(particle_size); y += int(particle_size))
+			if (!readIntegerArgument(argc, argv, ++argument, max_frames))
 			{
-				simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
+				return 1;
 			}
 		}
-		break;
-		
-	default:
-		break;
+		else if (name == "--resume" && hasValue)
+		{
+			checkpoint_file = argv[++argument];
+		}
+		else if (name == "--config" && hasValue)
+		{
+			configuration_file = argv[++argument];
+		}
+		else if (name.compare(0, 2, "--") == 0 && isRunParameter(name.substr(2)) && hasValue)
+		{
+			assignments.emplace_back(name.substr(2), argv[++argument]);
+		}
+		else
+		{
+			// a mistyped parameter of a scripted run would otherwise be replaced by its default without notice
+			std::cout << "unknown argument " << name << std::endl;
+			return 1;
+		}
 	}
-}
+#ifdef FLUID_HEADLESS
+	// built without GLFW and OpenGL
+	headless = true;
+#endif
+
+	std::signal(SIGINT, requestStop);
+	std::signal(SIGTERM, requestStop);
+#ifndef _WIN32
+	// a closed ffmpeg pipe is reported by the frame sink instead of ending the program
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
 
-int main(int argc, char* argv[])
-{
 	std::random_device rd;
 	std::mt19937 mt(rd());
 	std::uniform_real_distribution<double> dist(0.0f, 1.0f);
 
-	int width;
-	int height;
-	SimulationScenario scenario;
-	int fluid_depth;
-	PressureComputationMethod method;
-	float particle_size, viscosity, gravity, stiffness, timeStep, max_error;
-	IO* io = new IO();
-	io->decide_parameters( scenario, width, height, fluid_depth, particle_size, method, max_error, stiffness, viscosity, gravity, timeStep);
+	RunParameters parameters;
+	IO* io;
+	CheckpointReader* checkpoint = nullptr;
+	if (!checkpoint_file.empty())
+	{
+		// continue a run from its checkpoint, in its folder and with its parameters
+		if (!configuration_file.empty() || !assignments.empty())
+		{
+			std::cout << "--resume uses the parameters of the checkpoint, it can't be combined with --config or parameters" << std::endl;
+			return 1;
+		}
+		checkpoint = new CheckpointReader(checkpoint_file);
+		if (!checkpoint->isOpen())
+		{
+			delete checkpoint;
+			return 1;
+		}
+		parameters = checkpoint->getParameters();
+		io = new IO(std::filesystem::path(checkpoint_file).parent_path().string());
+		io->set_pictures(checkpoint->getPictures());
+		io->set_metrics_format(parameters.metrics_format);
+	}
+	else if (!configuration_file.empty() || !assignments.empty())
+	{
+		// the parameters of the command line override the file, the prompts are skipped
+		if (!configuration_file.empty() && !loadRunConfiguration(configuration_file, parameters))
+		{
+			return 1;
+		}
+		for (auto& assignment : assignments)
+		{
+			if (!setRunParameter(parameters, assignment.first, assignment.second))
+			{
+				return 1;
+			}
+		}
+		if (!validateRunParameters(parameters))
+		{
+			return 1;
+		}
+		io = new IO();
+		io->set_metrics_format(parameters.metrics_format);
+		io->save_parameters(parameters);
+	}
+	else
+	{
+		io = new IO();
+		io->decide_parameters(parameters);
+		// the prompts check each answer on its own, e.g. a deep fluid may not fit into a small domain
+		if (!validateRunParameters(parameters))
+		{
+			delete io;
+			return 1;
+		}
+	}
 
-	// Create GUI and simulation
-	
-	GUI gui(width, height, particle_size);
-	Simulation* simulation;
-	switch (method)
+	if (parameters.dimensions == 3)
 	{
-	case PressureComputationMethod::compressible:
-		simulation = new CompressibleSimulation(width, height, particle_size, 1, viscosity, gravity, io, stiffness);
+		runVolumeSimulation(parameters, io, max_frames);
+		delete io;
+		return 0;
+	}
+
+	// Create renderer and simulation
+	Renderer* renderer = nullptr;
+#ifndef FLUID_HEADLESS
+	if (!headless)
+	{
+		renderer = new GUI(parameters.width, parameters.height, parameters.particle_size);
+	}
+#endif
+	// without a window the pictures are only drawn if they are saved
+	if (headless && parameters.frame_format != FrameOutputFormat::none)
+	{
+		renderer = new SoftwareRenderer(parameters.width, parameters.height, parameters.particle_size);
+	}
+	Simulation* simulation = createSimulation<2>(parameters, io);
+	if (renderer && parameters.boundary_method == BoundaryHandlingMethod::shapes)
+	{
+		drawBoundaryShapes(*simulation, *renderer);
+	}
+
+	FrameController frameController(parameters.timeStep, parameters.substeps, parameters.frame_time);
+	frameController.fastForward(parameters.fast_forward_steps);
+
+	// the pictures of a continued run are numbered after the pictures of the checkpoint,
+	// the files which hold all frames get the number of the first simulation step, so that the earlier ones are kept
+	const int first_picture = checkpoint ? checkpoint->getPictures() : 0;
+	std::string suffix;
+	if (checkpoint)
+	{
+		const bool restored = checkpoint->restore(*simulation, frameController);
+		delete checkpoint;
+		if (!restored)
+		{
+			delete simulation;
+			delete renderer;
+			delete io;
+			return 1;
+		}
+		suffix = "_" + std::to_string(frameController.getSteps());
+		std::cout << "Continuing after " << frameController.getSteps() << " steps and " << first_picture << " pictures" << std::endl;
+	}
+
+	// the videos play the pictures in real time if there is a fixed physical time between them
+	const int frames_per_second = parameters.frame_time > 0 ? glm::max(int(1 / parameters.frame_time + 0.5f), 1) : 30;
+	FrameSink* frameSink;
+	switch (parameters.frame_format)
+	{
+	case FrameOutputFormat::none:
+		frameSink = nullptr;
 		break;
-	case PressureComputationMethod::incompressible:
+	case FrameOutputFormat::video:
+		frameSink = new Y4mFrameSink(io, io->get_file_name("video" + suffix + ".y4m"), frames_per_second);
+		break;
+	case FrameOutputFormat::archive:
+		frameSink = new ArchiveFrameSink(io, io->get_file_name("frames" + suffix + ".flfa"));
+		break;
+	case FrameOutputFormat::encoder:
+		frameSink = Y4mFrameSink::openEncoder(io, frames_per_second,
+			"ffmpeg -loglevel error -y -f yuv4mpegpipe -i - -c:v libx264 -pix_fmt yuv420p \"" + io->get_file_name("video" + suffix + ".mp4") + "\"");
+		break;
+	case FrameOutputFormat::images:
 	default:
-		simulation = new IncompressibleSimulation(width, height, particle_size, 1, viscosity, gravity, io, max_error);
+		// by default a quarter of the cores encode the pictures, the others are left to the simulation
+		frameSink = new ImageFrameSink(io, FrameEncoder::create(parameters.frame_encoding),
+			parameters.encoder_threads > 0 ? parameters.encoder_threads : glm::max(int(std::thread::hardware_concurrency()) / 4, 1));
 		break;
 	}
+	// eight pictures are buffered, enough to bridge a slow write without holding much memory for large windows
+	FrameWriter* frameWriter = frameSink ? new FrameWriter(frameSink, parameters.width, parameters.height, 8, parameters.frame_policy) : nullptr;
+	SnapshotWriter* snapshotWriter = parameters.save_snapshots ? new SnapshotWriter(io->get_file_name("particles" + suffix + ".flsn")) : nullptr;
+	TrajectoryWriter* trajectoryWriter = nullptr;
+	if (parameters.trajectory_position_error > 0)
+	{
+		trajectoryWriter = new TrajectoryWriter(io->get_file_name("trajectory" + suffix + ".fltr"), parameters.particle_size,
+			parameters.trajectory_position_error, parameters.trajectory_velocity_error, parameters.trajectory_keyframe_interval);
+	}
+	CheckpointWriter* checkpointWriter = parameters.checkpoint_interval > 0 ? new CheckpointWriter(io->get_file_name("checkpoint.flcp"), parameters) : nullptr;
+	int frames = 0;
 
-	createSimulationScenario(*simulation, scenario, fluid_depth);
+#ifdef FLUID_PROFILING
+	// about 32 MB of phases for the trace
+	PROFILE_THREAD("simulation");
+	Profiler::enableTrace(1 << 20);
+	for (int argument = 1; argument < argc; ++argument)
+	{
+		if (std::string(argv[argument]) == "--counters")
+		{
+			Profiler::enableCounters();
+		}
+	}
+#endif
+
+	LatencyHistogram& frameLatency = LatencyHistogram::get("frame");
+	auto lastLatencies = std::chrono::steady_clock::now();
 
-	while(gui.update())
+	while (!stopRequested && (max_frames == 0 || frames < max_frames) && (!renderer || renderer->update()))
 	{
 		// Repeat this as long as the window isn't closed
+		PROFILE_SCOPE("frame");
+		LatencyTimer frameTimer(frameLatency);
 
-		// only one simulation step per draw
-		simulation->performSimulationStep(timeStep);
+		if (renderer && renderer->fast_forward_requested())
+		{
+			frameController.fastForward(parameters.fast_forward_steps > 0 ? parameters.fast_forward_steps : 100);
+		}
+
+		// do the simulation steps of one frame, nothing is drawn or saved while fast-forwarding
+		if (!frameController.advanceFrame(*simulation))
+		{
+			continue;
+		}
 		
+		if (snapshotWriter)
+		{
+			snapshotWriter->writeFrame(simulation->getParticles(), frameController.getSimulatedTime());
+		}
+		if (trajectoryWriter)
+		{
+			trajectoryWriter->writeFrame(simulation->getParticles(), frameController.getSimulatedTime());
+		}
+
 		// Get the particle positions in the simulation and draw them
-		gui.draw(simulation->getParticles());
+		if (renderer)
+		{
+			renderer->draw(simulation->getParticles());
+		}
+
+		// there is a frame writer only if the pictures are saved, then there is also a renderer
+		char* picture_data = frameWriter ? frameWriter->acquireFrame() : nullptr;
+		if (picture_data)
+		{
+			renderer->get_picture_data(picture_data, parameters.width, parameters.height);
+			frameWriter->submitFrame();
+		}
+		if (frameWriter)
+		{
+			io->print_frame_writer(simulation->getSteps(), frameWriter->getQueueDepth(), frameWriter->getThroughput(), frameWriter->getDroppedFrames());
+		}
 
-		char* picture_data = gui.get_picture_data();
-		io->save_picture(picture_data, width, height);
-		delete[] picture_data;
+		io->print_cfl_condition(simulation->getSteps(), simulation->getParticles(), simulation->getLastTimeStep(), parameters.particle_size);
 
-		io->print_cfl_condition(simulation->getParticles(), timeStep, particle_size);
+		// the percentiles of each second show spikes, which the percentiles of the whole run would hide
+		if (std::chrono::steady_clock::now() - lastLatencies >= std::chrono::seconds(1))
+		{
+			io->print_latencies(simulation->getSteps());
+			lastLatencies = std::chrono::steady_clock::now();
+		}
+
+		// the checkpoint holds the state after this picture, a continued run starts with the next one
+		++frames;
+		if (checkpointWriter && frames % parameters.checkpoint_interval == 0)
+		{
+			checkpointWriter->write(*simulation, frameController, first_picture + (frameWriter ? frameWriter->getSubmittedFrames() : 0));
+		}
 	}
 	
+	// save the queued pictures before the io is deleted
+	delete frameWriter;
+	delete frameSink;
+	delete snapshotWriter;
+	delete trajectoryWriter;
+	delete checkpointWriter;
+	saveRunStatistics(io, simulation->getSteps());
+	if (stopRequested)
+	{
+		std::cout << "Stopped after " << frames << " pictures" << std::endl;
+	}
 	delete simulation;
+	delete renderer;
 	delete io;
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "Metrics.h"
+#include "Profiler.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+namespace
+{
+	const uint32_t metricsVersion = 1;
+
+	// a batch is written early if this many values are pending, so that a fast simulation doesn't collect too much memory
+	const size_t maxPendingValues = 1 << 16;
+}
+
+MetricsSink::MetricsSink(const std::string& folder_name, MetricsFormat format, std::chrono::milliseconds flush_interval)
+{
+	this->folderName = folder_name;
+	this->format = format;
+	this->flushInterval = flush_interval;
+	thread = std::thread(&MetricsSink::run, this);
+}
+
+MetricsSink::~MetricsSink()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	batchRequested.notify_one();
+	thread.join();
+}
+
+int MetricsSink::addSeries(const std::string& name, std::initializer_list<const char*> columns)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t handle = 0; handle < series.size(); ++handle)
+	{
+		if (series[handle]->name == name)
+		{
+			return static_cast<int>(handle);
+		}
+	}
+	series.emplace_back(new Series());
+	series.back()->name = name;
+	series.back()->columns.assign(columns.begin(), columns.end());
+	return static_cast<int>(series.size() - 1);
+}
+
+void MetricsSink::record(int handle, std::initializer_list<double> values)
+{
+	recordRow(handle, values);
+}
+
+void MetricsSink::record(int handle, const std::vector<double>& values)
+{
+	recordRow(handle, values);
+}
+
+template <typename Values>
+void MetricsSink::recordRow(int handle, const Values& values)
+{
+	// the lock is only shared with the writer thread, which holds it to swap the buffers of a batch
+	std::unique_lock<std::mutex> lock(mutex);
+	Series* target = series[handle].get();
+	if (values.size() != target->columns.size())
+	{
+		std::cout << "the row of " << target->name << " has " << values.size() << " instead of " << target->columns.size() << " values" << std::endl;
+		return;
+	}
+
+	target->pending.insert(target->pending.end(), values.begin(), values.end());
+	pendingValues += values.size();
+	++recordedRows;
+	if (pendingValues >= maxPendingValues)
+	{
+		pendingValues = 0;
+		++requestedBatches;
+		lock.unlock();
+		batchRequested.notify_one();
+	}
+}
+
+void MetricsSink::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const unsigned long long batch = ++requestedBatches;
+	batchRequested.notify_one();
+	batchWritten.wait(lock, [&]() { return writtenBatches >= batch; });
+}
+
+long long MetricsSink::getRecordedRows() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return recordedRows;
+}
+
+void MetricsSink::run()
+{
+	PROFILE_THREAD("metrics writer");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		batchRequested.wait_for(lock, flushInterval, [&]() { return stopping || requestedBatches > writtenBatches; });
+		const bool stop = stopping;
+		const unsigned long long batch = requestedBatches;
+
+		// take the pending rows of all series, the simulation continues recording into the emptied buffers
+		std::vector<Series*> batchSeries;
+		for (auto& existing : series)
+		{
+			if (!existing->pending.empty())
+			{
+				std::swap(existing->pending, existing->writing);
+				batchSeries.push_back(existing.get());
+			}
+		}
+		pendingValues = 0;
+		lock.unlock();
+
+		for (Series* target : batchSeries)
+		{
+			PROFILE_SCOPE("write metrics");
+			if (!target->file.is_open())
+			{
+				openFile(*target);
+			}
+			writeRows(*target);
+			target->writing.clear();
+		}
+
+		lock.lock();
+		writtenBatches = batch;
+		batchWritten.notify_all();
+		if (stop)
+		{
+			return;
+		}
+	}
+}
+
+void MetricsSink::openFile(Series& series)
+{
+	const std::string file_name = folderName + "/" + series.name + (format == MetricsFormat::binary ? ".flmt" : ".txt");
+	const std::ios_base::openmode mode = format == MetricsFormat::binary ? std::ios_base::binary : std::ios_base::openmode();
+	series.file.open(file_name, std::ios_base::out | std::ios_base::app | mode);
+	if (!series.file.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+		return;
+	}
+	series.file.seekp(0, std::ios_base::end);
+	if (series.file.tellp() > 0)
+	{
+		return;
+	}
+
+	if (format == MetricsFormat::binary)
+	{
+		const uint32_t columnCount = static_cast<uint32_t>(series.columns.size());
+		series.file.write("FLMT", 4);
+		series.file.write(reinterpret_cast<const char*>(&metricsVersion), sizeof(metricsVersion));
+		series.file.write(reinterpret_cast<const char*>(&columnCount), sizeof(columnCount));
+		for (auto& column : series.columns)
+		{
+			series.file.write(column.c_str(), column.size() + 1);
+		}
+	}
+	else
+	{
+		std::stringstream header;
+		for (size_t column = 0; column < series.columns.size(); ++column)
+		{
+			header << (column > 0 ? "\t" : "") << series.columns[column];
+		}
+		header << "\n";
+		series.file << header.str();
+	}
+}
+
+void MetricsSink::writeRows(Series& series)
+{
+	if (!series.file.is_open())
+	{
+		return;
+	}
+	const size_t columns = series.columns.size();
+	const size_t rows = series.writing.size() / columns;
+	if (format == MetricsFormat::binary)
+	{
+		// the rows are stored column after column, so that a reader can load a column at once
+		const uint32_t header[2] = { static_cast<uint32_t>(rows), 0 };
+		std::vector<double> block(series.writing.size());
+		for (size_t row = 0; row < rows; ++row)
+		{
+			for (size_t column = 0; column < columns; ++column)
+			{
+				block[column * rows + row] = series.writing[row * columns + column];
+			}
+		}
+		series.file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		series.file.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(double));
+	}
+	else
+	{
+		std::stringstream lines;
+		for (size_t row = 0; row < rows; ++row)
+		{
+			for (size_t column = 0; column < columns; ++column)
+			{
+				lines << (column > 0 ? "\t" : "") << series.writing[row * columns + column];
+			}
+			lines << "\n";
+		}
+		series.file << lines.str();
+	}
+	series.file.flush();
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <initializer_list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "IO.h"
+
+/**
+ *	Collects named time series of the simulation in memory and writes them in batches on a background thread,
+ *	so that recording a value doesn't touch the disk. Each series is a table with fixed columns and gets its own file:
+ *	text:	name.txt, a line with the column names and a line per row, separated by tabs
+ *	binary:	name.flmt, "FLMT", uint32 version (1), uint32 number of columns, the column names each terminated by a zero byte,
+ *			then one block per batch: uint32 number of rows, uint32 reserved, the values of each column as float64, column after column
+ *	Existing files are continued, e.g. when a run is continued from a checkpoint.
+ */
+class MetricsSink
+{
+public:
+	/**
+	 *	Create a new metrics sink and start its thread
+	 *	@param folder_name folder of the files
+	 *	@param format format of the files
+	 *	@param flush_interval time between two batches
+	 */
+	MetricsSink(const std::string& folder_name, MetricsFormat format, std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000));
+
+	/**
+	 *	Write the remaining rows and stop the thread
+	 */
+	~MetricsSink();
+
+	MetricsSink(const MetricsSink&) = delete;
+	MetricsSink& operator=(const MetricsSink&) = delete;
+
+	/**
+	 *	Look up a series by its name, it is created with the columns if it doesn't exist yet.
+	 *	The rows are recorded with the returned number, so that recording a row doesn't compare names.
+	 *	@param name name of the series, which is also the name of its file
+	 *	@param columns names of the columns, only used when the series is created
+	 *	@return the number of the series, which stays valid as long as the sink exists
+	 */
+	int addSeries(const std::string& name, std::initializer_list<const char*> columns);
+
+	/**
+	 *	Append a row to a series, can be called by several threads at once
+	 *	@param handle the number of the series returned by addSeries
+	 *	@param values one value per column
+	 */
+	void record(int handle, std::initializer_list<double> values);
+
+	/**
+	 *	Append a row whose values were collected before, e.g. a row which was held back
+	 */
+	void record(int handle, const std::vector<double>& values);
+
+	/**
+	 *	Write all recorded rows and wait until they are written
+	 */
+	void flush();
+
+	/**
+	 *	@return number of rows recorded so far
+	 */
+	long long getRecordedRows() const;
+
+private:
+	struct Series
+	{
+		std::string name;
+		std::vector<std::string> columns;
+		// rows recorded since the last batch, one value per column and row
+		std::vector<double> pending;
+		// rows of the batch which is being written, only used by the thread
+		std::vector<double> writing;
+		std::ofstream file;
+	};
+
+	// append a row to a series
+	template <typename Values>
+	void recordRow(int handle, const Values& values);
+
+	// writes the recorded rows in batches until the sink is stopped
+	void run();
+
+	// open the file of a series and write its header if the file is new
+	void openFile(Series& series);
+
+	// write the rows of a batch
+	void writeRows(Series& series);
+
+	std::string folderName;
+	MetricsFormat format;
+	std::chrono::milliseconds flushInterval;
+
+	// the series in the order they were recorded first, the pointers stay valid when series are added
+	std::vector<std::unique_ptr<Series>> series;
+	long long recordedRows = 0;
+	size_t pendingValues = 0;
+
+	bool stopping = false;
+	// incremented for each requested batch and each written batch, so that flush can wait for its batch
+	unsigned long long requestedBatches = 0;
+	unsigned long long writtenBatches = 0;
+
+	mutable std::mutex mutex;
+	// notified when a batch is requested or the sink is stopped
+	std::condition_variable batchRequested;
+	// notified when a batch was written
+	std::condition_variable batchWritten;
+	std::thread thread;
+};
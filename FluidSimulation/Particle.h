@@ -1,12 +1,26 @@
 ﻿#pragma once
 #include <glm/glm.hpp>
+#include "Dimension.h"
 
-struct Particle
+template <int Dim, typename Real = float>
+struct BasicParticle
 {
-	glm::vec2 position;
+	typename Dimension<Dim, Real>::vec position;
 	glm::vec3 color;
 	bool boundary;
-	glm::vec2 velocity = glm::vec2(0.f, 0.f);
-	float density = 0;
-	float pressure = 0;
+	typename Dimension<Dim, Real>::vec velocity = typename Dimension<Dim, Real>::vec(Real(0));
+	Real density = 0;
+	Real pressure = 0;
+	bool sleeping = false;
+	int calmSteps = 0;
+	int timeLevel = 0;
+	// time level chosen at the last update, the particle switches to it when it is synchronized with that level
+	int nextTimeLevel = 0;
+	Real mass = 0;
+	// spacing of the particle, also its smoothing length
+	Real size = 0;
+	// number of the particle which doesn't change when the particles are reordered, new for merged and split particles
+	unsigned int id = 0;
 };
+
+using Particle = BasicParticle<2>;
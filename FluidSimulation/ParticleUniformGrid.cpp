@@ -1,28 +1,39 @@
 ﻿#include "ParticleUniformGrid.h"
 #include <vector>
 
-ParticleUniformGrid::ParticleUniformGrid(float kernelSupport, int width, int height)
+template <int Dim, typename Real>
+BasicParticleUniformGrid<Dim, Real>::BasicParticleUniformGrid(Real kernelSupport, ivec size)
 {
 	this->kernelSupport = kernelSupport;
-	this->width = width;
-	this->height = height;
-	cols = int(ceil(float(width) / kernelSupport)) + 1;
-	rows = int(ceil(float(height) / kernelSupport)) + 1;
-	this->cellSize = cols * rows + 1;
+	this->size = size;
+	this->cellSize = 1;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		cells[axis] = int(ceil(Real(size[axis]) / kernelSupport)) + 1;
+		this->cellSize *= cells[axis];
+	}
+	this->cellSize += 1;
 	counter.resize(cellSize);
 }
 
-void ParticleUniformGrid::initializeGrid(const std::vector<Particle>& particles)
+template <int Dim, typename Real>
+void BasicParticleUniformGrid<Dim, Real>::initializeGrid(const std::vector<BasicParticle<Dim, Real>>& particles, bool includeBoundary)
 {
 	for (unsigned int i = 0; i < cellSize; ++i)
 	{
 		counter.at(i) = 0;
 	}
 	
+	unsigned int amountParticles = 0;
 	for (auto& particle : particles)
 	{
+		if (!includeBoundary && particle.boundary)
+		{
+			continue;
+		}
 		const unsigned int cellIndex = getCellIndex(particle);
 		counter.at(cellIndex) += 1;
+		++amountParticles;
 	}
 
 	for (unsigned int i = 1; i < counter.size(); ++i)
@@ -30,33 +41,98 @@ void ParticleUniformGrid::initializeGrid(const std::vector<Particle>& particles)
 		counter.at(i) += counter.at(i - 1);
 	}
 
-	sortedList.resize(particles.size());
+	sortedList.resize(amountParticles);
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
+		if (!includeBoundary && particles[i].boundary)
+		{
+			continue;
+		}
 		const unsigned int cellIndex = getCellIndex(particles[i]);
 		sortedList.at(--counter.at(cellIndex)) = i;
 	}
 }
 
-unsigned int ParticleUniformGrid::getCellIndex(const Particle& particle) const
+template <int Dim, typename Real>
+void BasicParticleUniformGrid<Dim, Real>::initializeGrid(const std::vector<BasicParticle<Dim, Real>>& particles, const std::vector<unsigned int>& indices)
+{
+	for (unsigned int i = 0; i < cellSize; ++i)
+	{
+		counter.at(i) = 0;
+	}
+
+	for (auto& i : indices)
+	{
+		counter.at(getCellIndex(particles[i])) += 1;
+	}
+
+	for (unsigned int i = 1; i < counter.size(); ++i)
+	{
+		counter.at(i) += counter.at(i - 1);
+	}
+
+	sortedList.resize(indices.size());
+	for (auto& i : indices)
+	{
+		sortedList.at(--counter.at(getCellIndex(particles[i]))) = i;
+	}
+}
+
+template <int Dim, typename Real>
+unsigned int BasicParticleUniformGrid<Dim, Real>::getCellIndex(const BasicParticle<Dim, Real>& particle) const
 {
 	return getCellIndex(particle.position);
 }
 
-unsigned ParticleUniformGrid::getCellIndex(const glm::vec2& pos) const
+template <int Dim, typename Real>
+unsigned BasicParticleUniformGrid<Dim, Real>::getCellIndex(const vec& pos) const
 {
-	const unsigned int x = int(pos.x) >= width ? int(static_cast<float>(width) / kernelSupport) : int(pos.x) < 0 ? 0 : int(pos.x / kernelSupport);
-	const unsigned int y = int(pos.y) >= height ? int(static_cast<float>(height) / kernelSupport) : int(pos.y) < 0 ? 0 : int(pos.y / kernelSupport);
-	return x + cols * y;
+	return getCellIndex(getCell(pos));
 }
 
+template <int Dim, typename Real>
+typename Dimension<Dim, Real>::ivec BasicParticleUniformGrid<Dim, Real>::getCell(const vec& pos) const
+{
+	ivec cell;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		cell[axis] = int(pos[axis]) >= size[axis] ? int(static_cast<Real>(size[axis]) / kernelSupport) : int(pos[axis]) < 0 ? 0 : int(pos[axis] / kernelSupport);
+	}
+	return cell;
+}
 
-const std::vector<unsigned int>& ParticleUniformGrid::getCounter() const
+template <int Dim, typename Real>
+unsigned int BasicParticleUniformGrid<Dim, Real>::getCellIndex(const ivec& cell) const
+{
+	// the first axis changes fastest
+	unsigned int index = cell[Dim - 1];
+	for (int axis = Dim - 2; axis >= 0; --axis)
+	{
+		index = index * cells[axis] + cell[axis];
+	}
+	return index;
+}
+
+
+template <int Dim, typename Real>
+Real BasicParticleUniformGrid<Dim, Real>::getCellWidth() const
+{
+	return kernelSupport;
+}
+
+template <int Dim, typename Real>
+const std::vector<unsigned int>& BasicParticleUniformGrid<Dim, Real>::getCounter() const
 {
 	return counter;
 }
 
-const std::vector<unsigned int>& ParticleUniformGrid::getSortedList() const
+template <int Dim, typename Real>
+const std::vector<unsigned int>& BasicParticleUniformGrid<Dim, Real>::getSortedList() const
 {
 	return sortedList;
 }
+
+template class BasicParticleUniformGrid<2, float>;
+template class BasicParticleUniformGrid<2, double>;
+template class BasicParticleUniformGrid<3, float>;
+template class BasicParticleUniformGrid<3, double>;
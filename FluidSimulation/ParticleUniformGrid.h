@@ -2,22 +2,38 @@
 #include <vector>
 #include "Particle.h"
 
-class ParticleUniformGrid
+template <int Dim, typename Real = float>
+class BasicParticleUniformGrid
 {
 public:
+	using vec = typename Dimension<Dim, Real>::vec;
+	using ivec = typename Dimension<Dim, Real>::ivec;
+
 	/**
 	 *	initialize the member variables
 	 *	@param kernelSupport the kernel support of the simulation, determines the size of a grid cell
-	 *	@param width the width of the simulation space
-	 *	@param height the height of the simulation space
+	 *	@param size the size of the simulation space along each axis
 	 */
-	ParticleUniformGrid(float kernelSupport, int width, int height);
+	BasicParticleUniformGrid(Real kernelSupport, ivec size);
 
 	/**
 	 *	set the counter and sortedList so it can work properly for the given particles
 	 *	@param particles the particles whose indices are saved in the sorted list
+	 *	@param includeBoundary false if boundary particles are left out, e.g. because a boundary density map replaces them
+	 */
+	void initializeGrid(const std::vector<BasicParticle<Dim, Real>>& particles, bool includeBoundary = true);
+
+	/**
+	 *	set the counter and sortedList so it can work properly for some of the given particles
+	 *	@param particles the particles which are referenced by the indices
+	 *	@param indices the indices of the particles which are saved in the sorted list
 	 */
-	void initializeGrid(const std::vector<Particle>& particles);
+	void initializeGrid(const std::vector<BasicParticle<Dim, Real>>& particles, const std::vector<unsigned int>& indices);
+
+	/**
+	 *	@return the size of a grid cell along each axis
+	 */
+	Real getCellWidth() const;
 	
 	/**
 	 *	@return counter member variable which contains indexes for the sorted list
@@ -34,22 +50,40 @@ public:
 	 *	@param particle the particle for which we want to get the index of the cell where it is located
 	 *	@return the index of the cell where the particle is located
 	 */
-	unsigned int getCellIndex(const Particle& particle) const;
+	unsigned int getCellIndex(const BasicParticle<Dim, Real>& particle) const;
 
 	/**
 	 *	Get the index of the cell where the particle is located
 	 *	@param pos the position of the particle for which we want to get the index of the cell where it is located
 	 *	@return the index of the cell where the particle is located
 	 */
-	unsigned int getCellIndex(const glm::vec2& pos) const;
+	unsigned int getCellIndex(const vec& pos) const;
+
+	/**
+	 *	Get the coordinates of the cell where the position is located, positions outside of the grid use the nearest cell
+	 *	@param pos the position for which we want to get the cell
+	 *	@return the column and row (and layer in 3D) of the cell
+	 */
+	ivec getCell(const vec& pos) const;
+
+	/**
+	 *	Get the index of the cell with the given coordinates
+	 *	@param cell the column and row (and layer in 3D) of the cell
+	 *	@return the index of the cell in the counter
+	 */
+	unsigned int getCellIndex(const ivec& cell) const;
 
 private:
 	std::vector<unsigned int> counter;
 	std::vector<unsigned int> sortedList;
-	float kernelSupport;
-	int rows;
-	int cols;
-	int width;
-	int height;
+	Real kernelSupport;
+
+	// number of cells along each axis
+	ivec cells;
+
+	// size of the simulation space along each axis
+	ivec size;
 	unsigned int cellSize;
 };
+
+using ParticleUniformGrid = BasicParticleUniformGrid<2>;
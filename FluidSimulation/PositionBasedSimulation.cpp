@@ -0,0 +1,157 @@
+#include "PositionBasedSimulation.h"
+#include "Profiler.h"
+#include "LatencyHistogram.h"
+
+template <int Dim, typename Real, typename Accumulator>
+BasicPositionBasedSimulation<Dim, Real, Accumulator>::BasicPositionBasedSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io, int iterations)
+	: BasicSimulation<Dim, Real, Accumulator>(size, particleSize, fluidDensity, viscosity, gravity, io)
+{
+	this->iterations = iterations;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicPositionBasedSimulation<Dim, Real, Accumulator>::advance(Real timeDifference)
+{
+	// apply gravity and predict the new positions
+	std::vector<vec> oldPosition;
+	oldPosition.resize(particles.size());
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		oldPosition[i] = particles[i].position;
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		particles[i].velocity += timeDifference * gravity * gravityDirection;
+		particles[i].position += timeDifference * particles[i].velocity;
+	}
+
+	// Do neighbor search once, all iterations share the same neighbors and boundary samples
+	std::vector<std::vector<unsigned int>> neighbors = createNeighborVector();
+	sampleBoundaries();
+
+	// a fixed number of iterations keeps the cost of each step constant
+	{
+		PROFILE_SCOPE("pressure solve");
+		static LatencyHistogram& pressureLatency = LatencyHistogram::get("pressure solve");
+		LatencyTimer pressureTimer(pressureLatency);
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			PROFILE_SCOPE("pressure iteration");
+			solveDensityConstraints(neighbors);
+		}
+	}
+	io->print_iterations(steps, iterations);
+
+	// derive the velocities from the corrected positions
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		particles[i].velocity = (particles[i].position - oldPosition[i]) / timeDifference;
+	}
+
+	// apply viscosity with the densities of the corrected positions
+	computeDensitiesExplicit(neighbors);
+	if (viscosityMethod == ViscosityComputationMethod::implicitIntegration)
+	{
+		solveViscosityImplicit(neighbors, timeDifference);
+	}
+	else
+	{
+		std::vector<vec> accV = computeViscosityAccelerations(neighbors);
+		updateVelocity(accV, timeDifference);
+	}
+
+	updateSleepingParticles(neighbors);
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicPositionBasedSimulation<Dim, Real, Accumulator>::solveDensityConstraints(const std::vector<std::vector<unsigned>>& neighborVector)
+{
+	// compute the constraint C_i = density_i / fluidDensity - 1 and its scaling factor lambda_i
+	std::vector<Real> lambda;
+	lambda.resize(particles.size());
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		lambda[i] = 0;
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		const BoundarySample boundary = getBoundarySample(i);
+		Accumulator density = 0;
+		vec sum_gradient = boundary.densityGradient / fluidDensity;
+		Accumulator sum_gradient_squared = 0;
+		for (auto& j : neighborVector[i])
+		{
+			density += kernelFunction(particles[i].position, particles[j].position);
+			vec gradient = particleMass / fluidDensity * kernelGradient(particles[i].position, particles[j].position);
+			sum_gradient += gradient;
+			if (isActive(j))
+			{
+				sum_gradient_squared += glm::dot(gradient, gradient);
+			}
+		}
+		density = density * particleMass + boundary.density;
+		particles[i].density = Real(density);
+
+		// only compression is corrected, otherwise particles at the surface would clump together
+		const Accumulator constraint = glm::max(density / fluidDensity - 1, Accumulator(0));
+		const Accumulator denominator = (1 + relaxation) * (glm::dot(sum_gradient, sum_gradient) + sum_gradient_squared);
+		if (denominator > 0)
+		{
+			lambda[i] = Real(-constraint / denominator);
+		}
+	}
+
+	// compute the position corrections of all particles before applying them (Jacobi iteration)
+	std::vector<vec> correction;
+	correction.resize(particles.size());
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		correction[i] = vec(Real(0));
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		// the boundary density map and the boundary shapes mirror the lambda of the fluid particle as well
+		correction[i] = 2 * lambda[i] * getBoundarySample(i).densityGradient / particleMass;
+		for (auto& j : neighborVector[i])
+		{
+			// boundary and sleeping particles mirror the lambda of the fluid particle
+			const Real lambda_j = !isActive(j) ? lambda[i] : lambda[j];
+			correction[i] += (lambda[i] + lambda_j) * kernelGradient(particles[i].position, particles[j].position);
+		}
+		correction[i] *= particleMass / fluidDensity;
+	}
+
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		particles[i].position += correction[i];
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicPositionBasedSimulation<Dim, Real, Accumulator>::getIterations() const
+{
+	return iterations;
+}
+
+template class BasicPositionBasedSimulation<2, float, float>;
+template class BasicPositionBasedSimulation<2, double, double>;
+template class BasicPositionBasedSimulation<2, float, double>;
+template class BasicPositionBasedSimulation<3, float, float>;
+template class BasicPositionBasedSimulation<3, double, double>;
+template class BasicPositionBasedSimulation<3, float, double>;
@@ -0,0 +1,55 @@
+#pragma once
+#include "IO.h"
+#include "Simulation.h"
+template <int Dim, typename Real = float, typename Accumulator = Real>
+class BasicPositionBasedSimulation :
+    public BasicSimulation<Dim, Real, Accumulator>
+{
+public:
+    using typename BasicSimulation<Dim, Real, Accumulator>::vec;
+    using typename BasicSimulation<Dim, Real, Accumulator>::ivec;
+    using typename BasicSimulation<Dim, Real, Accumulator>::BoundarySample;
+    using BasicSimulation<Dim, Real, Accumulator>::kernelFunction;
+    using BasicSimulation<Dim, Real, Accumulator>::kernelGradient;
+
+    BasicPositionBasedSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io, int iterations);
+
+    int getIterations() const;
+private:
+    using BasicSimulation<Dim, Real, Accumulator>::particles;
+    using BasicSimulation<Dim, Real, Accumulator>::fluidDensity;
+    using BasicSimulation<Dim, Real, Accumulator>::particleMass;
+    using BasicSimulation<Dim, Real, Accumulator>::gravity;
+    using BasicSimulation<Dim, Real, Accumulator>::gravityDirection;
+    using BasicSimulation<Dim, Real, Accumulator>::viscosityMethod;
+    using BasicSimulation<Dim, Real, Accumulator>::io;
+    using BasicSimulation<Dim, Real, Accumulator>::steps;
+    using BasicSimulation<Dim, Real, Accumulator>::isActive;
+    using BasicSimulation<Dim, Real, Accumulator>::isUpdatedThisStep;
+    using BasicSimulation<Dim, Real, Accumulator>::getBoundarySample;
+    using BasicSimulation<Dim, Real, Accumulator>::sampleBoundaries;
+    using BasicSimulation<Dim, Real, Accumulator>::createNeighborVector;
+    using BasicSimulation<Dim, Real, Accumulator>::computeDensitiesExplicit;
+    using BasicSimulation<Dim, Real, Accumulator>::computeViscosityAccelerations;
+    using BasicSimulation<Dim, Real, Accumulator>::solveViscosityImplicit;
+    using BasicSimulation<Dim, Real, Accumulator>::updateVelocity;
+    using BasicSimulation<Dim, Real, Accumulator>::updateSleepingParticles;
+
+    /**
+     *	Predict the positions and project them onto the density constraints
+     *	with a fixed number of Jacobi iterations (Position Based Fluids)
+     *	@param timeDifference size of the time step
+     */
+    void advance(Real timeDifference) override;
+
+    // project the predicted positions onto the density constraints
+    void solveDensityConstraints(const std::vector<std::vector<unsigned>>& neighborVector);
+
+    // number of Jacobi iterations per step
+    int iterations;
+
+    // relaxation of the constraint denominator, stabilizes particles with an almost empty neighborhood
+    const Real relaxation = Real(0.01);
+};
+
+using PositionBasedSimulation = BasicPositionBasedSimulation<2>;
@@ -0,0 +1,133 @@
+#include "PredictiveCorrectiveSimulation.h"
+#include "Profiler.h"
+#include <chrono>
+
+template <int Dim, typename Real, typename Accumulator>
+BasicPredictiveCorrectiveSimulation<Dim, Real, Accumulator>::BasicPredictiveCorrectiveSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io,
+                                                                              Real max_error, int min_iterations, int max_iterations)
+	: BasicSimulation<Dim, Real, Accumulator>(size, particleSize, fluidDensity, viscosity, gravity, io)
+{
+	this->max_error = max_error;
+	this->min_iterations = min_iterations;
+	this->max_iterations = glm::max(min_iterations, max_iterations);
+
+	// The scaling factor is precomputed once for a prototype particle whose neighborhood is completely filled
+	// with particles on a regular grid with spacing particleSize
+	prototypeGradientSum = vec(Real(0));
+	prototypeGradientDotSum = Real(0);
+	const int cells = int(ceil(kernelSupport / particleSize));
+	forEachCell<Dim>(ivec(-cells), ivec(cells), [&](const ivec& cell)
+	{
+		vec xj = vec(cell) * particleSize;
+		if (glm::length(xj) >= kernelSupport)
+		{
+			return;
+		}
+		vec nabla_w_ij = kernelGradient(vec(Real(0)), xj);
+		prototypeGradientSum += nabla_w_ij;
+		prototypeGradientDotSum += glm::dot(nabla_w_ij, nabla_w_ij);
+	});
+}
+
+template <int Dim, typename Real, typename Accumulator>
+Real BasicPredictiveCorrectiveSimulation<Dim, Real, Accumulator>::computeScalingFactor(Real timeDifference) const
+{
+	Real beta = 2 * (timeDifference * particleMass / fluidDensity) * (timeDifference * particleMass / fluidDensity);
+	return Real(1) / (beta * (glm::dot(prototypeGradientSum, prototypeGradientSum) + prototypeGradientDotSum));
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicPredictiveCorrectiveSimulation<Dim, Real, Accumulator>::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
+{
+	PROFILE_SCOPE("pressure solve");
+	// The velocities already contain the non-pressure accelerations, so only the pressure has to be predicted and corrected
+	const Real delta = computeScalingFactor(timeDifference);
+
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		// sleeping particles keep their pressure
+		if (isUpdatedThisStep(i))
+		{
+			particles[i].pressure = 0;
+		}
+	}
+
+	std::vector<vec> predictedPosition;
+	predictedPosition.resize(particles.size());
+
+	const auto start = std::chrono::steady_clock::now();
+	Accumulator error;
+	int iterations = 0;
+	do
+	{
+		PROFILE_SCOPE("pressure iteration");
+		error = 0;
+		int amountParticles = 0;
+
+		// predict velocity and position with the current pressure estimate
+		std::vector<vec> acc = computePressureAccelerations(neighborVector);
+		#pragma loop(hint_parallel(0))
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			if (!isUpdatedThisStep(i))
+			{
+				predictedPosition[i] = particles[i].position;
+				continue;
+			}
+			predictedPosition[i] = particles[i].position + timeDifference * (particles[i].velocity + timeDifference * acc[i]);
+		}
+
+		// predict density and correct pressure with the predicted density error
+		#pragma loop(hint_parallel(0))
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			if (!isUpdatedThisStep(i))
+			{
+				continue;
+			}
+			Accumulator predictedDensity = 0;
+			for (auto& j : neighborVector[i])
+			{
+				predictedDensity += kernelFunction(predictedPosition[i], predictedPosition[j]);
+			}
+			predictedDensity *= particleMass;
+			predictedDensity += getBoundarySample(i, predictedPosition[i]).density;
+
+			const Accumulator densityError = predictedDensity - fluidDensity;
+			particles[i].pressure += Real(delta * densityError);
+			if (particles[i].pressure < 0)
+			{
+				particles[i].pressure = 0;
+			}
+			error += glm::max(densityError, Accumulator(0)) / fluidDensity;
+			++amountParticles;
+		}
+		error /= static_cast<Accumulator>(glm::max(amountParticles, 1));
+		++iterations;
+	} while ((error >= max_error || iterations < min_iterations) && iterations < max_iterations);
+	const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - start;
+
+	lastSolverIterations = iterations;
+	io->print_iterations(steps, iterations);
+	io->print_iteration_time(steps, duration.count() / static_cast<float>(iterations));
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicPredictiveCorrectiveSimulation<Dim, Real, Accumulator>::getMinIterations() const
+{
+	return min_iterations;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicPredictiveCorrectiveSimulation<Dim, Real, Accumulator>::getMaxIterations() const
+{
+	return max_iterations;
+}
+
+template class BasicPredictiveCorrectiveSimulation<2, float, float>;
+template class BasicPredictiveCorrectiveSimulation<2, double, double>;
+template class BasicPredictiveCorrectiveSimulation<2, float, double>;
+template class BasicPredictiveCorrectiveSimulation<3, float, float>;
+template class BasicPredictiveCorrectiveSimulation<3, double, double>;
+template class BasicPredictiveCorrectiveSimulation<3, float, double>;
@@ -0,0 +1,53 @@
+#pragma once
+#include "IO.h"
+#include "Simulation.h"
+template <int Dim, typename Real = float, typename Accumulator = Real>
+class BasicPredictiveCorrectiveSimulation :
+    public BasicSimulation<Dim, Real, Accumulator>
+{
+public:
+    using typename BasicSimulation<Dim, Real, Accumulator>::vec;
+    using typename BasicSimulation<Dim, Real, Accumulator>::ivec;
+    using BasicSimulation<Dim, Real, Accumulator>::kernelFunction;
+    using BasicSimulation<Dim, Real, Accumulator>::kernelGradient;
+
+    BasicPredictiveCorrectiveSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io,
+                                        Real max_error, int min_iterations, int max_iterations);
+    int getMinIterations() const;
+    int getMaxIterations() const;
+private:
+    using BasicSimulation<Dim, Real, Accumulator>::particles;
+    using BasicSimulation<Dim, Real, Accumulator>::particleSize;
+    using BasicSimulation<Dim, Real, Accumulator>::kernelSupport;
+    using BasicSimulation<Dim, Real, Accumulator>::fluidDensity;
+    using BasicSimulation<Dim, Real, Accumulator>::particleMass;
+    using BasicSimulation<Dim, Real, Accumulator>::io;
+    using BasicSimulation<Dim, Real, Accumulator>::steps;
+    using BasicSimulation<Dim, Real, Accumulator>::lastSolverIterations;
+    using BasicSimulation<Dim, Real, Accumulator>::isUpdatedThisStep;
+    using BasicSimulation<Dim, Real, Accumulator>::getBoundarySample;
+    using BasicSimulation<Dim, Real, Accumulator>::computePressureAccelerations;
+
+    // compute pressures with predict-correct iterations (PCISPH)
+    void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference) override;
+
+    // scaling factor which converts a density error into a pressure correction for the given time step
+    Real computeScalingFactor(Real timeDifference) const;
+
+    // desired density error
+    Real max_error;
+
+    // minimum number of predict-correct iterations per step
+    int min_iterations;
+
+    // maximum number of predict-correct iterations per step, equal to min_iterations for a fixed number of iterations
+    int max_iterations;
+
+    // sum of the kernel gradients of a prototype particle with a filled neighborhood
+    vec prototypeGradientSum;
+
+    // sum of the squared kernel gradients of a prototype particle with a filled neighborhood
+    Real prototypeGradientDotSum;
+};
+
+using PredictiveCorrectiveSimulation = BasicPredictiveCorrectiveSimulation<2>;
@@ -0,0 +1,478 @@
+#include "Profiler.h"
+
+#ifdef FLUID_PROFILING
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+	const char* const counterNames[HardwareCounters::count] = { "cycles", "instructions", "cache misses", "branch misses" };
+
+	struct PhaseStatistics
+	{
+		long long calls = 0;
+		double total = 0;
+		double minimum = std::numeric_limits<double>::max();
+		double maximum = 0;
+		// calls with hardware counters and the sum of their counters
+		long long countedCalls = 0;
+		double counters[HardwareCounters::count] = {};
+
+		void add(double seconds)
+		{
+			++calls;
+			total += seconds;
+			minimum = std::min(minimum, seconds);
+			maximum = std::max(maximum, seconds);
+		}
+
+		void add(const HardwareCounters& start, const HardwareCounters& end)
+		{
+			// if the kernel multiplexed the counters they only counted part of the time, which is extrapolated
+			const unsigned long long running = end.timeRunning - start.timeRunning;
+			if (running == 0)
+			{
+				return;
+			}
+			const double scale = double(end.timeEnabled - start.timeEnabled) / double(running);
+			++countedCalls;
+			for (int counter = 0; counter < HardwareCounters::count; ++counter)
+			{
+				counters[counter] += scale * double(end.values[counter] - start.values[counter]);
+			}
+		}
+
+		void add(const PhaseStatistics& other)
+		{
+			calls += other.calls;
+			total += other.total;
+			minimum = std::min(minimum, other.minimum);
+			maximum = std::max(maximum, other.maximum);
+			countedCalls += other.countedCalls;
+			for (int counter = 0; counter < HardwareCounters::count; ++counter)
+			{
+				counters[counter] += other.counters[counter];
+			}
+		}
+	};
+
+	struct TraceEvent
+	{
+		const char* name;
+		// nanoseconds since the start of the profiler
+		long long start;
+		long long duration;
+	};
+
+	// the phases of one thread, kept after the thread ends
+	struct ThreadRecord
+	{
+		int thread = 0;
+		const char* name = nullptr;
+		std::mutex mutex;
+		// the names are string literals, so their addresses identify the phases within a thread
+		std::unordered_map<const char*, PhaseStatistics> phases;
+		std::vector<TraceEvent> events;
+		// the hardware counters the thread could open
+		bool availableCounters[HardwareCounters::count] = {};
+	};
+
+	struct ProfilerState
+	{
+		const Profiler::Clock::time_point start = Profiler::Clock::now();
+		std::mutex mutex;
+		std::vector<std::shared_ptr<ThreadRecord>> threads;
+		std::atomic<size_t> maxEvents{ 0 };
+		std::atomic<size_t> events{ 0 };
+		std::atomic<size_t> droppedEvents{ 0 };
+		std::atomic<bool> countersEnabled{ false };
+		// the first thread which opens its counters reports which are missing
+		std::once_flag countersReported;
+	};
+
+	ProfilerState& getState()
+	{
+		static ProfilerState state;
+		return state;
+	}
+
+	ThreadRecord& getThreadRecord()
+	{
+		thread_local std::shared_ptr<ThreadRecord> record = []()
+		{
+			ProfilerState& state = getState();
+			std::lock_guard<std::mutex> lock(state.mutex);
+			std::shared_ptr<ThreadRecord> newRecord = std::make_shared<ThreadRecord>();
+			newRecord->thread = static_cast<int>(state.threads.size()) + 1;
+			state.threads.push_back(newRecord);
+			return newRecord;
+		}();
+		return *record;
+	}
+
+	// the hardware counters of the calling thread, which only count while the thread runs
+	class ThreadCounters
+	{
+	public:
+		ThreadCounters()
+		{
+			std::fill(files, files + HardwareCounters::count, -1);
+			std::fill(positions, positions + HardwareCounters::count, -1);
+		}
+
+		~ThreadCounters()
+		{
+#ifdef __linux__
+			for (int file : files)
+			{
+				if (file >= 0)
+				{
+					close(file);
+				}
+			}
+#endif
+		}
+
+		ThreadCounters(const ThreadCounters&) = delete;
+		ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+		bool read(HardwareCounters& counters)
+		{
+			if (!opened)
+			{
+				open();
+			}
+#ifdef __linux__
+			if (leader < 0)
+			{
+				return false;
+			}
+			// the group is read at once: number of counters, time enabled, time running, the value of each counter
+			uint64_t buffer[3 + HardwareCounters::count];
+			const ssize_t size = ::read(leader, buffer, sizeof(buffer));
+			if (size < ssize_t((3 + groupSize) * sizeof(uint64_t)))
+			{
+				return false;
+			}
+			counters.timeEnabled = buffer[1];
+			counters.timeRunning = buffer[2];
+			for (int counter = 0; counter < HardwareCounters::count; ++counter)
+			{
+				counters.values[counter] = positions[counter] >= 0 ? buffer[3 + positions[counter]] : 0;
+			}
+			return true;
+#else
+			(void)counters;
+			return false;
+#endif
+		}
+
+	private:
+		void open()
+		{
+			opened = true;
+			int error = 0;
+#ifdef __linux__
+			const uint64_t configs[HardwareCounters::count] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+			for (int counter = 0; counter < HardwareCounters::count; ++counter)
+			{
+				// the counters form a group, so that they are scheduled together and read with one call
+				perf_event_attr attributes;
+				std::memset(&attributes, 0, sizeof(attributes));
+				attributes.type = PERF_TYPE_HARDWARE;
+				attributes.size = sizeof(attributes);
+				attributes.config = configs[counter];
+				attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				attributes.disabled = leader < 0 ? 1 : 0;
+				// only the program itself, which is allowed without privileges in the default configuration
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+				const int file = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0));
+				if (file < 0)
+				{
+					if (error == 0)
+					{
+						error = errno;
+					}
+					continue;
+				}
+				if (leader < 0)
+				{
+					leader = file;
+				}
+				files[counter] = file;
+				positions[counter] = groupSize++;
+			}
+			if (leader >= 0 && ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) < 0)
+			{
+				error = errno;
+				leader = -1;
+			}
+#endif
+
+			ThreadRecord& record = getThreadRecord();
+			{
+				std::lock_guard<std::mutex> lock(record.mutex);
+				for (int counter = 0; counter < HardwareCounters::count; ++counter)
+				{
+					record.availableCounters[counter] = leader >= 0 && positions[counter] >= 0;
+				}
+			}
+
+			std::call_once(getState().countersReported, [&]()
+			{
+#ifdef __linux__
+				if (leader < 0)
+				{
+					std::cout << "hardware counters are unavailable: " << std::strerror(error);
+					if (error == EACCES || error == EPERM)
+					{
+						std::cout << ", see /proc/sys/kernel/perf_event_paranoid";
+					}
+					std::cout << std::endl;
+					return;
+				}
+				for (int counter = 0; counter < HardwareCounters::count; ++counter)
+				{
+					if (positions[counter] < 0)
+					{
+						std::cout << "the hardware counter for " << counterNames[counter] << " is unavailable" << std::endl;
+					}
+				}
+#else
+				(void)error;
+				std::cout << "hardware counters are only available on Linux" << std::endl;
+#endif
+			});
+		}
+
+		bool opened = false;
+		int files[HardwareCounters::count];
+		// position of each counter in the group, -1 if the counter couldn't be opened
+		int positions[HardwareCounters::count];
+		int groupSize = 0;
+		int leader = -1;
+	};
+
+	// prints a counter ratio, or a dash if a counter is missing
+	void writeRatio(std::ostream& stream, int width, bool available, double numerator, double denominator)
+	{
+		if (available && denominator > 0)
+		{
+			stream << std::setw(width) << numerator / denominator;
+		}
+		else
+		{
+			stream << std::setw(width) << "-";
+		}
+	}
+
+	// write a string as a JSON string
+	void writeJsonString(std::ostream& stream, const char* text)
+	{
+		stream << '"';
+		for (const char* character = text; *character; ++character)
+		{
+			if (*character == '"' || *character == '\\')
+			{
+				stream << '\\';
+			}
+			stream << *character;
+		}
+		stream << '"';
+	}
+}
+
+void Profiler::record(const char* name, Clock::time_point start, Clock::time_point end,
+					  const HardwareCounters* start_counters, const HardwareCounters* end_counters)
+{
+	ProfilerState& state = getState();
+	ThreadRecord& record = getThreadRecord();
+	const long long duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	std::lock_guard<std::mutex> lock(record.mutex);
+	PhaseStatistics& phase = record.phases[name];
+	phase.add(1E-9 * double(duration));
+	if (start_counters && end_counters)
+	{
+		phase.add(*start_counters, *end_counters);
+	}
+	if (state.maxEvents.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+	if (state.events.fetch_add(1, std::memory_order_relaxed) >= state.maxEvents.load(std::memory_order_relaxed))
+	{
+		state.droppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	record.events.push_back({ name, std::chrono::duration_cast<std::chrono::nanoseconds>(start - state.start).count(), duration });
+}
+
+void Profiler::nameThread(const char* name)
+{
+	ThreadRecord& record = getThreadRecord();
+	std::lock_guard<std::mutex> lock(record.mutex);
+	record.name = name;
+}
+
+void Profiler::enableTrace(size_t max_events)
+{
+	getState().maxEvents = max_events;
+}
+
+void Profiler::enableCounters()
+{
+	getState().countersEnabled = true;
+}
+
+bool Profiler::readCounters(HardwareCounters& counters)
+{
+	if (!getState().countersEnabled.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+	thread_local ThreadCounters threadCounters;
+	return threadCounters.read(counters);
+}
+
+void Profiler::printStatistics(std::ostream& stream)
+{
+	// the same phase can have different addresses in different translation units, so the phases are merged by their names
+	std::map<std::string, PhaseStatistics> phases;
+	ProfilerState& state = getState();
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (auto& record : state.threads)
+		{
+			std::lock_guard<std::mutex> recordLock(record->mutex);
+			for (auto& phase : record->phases)
+			{
+				phases[phase.first].add(phase.second);
+			}
+		}
+	}
+
+	std::vector<std::pair<std::string, PhaseStatistics>> ordered(phases.begin(), phases.end());
+	std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.second.total > b.second.total; });
+	stream << std::left << std::setw(28) << "phase" << std::right << std::setw(10) << "calls" << std::setw(14) << "total ms"
+		   << std::setw(12) << "mean us" << std::setw(12) << "min us" << std::setw(12) << "max us" << std::endl;
+	for (auto& phase : ordered)
+	{
+		const PhaseStatistics& statistics = phase.second;
+		stream << std::left << std::setw(28) << phase.first << std::right << std::fixed << std::setprecision(1)
+			   << std::setw(10) << statistics.calls << std::setw(14) << 1E3 * statistics.total
+			   << std::setw(12) << 1E6 * statistics.total / double(statistics.calls)
+			   << std::setw(12) << 1E6 * statistics.minimum << std::setw(12) << 1E6 * statistics.maximum << std::endl;
+	}
+	stream << std::defaultfloat;
+
+	// the counters are shown per thread, e.g. the simulation and the picture encoders run different code on different cores
+	std::lock_guard<std::mutex> lock(state.mutex);
+	for (auto& record : state.threads)
+	{
+		std::lock_guard<std::mutex> recordLock(record->mutex);
+		std::vector<std::pair<const char*, const PhaseStatistics*>> counted;
+		for (auto& phase : record->phases)
+		{
+			if (phase.second.countedCalls > 0)
+			{
+				counted.emplace_back(phase.first, &phase.second);
+			}
+		}
+		if (counted.empty())
+		{
+			continue;
+		}
+		std::sort(counted.begin(), counted.end(), [](const auto& a, const auto& b) { return a.second->total > b.second->total; });
+
+		const bool* available = record->availableCounters;
+		stream << std::endl << "hardware counters of thread " << record->thread;
+		if (record->name)
+		{
+			stream << " (" << record->name << ")";
+		}
+		stream << std::endl;
+		stream << std::left << std::setw(28) << "phase" << std::right << std::setw(10) << "calls" << std::setw(16) << "M instructions"
+			   << std::setw(8) << "IPC" << std::setw(18) << "cache misses/call" << std::setw(12) << "cache MPKI" << std::setw(12) << "branch MPKI" << std::endl;
+		for (auto& phase : counted)
+		{
+			const PhaseStatistics& statistics = *phase.second;
+			const double instructions = statistics.counters[HardwareCounters::instructions];
+			stream << std::left << std::setw(28) << phase.first << std::right << std::fixed << std::setprecision(2)
+				   << std::setw(10) << statistics.countedCalls;
+			// misses per thousand instructions compare phases of different length
+			writeRatio(stream, 16, available[HardwareCounters::instructions], instructions, 1E6);
+			writeRatio(stream, 8, available[HardwareCounters::instructions] && available[HardwareCounters::cycles], instructions, statistics.counters[HardwareCounters::cycles]);
+			writeRatio(stream, 18, available[HardwareCounters::cacheMisses], statistics.counters[HardwareCounters::cacheMisses], double(statistics.countedCalls));
+			writeRatio(stream, 12, available[HardwareCounters::cacheMisses] && available[HardwareCounters::instructions], 1E3 * statistics.counters[HardwareCounters::cacheMisses], instructions);
+			writeRatio(stream, 12, available[HardwareCounters::branchMisses] && available[HardwareCounters::instructions], 1E3 * statistics.counters[HardwareCounters::branchMisses], instructions);
+			stream << std::endl;
+		}
+		stream << std::defaultfloat;
+	}
+
+	if (state.droppedEvents > 0)
+	{
+		stream << state.droppedEvents << " phases are missing in the trace, it was full" << std::endl;
+	}
+}
+
+bool Profiler::writeTrace(const std::string& file_name)
+{
+	std::ofstream file_out(file_name, std::ios_base::out | std::ios_base::trunc);
+	if (!file_out.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+		return false;
+	}
+
+	ProfilerState& state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	file_out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	file_out << std::fixed << std::setprecision(3);
+	for (auto& record : state.threads)
+	{
+		std::lock_guard<std::mutex> recordLock(record->mutex);
+		if (record->name)
+		{
+			file_out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << record->thread << ",\"args\":{\"name\":";
+			writeJsonString(file_out, record->name);
+			file_out << "}}";
+			first = false;
+		}
+		// complete events with microseconds, nested phases are shown below their parents
+		for (auto& event : record->events)
+		{
+			file_out << (first ? "" : ",") << "\n{\"name\":";
+			writeJsonString(file_out, event.name);
+			file_out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << record->thread << ",\"ts\":" << 1E-3 * double(event.start)
+					 << ",\"dur\":" << 1E-3 * double(event.duration) << "}";
+			first = false;
+		}
+	}
+	file_out << "\n]}\n";
+	return file_out.good();
+}
+
+#endif
@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ *	Scoped timers for the phases of a simulation step and of the main loop. The profiler only exists if FLUID_PROFILING
+ *	is defined, e.g. in the preprocessor definitions of the project. Without it PROFILE_SCOPE and PROFILE_THREAD expand
+ *	to nothing, so the timers cost nothing in normal builds.
+ *	Each thread collects the statistics of its phases separately, a timer only locks the uncontended data of its own thread.
+ *	Nested phases are timed inclusively, e.g. the pressure iterations are part of the pressure solve.
+ *	Optionally each phase also counts cycles, instructions, cache misses and branch misses of its thread with the hardware
+ *	counters of the processor. They are read with perf_event_open and therefore only exist on Linux.
+ */
+#ifdef FLUID_PROFILING
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <cstddef>
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+
+// time the rest of the enclosing scope as a phase, the name has to be a string literal
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+
+// name the calling thread in the trace, the name has to be a string literal
+#define PROFILE_THREAD(name) Profiler::nameThread(name)
+
+/**
+ *	Values of the hardware counters of a thread, counters which aren't available stay 0
+ */
+struct HardwareCounters
+{
+	enum Counter { cycles, instructions, cacheMisses, branchMisses, count };
+
+	unsigned long long values[count] = {};
+	// time the counters were enabled and actually counting, they differ if the kernel multiplexes the counters
+	unsigned long long timeEnabled = 0;
+	unsigned long long timeRunning = 0;
+};
+
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 *	Add a timed phase to the statistics of the calling thread and to the trace
+	 *	@param name name of the phase, a string literal
+	 *	@param start_counters, end_counters hardware counters at the start and the end of the phase, nullptr if they weren't read
+	 */
+	static void record(const char* name, Clock::time_point start, Clock::time_point end,
+					   const HardwareCounters* start_counters = nullptr, const HardwareCounters* end_counters = nullptr);
+
+	/**
+	 *	Name the calling thread in the trace
+	 *	@param name name of the thread, a string literal
+	 */
+	static void nameThread(const char* name);
+
+	/**
+	 *	Keep each timed phase for the trace, up to a number of phases. The trace is disabled at the start.
+	 *	@param max_events largest number of phases in the trace, 0 to disable the trace
+	 */
+	static void enableTrace(size_t max_events);
+
+	/**
+	 *	Read the hardware counters in each phase from now on. The counters of a thread are opened by its first phase,
+	 *	if they can't be opened the reason is printed once and the phases of the thread are only timed.
+	 */
+	static void enableCounters();
+
+	/**
+	 *	Read the hardware counters of the calling thread
+	 *	@return false if the counters are disabled or not available
+	 */
+	static bool readCounters(HardwareCounters& counters);
+
+	/**
+	 *	Print the number of calls and the total, mean, minimum and maximum time of each phase over all threads,
+	 *	ordered by the total time, and the hardware counters of each phase per thread
+	 */
+	static void printStatistics(std::ostream& stream);
+
+	/**
+	 *	Write the trace as Chrome trace JSON, which can be opened with chrome://tracing or the Perfetto UI
+	 *	@return true if the file was written
+	 */
+	static bool writeTrace(const std::string& file_name);
+};
+
+/**
+ *	Times its own lifetime as a phase
+ */
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : name(name), start(Profiler::Clock::now())
+	{
+		counting = Profiler::readCounters(startCounters);
+	}
+
+	~ProfileScope()
+	{
+		HardwareCounters endCounters;
+		if (counting && Profiler::readCounters(endCounters))
+		{
+			Profiler::record(name, start, Profiler::Clock::now(), &startCounters, &endCounters);
+		}
+		else
+		{
+			Profiler::record(name, start, Profiler::Clock::now());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	Profiler::Clock::time_point start;
+	bool counting;
+	HardwareCounters startCounters;
+};
+
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD(name)
+#endif
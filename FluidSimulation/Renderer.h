@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include "Particle.h"
+
+/**
+ *	Draws the particles of the simulation and provides the pictures for the frame writer,
+ *	either in a window or without a display
+ */
+class Renderer
+{
+public:
+	virtual ~Renderer() = default;
+
+	/**
+	 *	poll events and return true iff the simulation should go on
+	 *	@return true if the simulation should go on, false if it should end
+	 */
+	virtual bool update() = 0;
+
+	/**
+	 *	draw all particles whose positions are given
+	 *	@param particles particles which are drawn
+	 */
+	virtual void draw(const std::vector<Particle>& particles) = 0;
+
+	/**
+	 *	set the solid boundary which is drawn below the particles, e.g. boundary shapes which have no particles
+	 *	@param coverage the covered fraction of each pixel of the simulated domain, width * height values, the lowest row first
+	 *	@param width the width of the simulated domain in pixels
+	 *	@param height the height of the simulated domain in pixels
+	 */
+	virtual void set_boundary(const std::vector<float>& coverage, int width, int height) = 0;
+
+	/**
+	 *	read the pixels of the lower left part of the last drawn picture into a buffer
+	 *	@param buffer buffer for width * height * 3 bytes, the pixels are stored as BGR without padding, the lowest row first
+	 *	@param width the width of the read part
+	 *	@param height the height of the read part
+	 */
+	virtual void get_picture_data(char* buffer, int width, int height) const = 0;
+
+	/**
+	 *	return true iff the user asked to skip rendering for a while since the last call
+	 *	@return true if the simulation should skip rendering for a while
+	 */
+	virtual bool fast_forward_requested() = 0;
+};
@@ -0,0 +1,349 @@
+#include "RunConfiguration.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <functional>
+#include <cstdlib>
+#include <cmath>
+
+namespace
+{
+	// a parameter which is read from and written as text
+	struct Parameter
+	{
+		const char* name;
+		std::function<bool(RunParameters&, const std::string&)> set;
+		std::function<std::string(const RunParameters&)> get;
+	};
+
+	bool parseReal(const std::string& text, float& value)
+	{
+		char* end = nullptr;
+		const float parsed = std::strtof(text.c_str(), &end);
+		if (text.empty() || *end != '\0' || !std::isfinite(parsed))
+		{
+			return false;
+		}
+		value = parsed;
+		return true;
+	}
+
+	Parameter integerParameter(const char* name, int RunParameters::* member)
+	{
+		return { name,
+			[member](RunParameters& parameters, const std::string& value) { return parseInteger(value, parameters.*member); },
+			[member](const RunParameters& parameters) { return std::to_string(parameters.*member); } };
+	}
+
+	Parameter realParameter(const char* name, float RunParameters::* member)
+	{
+		return { name,
+			[member](RunParameters& parameters, const std::string& value) { return parseReal(value, parameters.*member); },
+			[member](const RunParameters& parameters)
+			{
+				// the fewest digits which are read as the same float again
+				std::ostringstream text;
+				for (int digits = 6; digits <= 9; ++digits)
+				{
+					text.str("");
+					text << std::setprecision(digits) << parameters.*member;
+					if (std::strtof(text.str().c_str(), nullptr) == parameters.*member)
+					{
+						break;
+					}
+				}
+				return text.str();
+			} };
+	}
+
+	Parameter booleanParameter(const char* name, bool RunParameters::* member)
+	{
+		return { name,
+			[member](RunParameters& parameters, const std::string& value)
+			{
+				if (value == "1" || value == "true" || value == "yes")
+				{
+					parameters.*member = true;
+					return true;
+				}
+				if (value == "0" || value == "false" || value == "no")
+				{
+					parameters.*member = false;
+					return true;
+				}
+				return false;
+			},
+			[member](const RunParameters& parameters) { return std::string(parameters.*member ? "true" : "false"); } };
+	}
+
+	// the names are in the order of the enumeration, which is also the order of the prompts
+	template <typename Enum>
+	Parameter choiceParameter(const char* name, Enum RunParameters::* member, std::vector<const char*> names)
+	{
+		return { name,
+			[member, names](RunParameters& parameters, const std::string& value)
+			{
+				for (size_t choice = 0; choice < names.size(); ++choice)
+				{
+					if (value == names[choice])
+					{
+						parameters.*member = static_cast<Enum>(choice);
+						return true;
+					}
+				}
+				int number;
+				if (parseInteger(value, number) && number >= 0 && number < static_cast<int>(names.size()))
+				{
+					parameters.*member = static_cast<Enum>(number);
+					return true;
+				}
+				return false;
+			},
+			[member, names](const RunParameters& parameters) { return std::string(names[static_cast<size_t>(parameters.*member)]); } };
+	}
+
+	const std::vector<Parameter>& getParameters()
+	{
+		static const std::vector<Parameter> parameters = {
+			choiceParameter("scenario", &RunParameters::scenario,
+				{ "breaking_dam", "leaky_dam", "dropping_fluid", "flowing_fluid", "resting_fluid", "periodic_channel" }),
+			integerParameter("dimensions", &RunParameters::dimensions),
+			integerParameter("width", &RunParameters::width),
+			integerParameter("height", &RunParameters::height),
+			integerParameter("depth", &RunParameters::depth),
+			integerParameter("fluid_depth", &RunParameters::fluid_depth),
+			realParameter("particle_size", &RunParameters::particle_size),
+			choiceParameter("method", &RunParameters::method, { "incompressible", "compressible", "predictive_corrective", "position_based" }),
+			realParameter("max_error", &RunParameters::max_error),
+			integerParameter("min_iterations", &RunParameters::min_iterations),
+			integerParameter("max_iterations", &RunParameters::max_iterations),
+			realParameter("stiffness", &RunParameters::stiffness),
+			realParameter("viscosity", &RunParameters::viscosity),
+			choiceParameter("viscosity_method", &RunParameters::viscosity_method, { "explicit", "implicit" }),
+			realParameter("gravity", &RunParameters::gravity),
+			realParameter("time_step", &RunParameters::timeStep),
+			booleanParameter("adaptive_time_step", &RunParameters::adaptive_time_step),
+			realParameter("min_time_step", &RunParameters::min_time_step),
+			realParameter("max_time_step", &RunParameters::max_time_step),
+			integerParameter("substeps", &RunParameters::substeps),
+			realParameter("frame_time", &RunParameters::frame_time),
+			integerParameter("fast_forward_steps", &RunParameters::fast_forward_steps),
+			booleanParameter("sleeping", &RunParameters::sleeping),
+			integerParameter("multirate_levels", &RunParameters::multirate_levels),
+			booleanParameter("adaptive_resolution", &RunParameters::adaptive_resolution),
+			choiceParameter("boundary_method", &RunParameters::boundary_method, { "particles", "density_map", "shapes" }),
+			choiceParameter("frame_policy", &RunParameters::frame_policy, { "block", "drop" }),
+			choiceParameter("frame_format", &RunParameters::frame_format, { "images", "video", "archive", "encoder", "none" }),
+			choiceParameter("frame_encoding", &RunParameters::frame_encoding, { "tga", "rle_tga", "png", "qoi" }),
+			integerParameter("encoder_threads", &RunParameters::encoder_threads),
+			booleanParameter("save_snapshots", &RunParameters::save_snapshots),
+			realParameter("trajectory_position_error", &RunParameters::trajectory_position_error),
+			realParameter("trajectory_velocity_error", &RunParameters::trajectory_velocity_error),
+			integerParameter("trajectory_keyframe_interval", &RunParameters::trajectory_keyframe_interval),
+			choiceParameter("metrics_format", &RunParameters::metrics_format, { "text", "binary" }),
+			integerParameter("checkpoint_interval", &RunParameters::checkpoint_interval),
+		};
+		return parameters;
+	}
+
+	const Parameter* findParameter(const std::string& name)
+	{
+		for (const Parameter& parameter : getParameters())
+		{
+			if (name == parameter.name)
+			{
+				return &parameter;
+			}
+		}
+		return nullptr;
+	}
+
+	std::string trim(const std::string& text)
+	{
+		const size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+		{
+			return "";
+		}
+		return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+	}
+}
+
+bool parseInteger(const std::string& text, int& value)
+{
+	char* end = nullptr;
+	const long parsed = std::strtol(text.c_str(), &end, 10);
+	if (text.empty() || *end != '\0')
+	{
+		return false;
+	}
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+bool isRunParameter(const std::string& name)
+{
+	return findParameter(name) != nullptr;
+}
+
+bool setRunParameter(RunParameters& parameters, const std::string& name, const std::string& value)
+{
+	const Parameter* parameter = findParameter(name);
+	if (!parameter)
+	{
+		std::cout << "unknown parameter " << name << std::endl;
+		return false;
+	}
+	if (!parameter->set(parameters, value))
+	{
+		std::cout << "invalid value " << value << " of " << name << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadRunConfiguration(const std::string& file_name, RunParameters& parameters)
+{
+	std::ifstream file_in(file_name);
+	if (!file_in.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+		return false;
+	}
+
+	// all lines are checked, so that every mistake is reported at once
+	bool valid = true;
+	std::string line;
+	for (int number = 1; std::getline(file_in, line); ++number)
+	{
+		line = trim(line);
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		const size_t separator = line.find('=');
+		if (separator == std::string::npos)
+		{
+			std::cout << file_name << ":" << number << ": expected name = value" << std::endl;
+			valid = false;
+			continue;
+		}
+		if (!setRunParameter(parameters, trim(line.substr(0, separator)), trim(line.substr(separator + 1))))
+		{
+			std::cout << "in " << file_name << ":" << number << std::endl;
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+void writeRunConfiguration(std::ostream& stream, const RunParameters& parameters)
+{
+	for (const Parameter& parameter : getParameters())
+	{
+		stream << parameter.name << " = " << parameter.get(parameters) << std::endl;
+	}
+}
+
+bool validateRunParameters(RunParameters& parameters)
+{
+	bool valid = true;
+	auto require = [&](bool condition, const std::string& message)
+	{
+		if (!condition)
+		{
+			std::cout << message << std::endl;
+			valid = false;
+		}
+	};
+
+	require(parameters.particle_size > 0, "particle_size has to be larger than 0");
+	// the walls are three particles thick
+	require(parameters.width > 6 * parameters.particle_size, "width has to be larger than 6 particle sizes");
+	require(parameters.height > 3 * parameters.particle_size, "height has to be larger than 3 particle sizes");
+	require(parameters.fluid_depth >= 1, "fluid_depth has to be at least 1");
+	require(parameters.max_error > 0, "max_error has to be larger than 0");
+	require(parameters.max_iterations >= 1, "max_iterations has to be at least 1");
+	require(parameters.stiffness >= 0, "stiffness can't be negative");
+	require(parameters.viscosity >= 0, "viscosity can't be negative");
+	require(parameters.timeStep > 0, "time_step has to be larger than 0");
+	require(parameters.substeps >= 1, "substeps has to be at least 1");
+	require(parameters.frame_time == 0 || parameters.frame_time >= parameters.timeStep, "frame_time has to be 0 or at least time_step");
+	require(parameters.fast_forward_steps >= 0, "fast_forward_steps can't be negative");
+	require(parameters.multirate_levels >= 0 && parameters.multirate_levels <= RunParameters::max_multirate_levels,
+		"multirate_levels has to be between 0 and " + std::to_string(RunParameters::max_multirate_levels));
+	require(parameters.encoder_threads >= 0, "encoder_threads can't be negative");
+	require(parameters.trajectory_position_error >= 0, "trajectory_position_error can't be negative");
+	require(parameters.trajectory_velocity_error > 0, "trajectory_velocity_error has to be larger than 0");
+	require(parameters.trajectory_keyframe_interval >= 1, "trajectory_keyframe_interval has to be at least 1");
+	require(parameters.checkpoint_interval >= 0, "checkpoint_interval can't be negative");
+	require(parameters.dimensions == 2 || parameters.dimensions == 3, "dimensions has to be 2 or 3");
+
+	// the fluid starts on the floor, which is three particles thick, particles above the domain crash the neighbor search
+	const float fluidTop = (3 + parameters.fluid_depth) * parameters.particle_size;
+	require(fluidTop <= parameters.height, "the fluid doesn't fit, (3 + fluid_depth) * particle_size can't be larger than height");
+	switch (parameters.scenario)
+	{
+	case SimulationScenario::leakyDam:
+		// the dam is six particles thick and starts up to a particle size right of the middle
+		require(parameters.width / 2 + 10 * parameters.particle_size <= parameters.width, "the dam doesn't fit, width has to be at least 20 particle sizes");
+		break;
+	case SimulationScenario::droppingFluid:
+		// the fluid lies on an obstacle which reaches up to a third of the height
+		require(parameters.height / 3 + parameters.fluid_depth * parameters.particle_size <= parameters.height,
+			"the fluid doesn't fit, height / 3 + fluid_depth * particle_size can't be larger than height");
+		break;
+	case SimulationScenario::flowingFluid:
+		// the fluid lies on a ramp which rises to about width / 4 + particle_size at the left wall
+		require(parameters.width / 4 + fluidTop + parameters.particle_size <= parameters.height,
+			"the fluid doesn't fit, width / 4 + (4 + fluid_depth) * particle_size can't be larger than height");
+		break;
+	default:
+		break;
+	}
+
+	if (parameters.dimensions == 3)
+	{
+		// the renderers, the snapshots, the trajectories and the checkpoints only handle 2D particles
+		require(parameters.depth > 6 * parameters.particle_size, "depth has to be larger than 6 particle sizes");
+		require(parameters.scenario == SimulationScenario::breakingDam || parameters.scenario == SimulationScenario::restingFluid,
+			"3D runs support the scenarios breaking_dam and resting_fluid");
+		require(parameters.frame_format == FrameOutputFormat::none, "3D runs can't save pictures, use frame_format none");
+		require(!parameters.save_snapshots && parameters.trajectory_position_error == 0 && parameters.checkpoint_interval == 0,
+			"3D runs can't save snapshots, trajectories or checkpoints");
+	}
+
+	if (parameters.method == PressureComputationMethod::predictiveCorrective)
+	{
+		require(parameters.min_iterations >= 1 && parameters.min_iterations <= parameters.max_iterations,
+			"min_iterations has to be between 1 and max_iterations");
+	}
+	// the frame time decides the steps per picture
+	require(parameters.frame_time == 0 || parameters.substeps == 1, "substeps can't be combined with frame_time, leave substeps at 1");
+	// the time levels and the merged particles are only handled by the compressible solver
+	require(parameters.method == PressureComputationMethod::compressible || (parameters.multirate_levels == 0 && !parameters.adaptive_resolution),
+		"multirate_levels and adaptive_resolution need the compressible method");
+	// the pressure solvers would read the stale pressures of sleeping particles
+	require(parameters.method == PressureComputationMethod::compressible || !parameters.sleeping, "sleeping needs the compressible method");
+	if (parameters.adaptive_time_step)
+	{
+		// a particle on level l integrates 2^l times the time step, with adaptive substeps its time would drift from the global time
+		require(parameters.multirate_levels == 0, "multirate_levels can't be combined with adaptive_time_step");
+		require(parameters.min_time_step > 0 && parameters.min_time_step <= parameters.max_time_step && parameters.max_time_step <= parameters.timeStep,
+			"the time steps have to be 0 < min_time_step <= max_time_step <= time_step");
+	}
+
+	// the parameters which the prompts don't ask for in this case
+	if (parameters.method == PressureComputationMethod::positionBased)
+	{
+		parameters.min_iterations = parameters.max_iterations;
+	}
+	if (!parameters.adaptive_time_step)
+	{
+		parameters.min_time_step = parameters.timeStep;
+		parameters.max_time_step = parameters.timeStep;
+	}
+	return valid;
+}
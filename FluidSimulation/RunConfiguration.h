@@ -0,0 +1,48 @@
+#pragma once
+#include "IO.h"
+#include <string>
+#include <ostream>
+
+/**
+ *	Declarative configuration of a simulation run, so that runs can be scripted without the prompts of IO::decide_parameters.
+ *	A configuration file has one parameter per line as "name = value", empty lines and lines starting with # are ignored.
+ *	The same parameters can be given on the command line as "--name value", e.g. "--particle_size 2".
+ *	The names are the names of the members of RunParameters, time_step stands for timeStep.
+ *	Choices are given by name, e.g. "method = predictive_corrective", or by their number in the prompts.
+ *	Parameters which aren't given keep the defaults of RunParameters.
+ */
+
+/**
+ *	Read a whole text as an integer, e.g. a parameter or a command-line argument
+ *	@return false if the text isn't an integer, the value is unchanged then
+ */
+bool parseInteger(const std::string& text, int& value);
+
+/**
+ *	@return true if there is a parameter with this name
+ */
+bool isRunParameter(const std::string& name);
+
+/**
+ *	Set one parameter from its text
+ *	@return false if the name is unknown or the value can't be read, the reason is printed
+ */
+bool setRunParameter(RunParameters& parameters, const std::string& name, const std::string& value);
+
+/**
+ *	Set the parameters given in a configuration file
+ *	@return false if the file can't be read or has an invalid line, the reasons are printed
+ */
+bool loadRunConfiguration(const std::string& file_name, RunParameters& parameters);
+
+/**
+ *	Write all parameters as a configuration file, which repeats the run when it is loaded
+ */
+void writeRunConfiguration(std::ostream& stream, const RunParameters& parameters);
+
+/**
+ *	Check that the parameters can be simulated and derive the parameters which follow from others, as the prompts do.
+ *	Only limits which the simulation needs are checked, large domains, deep fluids and small particles are allowed.
+ *	@return false if a parameter is invalid, the reasons are printed
+ */
+bool validateRunParameters(RunParameters& parameters);
@@ -0,0 +1,275 @@
+#include "Scenario.h"
+#include <glm/glm.hpp>
+#include <random>
+#include <limits>
+#include <memory>
+#include <cmath>
+
+void createSimulationScenario(Simulation& simulation, const SimulationScenario environment, const int fluid_depth, const BoundaryHandlingMethod boundary_method)
+{
+	std::random_device rd;
+	std::mt19937 mt(rd());
+	std::uniform_real_distribution<double> dist(0.0f, 1.0f);
+	
+	const float particle_size = simulation.getParticleSize();
+	const int width = simulation.getWidth();
+	const int height = simulation.getHeight();
+	// particles of at least one pixel lie on whole pixels, smaller particles on a grid of their size
+	const float spacing = particle_size >= 1 ? std::floor(particle_size) : particle_size;
+	const float grid = glm::min(spacing, 1.f);
+
+	// With boundary shapes the particles of an obstacle are not added, they only extend a box which replaces them.
+	// The surface of a shape lies half a particle size outside of the outermost boundary particles.
+	const bool shapes = boundary_method == BoundaryHandlingMethod::shapes;
+	glm::vec2 obstacleMin = glm::vec2(std::numeric_limits<float>::max());
+	glm::vec2 obstacleMax = -obstacleMin;
+	auto addBoundaryParticle = [&](glm::vec2 position)
+	{
+		if (!shapes)
+		{
+			simulation.addParticle(position, glm::vec3(0.5f, 0.5f, 0.5f), true);
+			return;
+		}
+		obstacleMin = glm::min(obstacleMin, position);
+		obstacleMax = glm::max(obstacleMax, position);
+	};
+	auto finishObstacle = [&]()
+	{
+		if (shapes && obstacleMin.x <= obstacleMax.x)
+		{
+			const glm::vec2 margin = glm::vec2(particle_size / 2, particle_size / 2);
+			simulation.addBoundaryShape(std::make_unique<BoundaryBox>(obstacleMin - margin, obstacleMax + margin));
+		}
+		obstacleMin = glm::vec2(std::numeric_limits<float>::max());
+		obstacleMax = -obstacleMin;
+	};
+	
+	// A periodic channel has no side walls, the fluid leaving it on the right enters it on the left.
+	// Gravity is tilted like on the ramp of the flowing fluid, which has a slope of 1/2.
+	const bool periodic = environment == SimulationScenario::periodicChannel;
+	if (periodic)
+	{
+		simulation.setPeriodic(0);
+		simulation.setGravityDirection(glm::vec2(1.f, -2.f));
+	}
+
+	// Add boundary particles
+	if (shapes)
+	{
+		const float wall = 2 * spacing + particle_size / 2;
+		if (!periodic)
+		{
+			simulation.addBoundaryShape(std::make_unique<BoundaryPlane>(glm::vec2(wall, 0.f), glm::vec2(1.f, 0.f)));
+			simulation.addBoundaryShape(std::make_unique<BoundaryPlane>(glm::vec2(float(width) - wall, 0.f), glm::vec2(-1.f, 0.f)));
+		}
+		simulation.addBoundaryShape(std::make_unique<BoundaryPlane>(glm::vec2(0.f, wall), glm::vec2(0.f, 1.f)));
+	}
+	else
+	{
+		for (int column = 0; column < 3 && !periodic; ++column)
+		{
+			const float x = column * spacing;
+			for (int row = 0; row * spacing <= height; ++row)
+			{
+				const float y = row * spacing;
+				simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
+				simulation.addParticle(glm::vec2(width - x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
+			}
+		}
+
+		// the floor of a periodic channel covers the whole width
+		const float floorStart = periodic ? 0 : 3 * spacing;
+		const float floorEnd = periodic ? float(width - 1) : width - 3 * spacing;
+		for (int column = 0; floorStart + column * spacing <= floorEnd; ++column)
+		{
+			const float x = floorStart + column * spacing;
+			for (int row = 0; row < 3; ++row)
+			{
+				const float y = row * spacing;
+				simulation.addParticle(glm::vec2(x, y), glm::vec3(0.5f, 0.5f, 0.5f), true);
+			}
+		}
+	}
+	
+	switch(environment)
+	{
+	case SimulationScenario::leakyDam:
+	{
+		// the dam consists of a lower and an upper part with a gap in between
+		const float dam = float(width / 2) + std::fmod(float(width / 2), spacing);
+		for (int column = 0; column * spacing < 6 * particle_size; ++column)
+		{
+			const float x = dam + column * spacing;
+			for (int row = 3; row * spacing < height / 6; ++row)
+			{
+				const float y = row * spacing;
+				addBoundaryParticle(glm::vec2(x, y));
+			}
+		}
+		finishObstacle();
+		for (int column = 0; column * spacing < 6 * particle_size; ++column)
+		{
+			const float x = dam + column * spacing;
+			for (int row = 5; height / 6 + row * spacing <= height; ++row)
+			{
+				const float y = height / 6 + row * spacing;
+				addBoundaryParticle(glm::vec2(x, y));
+			}
+		}
+		finishObstacle();
+	}
+	case SimulationScenario::breakingDam:
+		for (int column = 3; column * spacing < width / 2; ++column)
+		{
+			const float x = column * spacing;
+			for (int row = 3; row < 3 + fluid_depth; ++row)
+			{
+				const float y = row * spacing;
+				simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
+			}
+		}
+		break;
+
+	case SimulationScenario::droppingFluid:
+		for (int column = 0; width / 3 + column * spacing <= 2 * width / 3; ++column)
+		{
+			const float x = width / 3 + column * spacing;
+			for (int row = 3; row * spacing <= (height / 3) + fluid_depth * spacing; ++row)
+			{
+				const float y = row * spacing;
+				if (y <= height / 3)
+				{
+					addBoundaryParticle(glm::vec2(x, y));
+				}
+				else
+				{
+					simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
+				}
+			}
+		}
+		finishObstacle();
+		break;
+
+	case SimulationScenario::flowingFluid:
+		for (int column = 3; column * spacing <= width / 2; ++column)
+		{
+			const float x = column * spacing;
+			for (int i = shapes ? 3 : 0; i < fluid_depth + 3; ++i)
+			{
+				bool boundary = i < 3 ? true : false;
+				const float y = 3 * particle_size + width / 4 - grid * std::floor(x / (2 * grid)) + i * particle_size;
+				simulation.addParticle(glm::vec2(x, grid * std::floor(y / grid)), 
+								       glm::vec3(0.5f, 0.5f, 0.5f), boundary);
+			}
+		}
+		if (shapes)
+		{
+			// the ramp is three particles high, with a slope of 1/2 this is 3 * 2 / sqrt(5) particle sizes perpendicular to it
+			const float start = 3 * particle_size;
+			const float end = float(width / 2);
+			simulation.addBoundaryShape(std::make_unique<BoundarySegment>(glm::vec2(start, 4 * particle_size + float(width / 4) - start / 2),
+																		  glm::vec2(end, 4 * particle_size + float(width / 4) - end / 2),
+																		  3 * particle_size * 2 / glm::sqrt(5.f)));
+		}
+		break;
+
+	case SimulationScenario::periodicChannel:
+		for (int column = 0; column * spacing < width; ++column)
+		{
+			const float x = column * spacing;
+			for (int row = 3; row < 3 + fluid_depth; ++row)
+			{
+				const float y = row * spacing;
+				simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
+			}
+		}
+		break;
+
+	case SimulationScenario::restingFluid:
+		for (int column = 3; column * spacing <= width - 3 * spacing; ++column)
+		{
+			const float x = column * spacing;
+			for (int row = 3; row < 3 + fluid_depth; ++row)
+			{
+				const float y = row * spacing;
+				simulation.addParticle(glm::vec2(x, y), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
+			}
+		}
+		break;
+		
+	default:
+		break;
+	}
+}
+
+void createSimulationScenario(BasicSimulation<3>& simulation, const SimulationScenario environment, const int fluid_depth, const BoundaryHandlingMethod boundary_method)
+{
+	std::random_device rd;
+	std::mt19937 mt(rd());
+	std::uniform_real_distribution<double> dist(0.0f, 1.0f);
+
+	const int particle_size = int(simulation.getParticleSize());
+	const glm::ivec3 size = simulation.getDomainSize();
+	const glm::vec3 boundaryColor = glm::vec3(0.5f, 0.5f, 0.5f);
+
+	// Add boundary particles, the walls along the x-axis cover the corners
+	if (boundary_method == BoundaryHandlingMethod::shapes)
+	{
+		const float wall = float(2 * particle_size) + float(particle_size) / 2;
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<3>>(glm::vec3(wall, 0.f, 0.f), glm::vec3(1.f, 0.f, 0.f)));
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<3>>(glm::vec3(float(size.x) - wall, 0.f, 0.f), glm::vec3(-1.f, 0.f, 0.f)));
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<3>>(glm::vec3(0.f, 0.f, wall), glm::vec3(0.f, 0.f, 1.f)));
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<3>>(glm::vec3(0.f, 0.f, float(size.z) - wall), glm::vec3(0.f, 0.f, -1.f)));
+		simulation.addBoundaryShape(std::make_unique<BasicBoundaryPlane<3>>(glm::vec3(0.f, wall, 0.f), glm::vec3(0.f, 1.f, 0.f)));
+	}
+	else
+	{
+		for (int layer = 0; layer < 3 * particle_size; layer += particle_size)
+		{
+			for (int y = 0; y <= size.y; y += particle_size)
+			{
+				for (int z = 0; z <= size.z; z += particle_size)
+				{
+					simulation.addParticle(glm::vec3(layer, y, z), boundaryColor, true);
+					simulation.addParticle(glm::vec3(size.x - layer, y, z), boundaryColor, true);
+				}
+				for (int x = 3 * particle_size; x <= size.x - 3 * particle_size; x += particle_size)
+				{
+					simulation.addParticle(glm::vec3(x, y, layer), boundaryColor, true);
+					simulation.addParticle(glm::vec3(x, y, size.z - layer), boundaryColor, true);
+				}
+			}
+			for (int x = 3 * particle_size; x <= size.x - 3 * particle_size; x += particle_size)
+			{
+				for (int z = 3 * particle_size; z <= size.z - 3 * particle_size; z += particle_size)
+				{
+					simulation.addParticle(glm::vec3(x, layer, z), boundaryColor, true);
+				}
+			}
+		}
+	}
+
+	// the breaking dam fills the left half of the container, the resting fluid the whole container
+	int fluidEnd;
+	switch (environment)
+	{
+	case SimulationScenario::breakingDam:
+		fluidEnd = size.x / 2 - 1;
+		break;
+	case SimulationScenario::restingFluid:
+		fluidEnd = size.x - 3 * particle_size;
+		break;
+	default:
+		return;
+	}
+	for (int x = 3 * particle_size; x <= fluidEnd; x += particle_size)
+	{
+		for (int y = 3 * particle_size; y < (3 + fluid_depth) * particle_size; y += particle_size)
+		{
+			for (int z = 3 * particle_size; z <= size.z - 3 * particle_size; z += particle_size)
+			{
+				simulation.addParticle(glm::vec3(x, y, z), glm::vec3(dist(mt), dist(mt), dist(mt)), false);
+			}
+		}
+	}
+}
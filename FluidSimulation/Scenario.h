@@ -0,0 +1,24 @@
+#pragma once
+#include "IO.h"
+#include "Simulation.h"
+
+/**
+ *	Add the boundary and fluid particles of a scenario to the simulation
+ *	@param simulation the simulation to which the particles are added
+ *	@param environment the scenario which is created
+ *	@param fluid_depth depth of the fluid in particles
+ *	@param boundary_method with boundary shapes the walls and obstacles are added as shapes instead of boundary particles
+ */
+void createSimulationScenario(Simulation& simulation, const SimulationScenario environment, const int fluid_depth,
+							  const BoundaryHandlingMethod boundary_method = BoundaryHandlingMethod::particles);
+
+/**
+ *	Add the boundary and fluid particles of a scenario to a 3D simulation. The container is a box with walls along the x- and z-axis
+ *	and the floor at y = 0. Only the breaking dam and the resting fluid have fluid in 3D, the other scenarios create the empty container.
+ *	@param simulation the simulation to which the particles are added
+ *	@param environment the scenario which is created
+ *	@param fluid_depth depth of the fluid in particles
+ *	@param boundary_method with boundary shapes the walls and the floor are added as shapes instead of boundary particles
+ */
+void createSimulationScenario(BasicSimulation<3>& simulation, const SimulationScenario environment, const int fluid_depth,
+							  const BoundaryHandlingMethod boundary_method = BoundaryHandlingMethod::particles);
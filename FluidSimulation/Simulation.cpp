@@ -1,41 +1,60 @@
 #include "Simulation.h"
 #include "IO.h"
+#include "Profiler.h"
+#include "LatencyHistogram.h"
 #include <glm/glm.hpp>
 #include <cmath>
 #include <iostream>
 #include <array>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
 
-Simulation::Simulation(int width, int height, float particleSize, float fluidDensity, float viscosity, float gravity, IO* io)
+template <int Dim, typename Real, typename Accumulator>
+BasicSimulation<Dim, Real, Accumulator>::BasicSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io)
 {
-	this->width = width;
-	this->height = height;
+	this->domainSize = size;
 	particles = std::vector<Particle>();
 	this->particleSize = particleSize;
 	this->kernelSupport = 2 * particleSize;
 	this->fluidDensity = fluidDensity;
-	this->particleMass = fluidDensity * particleSize * particleSize;
+	this->particleMass = fluidDensity * Dimension<Dim, Real>::volume(particleSize);
+	this->gravityDirection = vec(Real(0));
+	this->gravityDirection[1] = -Real(1);
 	this->viscosity = viscosity;
 	this->gravity = gravity;
 	this->io = io;
 }
 
-Simulation::~Simulation() = default;
+template <int Dim, typename Real, typename Accumulator>
+BasicSimulation<Dim, Real, Accumulator>::~BasicSimulation() = default;
 
 
-void Simulation::addParticle(glm::vec2 position, glm::vec3 color, bool boundary)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::addParticle(vec position, glm::vec3 color, bool boundary)
 {
-	particles.push_back({position, color, boundary});
+	Particle particle = {position, color, boundary};
+	addParticle(particle);
 }
 
-void Simulation::addParticle(const Particle particle)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::addParticle(const Particle particle)
 {
 	particles.push_back(particle);
+	particles.back().id = nextParticleId++;
+	if (particles.back().size == 0)
+	{
+		particles.back().size = particleSize;
+		particles.back().mass = particleMass;
+	}
 }
 
 
-std::vector<glm::vec2>* Simulation::getParticlePositions() const
+template <int Dim, typename Real, typename Accumulator>
+std::vector<typename Dimension<Dim, Real>::vec>* BasicSimulation<Dim, Real, Accumulator>::getParticlePositions() const
 {
-	auto* particlePositions = new std::vector<glm::vec2>();
+	auto* particlePositions = new std::vector<vec>();
 	for (auto& particle : particles)
 	{
 		// Iterate through each particle and add its position to the position vector
@@ -44,47 +63,537 @@ std::vector<glm::vec2>* Simulation::getParticlePositions() const
 	return particlePositions;
 }
 
-const std::vector<Particle>& Simulation::getParticles() const
+template <int Dim, typename Real, typename Accumulator>
+const std::vector<BasicParticle<Dim, Real>>& BasicSimulation<Dim, Real, Accumulator>::getParticles() const
 {
 	return particles;
 }
 
-void Simulation::performSimulationStep(float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::performSimulationStep(Real timeDifference)
 {
+	PROFILE_SCOPE("simulation step");
+	static LatencyHistogram& stepLatency = LatencyHistogram::get("simulation step");
+	LatencyTimer stepTimer(stepLatency);
+	const auto start = std::chrono::steady_clock::now();
+	particleUpdates = 0;
+	if (!adaptiveTimeStep)
+	{
+		advance(timeDifference);
+		wrapPositions();
+		lastTimeStep = timeDifference;
+		++multirateStep;
+	}
+	else
+	{
+		// divide the step into substeps, so that output frames keep a fixed physical rate
+		Real remainingTime = timeDifference;
+		Real timeStepLimit = maxTimeStep;
+		int rollbacks = 0;
+		while (remainingTime > 0)
+		{
+			Real timeStep = glm::min(computeAdaptiveTimeStep(), timeStepLimit);
+
+			// divide the remaining time evenly, so that there is no tiny last substep
+			timeStep = remainingTime / glm::ceil(remainingTime / timeStep);
+
+			// a substep doesn't add or remove particles, so only the fields which it integrates are saved.
+			// Its measured values are held back, a rejected substep must neither appear in them nor choose the next time step.
+			rollbackState.resize(particles.size());
+			for (unsigned int i = 0; i < particles.size(); ++i)
+			{
+				const Particle& particle = particles[i];
+				rollbackState[i] = { particle.position, particle.velocity, particle.density, particle.pressure, particle.calmSteps, particle.sleeping };
+			}
+			const int solverIterations = lastSolverIterations;
+			io->hold_metrics();
+			advance(timeStep);
+			wrapPositions();
+
+			// roll back and retry with half the time step if the CFL condition is violated
+			if (getMaxSpeed() * timeStep >= particleSize && timeStep > minTimeStep)
+			{
+				for (unsigned int i = 0; i < particles.size(); ++i)
+				{
+					Particle& particle = particles[i];
+					particle.position = rollbackState[i].position;
+					particle.velocity = rollbackState[i].velocity;
+					particle.density = rollbackState[i].density;
+					particle.pressure = rollbackState[i].pressure;
+					particle.calmSteps = rollbackState[i].calmSteps;
+					particle.sleeping = rollbackState[i].sleeping;
+				}
+				lastSolverIterations = solverIterations;
+				io->release_metrics(false);
+				timeStepLimit = glm::max(timeStep / 2, minTimeStep);
+				++rollbacks;
+				continue;
+			}
+			io->release_metrics(true);
+			timeStepLimit = maxTimeStep;
+			lastTimeStep = timeStep;
+			++multirateStep;
+			remainingTime -= timeStep;
+			io->print_time_step(steps, static_cast<float>(timeStep), rollbacks);
+			rollbacks = 0;
+		}
+	}
+
+	// merging and splitting changes the particles slowly, so it is only done every few steps
+	if (adaptiveResolution && ++resolutionSteps % resolutionInterval == 0)
+	{
+		adaptResolution();
+		wrapPositions();
+	}
+
+	// update color of each non boundary particle, the speeds are compared with the last time step, not with the step of a frame
+	updateColor(lastTimeStep);
+
+	if (sleepingEnabled)
+	{
+		// estimate the saved time by assuming that a sleeping particle costs as much as an awake one
+		const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - start;
+		int fluidParticles = 0;
+		for (const Particle& particle : particles)
+		{
+			if (!particle.boundary)
+			{
+				++fluidParticles;
+			}
+		}
+		const int awakeParticles = getAwakeParticles();
+		const Real estimatedSavedTime = awakeParticles > 0 ? duration.count() * Real(fluidParticles - awakeParticles) / Real(awakeParticles) : Real(0);
+		io->print_sleeping_particles(steps, awakeParticles, static_cast<float>(estimatedSavedTime));
+	}
+
+	if (multirateLevels > 0)
+	{
+		io->print_particle_updates(steps, particleUpdates);
+	}
+	++steps;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::advance(Real timeDifference)
+{
+	// the particles which are synchronized with the global time change their time level
+	switchTimeLevels();
+
 	// Do neighbor search
 	std::vector<std::vector<unsigned int>> neighbors = createNeighborVector();
+	sampleBoundaries();
 
 	// compute density of each particle
-	computeDensitiesExplicit(neighbors);
+	if (adaptiveResolution)
+	{
+		computeDensitiesBlended(neighbors, timeDifference);
+	}
+	else
+	{
+		computeDensitiesExplicit(neighbors);
+	}
 
 	// compute non pressure accelerations
-	std::vector<glm::vec2> accNonP = computeNonPressureAccelerations(neighbors);
+	std::vector<vec> accNonP = computeNonPressureAccelerations(neighbors);
 
 	// update position and velocity of each particle
 	updateVelocity(accNonP, timeDifference);
+	if (viscosityMethod == ViscosityComputationMethod::implicitIntegration)
+	{
+		solveViscosityImplicit(neighbors, timeDifference);
+	}
 
 	// compute density of each particle
 	//computeDensitiesDifferential(neighbors, timeDifference);
 
 	// compute pressure of each particle
-	computePressures(neighbors, timeDifference);
+	{
+		static LatencyHistogram& pressureLatency = LatencyHistogram::get("pressure solve");
+		LatencyTimer pressureTimer(pressureLatency);
+		computePressures(neighbors, timeDifference);
+	}
 	
 	// compute pressure accelerations
-	std::vector<glm::vec2> accP = computePressureAccelerations(neighbors);
+	std::vector<vec> accP = computePressureAccelerations(neighbors);
 
 	// update position and velocity of each particle
 	updateVelocity(accP, timeDifference);
 	updatePosition(timeDifference);
 
-	// update color of each non boundary particle
-	updateColor(timeDifference);
+	// the larger of both accelerations limits the time level, at rest they cancel each other
+	std::vector<vec> acc = accNonP;
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (glm::length(accP[i]) > glm::length(acc[i]))
+		{
+			acc[i] = accP[i];
+		}
+	}
+	updateTimeLevels(neighbors, acc, timeDifference);
+	updateSleepingParticles(neighbors);
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::switchTimeLevels()
+{
+	if (multirateLevels == 0)
+	{
+		return;
+	}
+
+	// A particle on level l which is updated in this step has been integrated exactly up to this step.
+	// Every lower level has a step here as well, a higher level only if the step is a multiple of its time step.
+	// Switching at any other time would integrate the particle twice over the same interval or skip an interval.
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		const int level = particles[i].nextTimeLevel;
+		if (level < particles[i].timeLevel || (multirateStep & ((1u << level) - 1)) == 0)
+		{
+			particles[i].timeLevel = level;
+		}
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::updateTimeLevels(const std::vector<std::vector<unsigned>>& neighborVector, const std::vector<vec>& acc, Real timeDifference)
+{
+	PROFILE_SCOPE("time levels");
+	if (multirateLevels == 0)
+	{
+		return;
+	}
+
+	int updates = 0;
+
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		++updates;
+
+		// the largest level whose time step fulfills the CFL condition and the force condition of the particle
+		Real maxTimeDifference = std::numeric_limits<Real>::max();
+		const Real speed = glm::length(particles[i].velocity);
+		if (speed > 0)
+		{
+			maxTimeDifference = cflNumber * particleSize / speed;
+		}
+		const Real acceleration = glm::length(acc[i]);
+		if (acceleration > 0)
+		{
+			maxTimeDifference = glm::min(maxTimeDifference, cflNumber * glm::sqrt(particleSize / acceleration));
+		}
+		const Real ratio = maxTimeDifference / timeDifference;
+		int targetLevel = ratio < 2 ? 0 : glm::min(int(glm::floor(glm::log2(ratio))), multirateLevels);
+
+		// a particle may only be one level slower than its neighbors
+		for (auto& j : neighborVector[i])
+		{
+			if (!particles[j].boundary)
+			{
+				targetLevel = glm::min(targetLevel, particles[j].timeLevel + 1);
+			}
+		}
+
+		// the particle has been integrated up to its next update, so the level is only switched then (switchTimeLevels)
+		particles[i].nextTimeLevel = glm::min(targetLevel, particles[i].timeLevel + 1);
+	}
+	particleUpdates += updates;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::adaptResolution()
+{
+	PROFILE_SCOPE("adaptive resolution");
+	const std::vector<std::vector<unsigned int>> neighbors = createNeighborVector();
+
+	// estimate the distance to the surface by propagating it from the surface particles over the neighbors.
+	// Particles with missing neighbors and particles next to the boundary count as surface.
+	std::vector<Real> surfaceDistance;
+	surfaceDistance.resize(particles.size(), std::numeric_limits<Real>::max());
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		if (particles[i].density < Real(0.9) * fluidDensity || sampleBoundary(particles[i].position).density > 0)
+		{
+			surfaceDistance[i] = 0;
+		}
+		for (auto& j : neighbors[i])
+		{
+			if (particles[j].boundary)
+			{
+				surfaceDistance[i] = 0;
+			}
+		}
+	}
+	// each sweep propagates the distance by at least one particle size, distances deeper than the largest level don't matter
+	const int sweeps = int(glm::ceil(mergeDistance * Real((1 << maxResolutionLevel) - 1) / particleSize));
+	bool changed = true;
+	for (int sweep = 0; sweep < sweeps && changed; ++sweep)
+	{
+		// the sweeps alternate their direction, so that the distance travels far in both directions of the particle order
+		changed = false;
+		for (unsigned int n = 0; n < particles.size(); ++n)
+		{
+			const unsigned int i = sweep % 2 == 0 ? n : unsigned(particles.size()) - 1 - n;
+			for (auto& j : neighbors[i])
+			{
+				if (j != i && surfaceDistance[j] < std::numeric_limits<Real>::max())
+				{
+					const Real distance = surfaceDistance[j] + glm::length(getDifference(particles[i].position, particles[j].position));
+					if (distance < surfaceDistance[i])
+					{
+						surfaceDistance[i] = distance;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+
+	// magnitude of the vorticity w_i = 1 / density_i * sum_j m_j (v_j - v_i) x nabla W_ij
+	std::vector<Real> vorticity;
+	vorticity.resize(particles.size(), Real(0));
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i) || particles[i].density == 0)
+		{
+			continue;
+		}
+		typename Dimension<Dim, Real>::rotation rotation = typename Dimension<Dim, Real>::rotation(Real(0));
+		for (auto& j : neighbors[i])
+		{
+			if (particles[j].boundary)
+			{
+				continue;
+			}
+			const vec v_ji = particles[j].velocity - particles[i].velocity;
+			const vec gradient = kernelGradient(particles[i].position, particles[j].position, getSmoothingLength(i, j));
+			rotation += particles[j].mass * Dimension<Dim, Real>::cross(v_ji, gradient);
+		}
+		vorticity[i] = Dimension<Dim, Real>::magnitude(rotation) / particles[i].density;
+	}
+
+	std::vector<Particle> adapted;
+	adapted.reserve(particles.size());
+	std::vector<bool> merged;
+	merged.resize(particles.size(), false);
+
+	// merge compact groups of 2^Dim particles of the same level, i.e. a particle and its 2^Dim - 1 nearest candidates,
+	// whose positions lie close to a 2x2 (2x2x2 in 3D) block around their center
+	const unsigned int groupSize = 1u << Dim;
+	std::vector<int> level;
+	level.resize(particles.size(), 0);
+	std::vector<bool> candidate;
+	candidate.resize(particles.size(), false);
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		level[i] = getResolutionLevel(i);
+		candidate[i] = isUpdatedThisStep(i) && level[i] < maxResolutionLevel &&
+					   surfaceDistance[i] > mergeDistance * Real((2 << level[i]) - 1) && vorticity[i] < Real(0.5) * vorticityThreshold;
+	}
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!candidate[i] || merged[i])
+		{
+			continue;
+		}
+		std::vector<std::pair<Real, unsigned int>> nearest;
+		for (auto& j : neighbors[i])
+		{
+			if (j != i && candidate[j] && !merged[j] && level[j] == level[i])
+			{
+				nearest.push_back({ glm::length(getDifference(particles[i].position, particles[j].position)), j });
+			}
+		}
+		if (nearest.size() < groupSize - 1)
+		{
+			continue;
+		}
+		std::partial_sort(nearest.begin(), nearest.begin() + (groupSize - 1), nearest.end());
+		std::vector<unsigned int> group = { i };
+		for (unsigned int n = 0; n < groupSize - 1; ++n)
+		{
+			group.push_back(nearest[n].second);
+		}
+
+		// the merged particle sits at the center of mass and keeps the momentum of the group,
+		// the positions are taken relative to particle i so that groups across a periodic boundary stay together
+		Particle particle = particles[i];
+		particle.mass = 0;
+		particle.position = vec(Real(0));
+		particle.velocity = vec(Real(0));
+		particle.density = 0;
+		particle.pressure = 0;
+		for (auto& j : group)
+		{
+			particle.mass += particles[j].mass;
+			particle.position += particles[j].mass * getDifference(particles[j].position, particles[i].position);
+			particle.velocity += particles[j].mass * particles[j].velocity;
+			particle.density += particles[j].density / Real(groupSize);
+			particle.pressure += particles[j].pressure / Real(groupSize);
+		}
+		particle.position = particles[i].position + particle.position / particle.mass;
+		particle.velocity /= particle.mass;
+
+		// the corners of a 2x2 block are 0.71 particle sizes away from its center, the corners of a 2x2x2 block 0.87
+		bool compact = true;
+		for (auto& j : group)
+		{
+			compact = compact && glm::length(getDifference(particles[j].position, particle.position)) < particles[i].size;
+		}
+		if (!compact)
+		{
+			continue;
+		}
+		for (auto& j : group)
+		{
+			merged[j] = true;
+		}
+		particle.size = 2 * particles[i].size;
+		particle.calmSteps = 0;
+		particle.timeLevel = 0;
+		particle.nextTimeLevel = 0;
+		particle.id = nextParticleId++;
+		adapted.push_back(particle);
+	}
+
+	// split merged particles near the surface of their level or in a vortex into 2^Dim particles of the level below with the same velocity
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (merged[i])
+		{
+			continue;
+		}
+		if (!isUpdatedThisStep(i) || level[i] == 0 ||
+			(surfaceDistance[i] >= splitDistance * Real((1 << level[i]) - 1) && vorticity[i] <= vorticityThreshold))
+		{
+			adapted.push_back(particles[i]);
+			continue;
+		}
+		// each bit of the child chooses the positive offset along one axis
+		const Real offset = Real(0.25) * particles[i].size;
+		for (unsigned int child = 0; child < groupSize; ++child)
+		{
+			Particle particle = particles[i];
+			for (int axis = 0; axis < Dim; ++axis)
+			{
+				particle.position[axis] += (child >> axis) & 1 ? offset : -offset;
+			}
+			particle.mass = particles[i].mass / Real(groupSize);
+			particle.size = Real(0.5) * particles[i].size;
+			particle.calmSteps = 0;
+			particle.timeLevel = 0;
+			particle.nextTimeLevel = 0;
+			particle.id = nextParticleId++;
+			adapted.push_back(particle);
+		}
+	}
+	particles = adapted;
+
+	io->print_particle_count(steps, static_cast<int>(particles.size()), getMergedParticles());
 }
 
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::updateSleepingParticles(const std::vector<std::vector<unsigned>>& neighborVector)
+{
+	PROFILE_SCOPE("sleeping particles");
+	if (!sleepingEnabled)
+	{
+		return;
+	}
+
+	// wake up the sleeping neighbors of fast particles, the neighbor relation is symmetric
+	// so the awake particles find their sleeping neighbors.
+	// The wake up threshold is twice the sleep threshold, so that noise doesn't wake up particles all the time.
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i) || glm::length(particles[i].velocity) < 2 * sleepVelocity)
+		{
+			continue;
+		}
+		for (auto& j : neighborVector[i])
+		{
+			if (particles[j].sleeping)
+			{
+				particles[j].sleeping = false;
+				particles[j].calmSteps = 0;
+			}
+		}
+	}
 
-void Simulation::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference)
+	// put particles to sleep which have been calm for some steps
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		const bool calm = glm::length(particles[i].velocity) < sleepVelocity &&
+						  particles[i].density / fluidDensity - 1 < sleepDensityError;
+		particles[i].calmSteps = calm ? particles[i].calmSteps + 1 : 0;
+		if (particles[i].calmSteps >= sleepSteps)
+		{
+			particles[i].sleeping = true;
+			particles[i].velocity = vec(Real(0));
+		}
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::computeAdaptiveTimeStep() const
+{
+	Real timeStep = maxTimeStep;
+
+	// CFL condition
+	const Real maxSpeed = getMaxSpeed();
+	if (maxSpeed > 0)
+	{
+		timeStep = glm::min(timeStep, cflNumber * particleSize / maxSpeed);
+	}
+
+	// stability of the explicit viscosity
+	if (viscosityMethod == ViscosityComputationMethod::explicitIntegration && viscosity > 0)
+	{
+		timeStep = glm::min(timeStep, Real(0.5) * particleSize * particleSize / viscosity);
+	}
+
+	// shrink the time step if the pressure solver needed many iterations, grow it if it needed few
+	if (lastSolverIterations > 0 && lastTimeStep > 0)
+	{
+		const Real factor = glm::clamp(glm::sqrt(Real(targetSolverIterations) / Real(lastSolverIterations)), Real(0.5), Real(1.5));
+		timeStep = glm::min(timeStep, factor * lastTimeStep);
+	}
+
+	// don't grow the time step too fast
+	if (lastTimeStep > 0)
+	{
+		timeStep = glm::min(timeStep, Real(1.5) * lastTimeStep);
+	}
+
+	return glm::clamp(timeStep, minTimeStep, maxTimeStep);
+}
+
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
 {
+	PROFILE_SCOPE("pressure solve");
 	// This function is virtual and thus will be overridden, so just set pressure to 0.
-	std::vector<float> pressure;
+	std::vector<Real> pressure;
 	pressure.resize(particles.size());
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
@@ -93,80 +602,189 @@ void Simulation::computePressures(const std::vector<std::vector<unsigned>>& neig
 }
 
 
-std::vector<unsigned int> Simulation::getNeighbors(unsigned int particleIndex, const ParticleUniformGrid& grid) const
+template <int Dim, typename Real, typename Accumulator>
+std::vector<unsigned int> BasicSimulation<Dim, Real, Accumulator>::getNeighbors(unsigned int particleIndex, const Grid& grid) const
 {
 	std::vector<unsigned int> neighbors;
 	neighbors.reserve(20);
+	// the grid cells have the kernel support of the particles in the grid, which is twice their smoothing length
+	const Real radius = particles[particleIndex].size + Real(0.5) * grid.getCellWidth();
+	std::vector<unsigned int> possibleNeighbors = getPossibleNeighbors(particles[particleIndex].position, radius, grid);
+
+	// check if possible neighboring particles are indeed neighbors, the kernel support is twice the smoothing length
+	for (auto& possibleNeighbor : possibleNeighbors)
+	{
+		if (glm::length(getDifference(particles[particleIndex].position, particles[possibleNeighbor].position)) < 2 * getSmoothingLength(particleIndex, possibleNeighbor))
+		{
+			neighbors.push_back(possibleNeighbor);
+		}
+	}
+	return neighbors;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+std::vector<unsigned int> BasicSimulation<Dim, Real, Accumulator>::getPossibleNeighbors(vec position, Real radius, const Grid& grid) const
+{
 	std::vector<unsigned int> possibleNeighbors;
 	possibleNeighbors.reserve(20);
 
-	std::vector<unsigned int> counter = grid.getCounter();
-	std::vector<unsigned int> sortedList = grid.getSortedList();
-	std::array<glm::vec2, 9> directions = {
-		glm::vec2(0.f, 0.f),
-		glm::vec2(kernelSupport, 0.f),
-		glm::vec2(0.f, kernelSupport),
-		glm::vec2(-kernelSupport, 0.f),
-		glm::vec2(0.f, -kernelSupport),
-		glm::vec2(kernelSupport, kernelSupport),
-		glm::vec2(-kernelSupport, kernelSupport),
-		glm::vec2(-kernelSupport, -kernelSupport),
-		glm::vec2(kernelSupport, -kernelSupport),
+	const std::vector<unsigned int>& counter = grid.getCounter();
+	const std::vector<unsigned int>& sortedList = grid.getSortedList();
+
+	// a radius larger than the cells searches more cells in each direction
+	const Real cellWidth = grid.getCellWidth();
+	const int range = int(glm::ceil(radius / cellWidth));
+	const ivec cell = grid.getCell(position);
+
+	// Get the first and last cell offset along an axis. On a periodic axis the cells wrap around, and the last cell may lie
+	// only partially inside the simulation space, so one more cell is searched. No cell is searched twice.
+	// Otherwise only the cells which overlap the radius are searched, e.g. 4 instead of 5 for a radius of 1.5 cells.
+	// A particle which splashed out of the simulation space lies in the nearest cell, which is always searched.
+	auto getOffsets = [&](int cell, Real coordinate, Real size, bool periodicAxis, int& first, int& last, int& cells)
+	{
+		if (periodicAxis)
+		{
+			cells = int(glm::ceil(size / cellWidth));
+			first = 2 * range + 3 >= cells ? -cell : -range - 1;
+			last = 2 * range + 3 >= cells ? cells - 1 - cell : range + 1;
+		}
+		else
+		{
+			cells = int(size / cellWidth) + 1;
+			first = glm::min(glm::max(glm::max(int(glm::floor((coordinate - radius) / cellWidth)) - cell, -range), -cell), 0);
+			last = glm::max(glm::min(glm::min(int(glm::floor((coordinate + radius) / cellWidth)) - cell, range), cells - 1 - cell), 0);
+		}
 	};
+	ivec first, last, cells;
+	for (int axis = 0; axis < Dim; ++axis)
+	{
+		getOffsets(cell[axis], position[axis], Real(domainSize[axis]), periodic[axis], first[axis], last[axis], cells[axis]);
+	}
 
-	// find all particles which could possibly be a neighbor
-	for (auto& direction : directions)
+	forEachCell<Dim>(first, last, [&](const ivec& offset)
 	{
-		glm::vec2 pos = particles[particleIndex].position + direction;
-		if (!(0.f <= pos.x && pos.x < float(width) + kernelSupport - fmod(width, kernelSupport) && 
-			  0.f <= pos.y && pos.y < float(height) + kernelSupport - fmod(height, kernelSupport)))
+		ivec neighborCell;
+		for (int axis = 0; axis < Dim; ++axis)
 		{
-			continue;
+			neighborCell[axis] = (cell[axis] + offset[axis] + cells[axis]) % cells[axis];
 		}
-		const unsigned int cellIndex = grid.getCellIndex(pos);
+		const unsigned int cellIndex = grid.getCellIndex(neighborCell);
 		for (unsigned int i = counter[cellIndex]; i < counter[cellIndex + 1]; ++i)
 		{
 			possibleNeighbors.push_back(sortedList[i]);
 		}
+	});
+	return possibleNeighbors;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+std::vector<std::vector<unsigned int>> BasicSimulation<Dim, Real, Accumulator>::createNeighborVector() const
+{
+	PROFILE_SCOPE("neighbor search");
+	static LatencyHistogram& neighborLatency = LatencyHistogram::get("neighbor search");
+	LatencyTimer neighborTimer(neighborLatency);
+
+	// Each level of the merge hierarchy has its own grid whose cells have the kernel support of the level. A particle finds
+	// the neighbors of its own level in the adjacent cells, and the few larger particles search the grids of the smaller
+	// particles with their larger kernel support for both of them. Without merged particles there is one grid.
+	std::vector<std::vector<unsigned int>> levels(1);
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (particles[i].boundary && !boundaryMap.isEmpty())
+		{
+			continue;
+		}
+		const int level = getResolutionLevel(i);
+		if (level >= int(levels.size()))
+		{
+			levels.resize(level + 1);
+		}
+		levels[level].push_back(i);
+	}
+	std::vector<Grid> grids;
+	for (unsigned int level = 0; level < levels.size(); ++level)
+	{
+		grids.emplace_back(kernelSupport * Real(1u << level), domainSize);
+		grids.back().initializeGrid(particles, levels[level]);
 	}
 
-	// check if possible neighboring particles are indeed neighbors
-	for (auto& possibleNeighbor : possibleNeighbors)
+	std::vector<std::vector<unsigned int>> neighbors;
+	neighbors.resize(particles.size());
+	for (unsigned int level = 0; level < levels.size(); ++level)
+	{
+		for (auto& i : levels[level])
+		{
+			// boundary and sleeping particles don't need their own neighbors, but their smaller neighbors need them
+			if (isUpdatedThisStep(i))
+			{
+				neighbors[i] = getNeighbors(i, grids[level]);
+			}
+			for (unsigned int smaller = 0; smaller < level; ++smaller)
+			{
+				for (auto& j : getNeighbors(i, grids[smaller]))
+				{
+					if (isUpdatedThisStep(i))
+					{
+						neighbors[i].push_back(j);
+					}
+					if (isUpdatedThisStep(j))
+					{
+						neighbors[j].push_back(i);
+					}
+				}
+			}
+		}
+	}
+	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (glm::distance(particles[particleIndex].position, particles[possibleNeighbor].position) < kernelSupport)
+		if (!isUpdatedThisStep(i))
 		{
-			neighbors.push_back(possibleNeighbor);
+			neighbors[i] = std::vector<unsigned int>{i};
 		}
 	}
 	return neighbors;
 }
 
-std::vector<std::vector<unsigned int>> Simulation::createNeighborVector() const
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::computeDensitiesExplicit(const std::vector<std::vector<unsigned int>>& neighborVector)
 {
-	ParticleUniformGrid grid(kernelSupport, width, height);
-	grid.initializeGrid(particles);
-	std::vector<std::vector<unsigned int>> neighbors;
+	PROFILE_SCOPE("density");
+	Accumulator averageDensity = 0;
+	int amountFluidParticles = 0;
 	
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
 		if (particles[i].boundary)
 		{
-			neighbors.push_back(std::vector<unsigned int>{i});
+			continue;
 		}
-		else
+		// sleeping particles and particles on a time level which is not updated keep their density
+		if (isUpdatedThisStep(i))
 		{
-			neighbors.push_back(getNeighbors(i, grid));
+			Accumulator d = getBoundarySample(i).density;
+			for (auto& j : neighborVector[i])
+			{
+				d += particles[j].mass * kernelFunction(particles[i].position, particles[j].position, getSmoothingLength(i, j));
+			}
+			particles[i].density = Real(d);
 		}
+
+		amountFluidParticles++;
+		// For the average density, the density is clamped so that the surface doesn't influence it
+		averageDensity += glm::max(fluidDensity, particles[i].density);
 	}
-	return neighbors;
+	averageDensity /= static_cast<Accumulator>(amountFluidParticles);
+	io->print_average_density(steps, static_cast<float>(averageDensity));
 }
 
-void Simulation::computeDensitiesExplicit(const std::vector<std::vector<unsigned int>>& neighborVector)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::computeDensitiesBlended(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
 {
-	float averageDensity = 0;
+	PROFILE_SCOPE("density");
+	Accumulator averageDensity = 0;
 	int amountFluidParticles = 0;
-	
+
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
@@ -174,71 +792,118 @@ void Simulation::computeDensitiesExplicit(const std::vector<std::vector<unsigned
 		{
 			continue;
 		}
-		float d = 0;
-		for (auto& j : neighborVector[i])
+		if (isUpdatedThisStep(i))
 		{
-			d += kernelFunction(particles[i].position, particles[j].position);
+			// the boundary is at rest, so only the velocity of the fluid particle changes its boundary density
+			const BoundarySample boundary = getBoundarySample(i);
+			Accumulator sum = boundary.density;
+			Accumulator change = glm::dot(particles[i].velocity, boundary.densityGradient);
+			for (auto& j : neighborVector[i])
+			{
+				sum += particles[j].mass * kernelFunction(particles[i].position, particles[j].position, getSmoothingLength(i, j));
+				change += particles[j].mass * glm::dot(particles[i].velocity - particles[j].velocity,
+													   kernelGradient(particles[i].position, particles[j].position, getSmoothingLength(i, j)));
+			}
+
+			// new particles start with the density of the kernel sum
+			if (particles[i].density == 0)
+			{
+				particles[i].density = Real(sum);
+			}
+			else
+			{
+				const Accumulator continuity = particles[i].density + getParticleTimeStep(i, timeDifference) * change;
+				particles[i].density = Real(continuity + densityRelaxation * (sum - continuity));
+			}
 		}
-		d *= particleMass;
-		particles[i].density = d;
 
 		amountFluidParticles++;
 		// For the average density, the density is clamped so that the surface doesn't influence it
-		averageDensity += glm::max(fluidDensity, d);
+		averageDensity += glm::max(fluidDensity, particles[i].density);
 	}
-	averageDensity /= static_cast<float>(amountFluidParticles);
-	io->print_average_density(averageDensity);
+	averageDensity /= static_cast<Accumulator>(amountFluidParticles);
+	io->print_average_density(steps, static_cast<float>(averageDensity));
 }
 
-void Simulation::computeDensitiesDifferential(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::computeDensitiesDifferential(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
 {
-	float averageDensity = 0;
+	Accumulator averageDensity = 0;
 	int amountFluidParticles = 0;
 	
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isUpdatedThisStep(i))
 		{
 			continue;
 		}
-		float d = 0;
+		Accumulator d = glm::dot(particles[i].velocity, getBoundarySample(i).densityGradient);
 		for (auto& j : neighborVector[i])
 		{
-			d += glm::dot(particles[i].velocity - particles[j].velocity, kernelGradient(particles[i].position, particles[j].position));
+			d += particles[j].mass * glm::dot(particles[i].velocity - particles[j].velocity,
+											   kernelGradient(particles[i].position, particles[j].position, getSmoothingLength(i, j)));
 		}
-		d *= particleMass * timeDifference;
-		particles[i].density += d;
+		d *= timeDifference;
+		particles[i].density += Real(d);
 
 		amountFluidParticles++;
 		averageDensity += particles[i].density;
 	}
-	averageDensity /= float(amountFluidParticles);
+	averageDensity /= Accumulator(amountFluidParticles);
 	//std::cout << averageDensity << std::endl;
 }
 
-std::vector<glm::vec2> Simulation::computeNonPressureAccelerations(const std::vector<std::vector<unsigned>>& neighborVector) const
+template <int Dim, typename Real, typename Accumulator>
+std::vector<typename Dimension<Dim, Real>::vec> BasicSimulation<Dim, Real, Accumulator>::computeNonPressureAccelerations(const std::vector<std::vector<unsigned>>& neighborVector) const
+{
+	PROFILE_SCOPE("non-pressure forces");
+	// compute accelerations, implicit viscosity is applied separately after the velocity update
+	std::vector<vec> acc;
+	if (viscosityMethod == ViscosityComputationMethod::explicitIntegration)
+	{
+		acc = computeViscosityAccelerations(neighborVector);
+	}
+	else
+	{
+		acc.resize(particles.size(), vec(Real(0)));
+	}
+
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		acc[i] += gravity * gravityDirection;
+	}
+	return acc;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+std::vector<typename Dimension<Dim, Real>::vec> BasicSimulation<Dim, Real, Accumulator>::computeViscosityAccelerations(const std::vector<std::vector<unsigned>>& neighborVector) const
 {
-	// compute accelerations
-	std::vector<glm::vec2> acc;
+	std::vector<vec> acc;
 	acc.reserve(particles.size());
 
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isUpdatedThisStep(i))
 		{
-			acc.push_back(glm::vec2(0.f, 0.f));
+			acc.push_back(vec(Real(0)));
 			continue;
 		}
-		glm::vec2 acc_g = glm::vec2(0.f, -gravity);
-		glm::vec2 acc_v = glm::vec2(0.f, 0.f);
+		vec acc_v = vec(Real(0));
 
 		// compute viscosity acceleration
 		for (auto& j : neighborVector[i])
 		{
-			float factor = glm::dot(particles[i].velocity - particles[j].velocity, particles[i].position - particles[j].position);
-			factor /= glm::dot(particles[i].position - particles[j].position, particles[i].position - particles[j].position) + 0.01f * particleSize * particleSize;
+			const Real h = getSmoothingLength(i, j);
+			const vec x_ij = getDifference(particles[i].position, particles[j].position);
+			Real factor = particles[j].mass * glm::dot(particles[i].velocity - particles[j].velocity, x_ij);
+			factor /= glm::dot(x_ij, x_ij) + Real(0.01) * h * h;
 			if (particles[j].boundary)
 			{
 				factor *= 1 / particles[i].density;
@@ -248,33 +913,194 @@ std::vector<glm::vec2> Simulation::computeNonPressureAccelerations(const std::ve
 				factor *= 1 / particles[j].density;
 			}
 
-			acc_v += factor * kernelGradient(particles[i].position, particles[j].position);
+			acc_v += factor * kernelGradient(particles[i].position, particles[j].position, h);
 		}
-		acc_v *= 2 * viscosity * particleMass;
-		acc.push_back(acc_g + acc_v);
+		acc_v *= 2 * viscosity;
+		acc.push_back(acc_v);
 	}
 	return acc;
 }
 
-std::vector<glm::vec2> Simulation::computePressureAccelerations(const std::vector<std::vector<unsigned>>& neighborVector) const
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::solveViscosityImplicit(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference)
+{
+	PROFILE_SCOPE("implicit viscosity");
+	// The explicit viscosity acceleration of particle i is sum_j c_ij (x_ij x_ij^T) (v_i - v_j) with c_ij <= 0.
+	// The densities of both particles are averaged in c_ij so that the system matrix is symmetric positive definite.
+	// Only the scalar c_ij of each neighbor is stored, the matrix itself is never assembled.
+	// Each row is multiplied with the mass ratio m_i / particleMass, which keeps the matrix symmetric for particles of different mass.
+	std::vector<std::vector<Real>> coefficient;
+	coefficient.resize(particles.size());
+	std::vector<vec> preconditioner;
+	preconditioner.resize(particles.size());
+	std::vector<vec> x;
+	x.resize(particles.size());
+	std::vector<vec> b;
+	b.resize(particles.size());
+
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		x[i] = vec(Real(0));
+		b[i] = vec(Real(0));
+		preconditioner[i] = vec(Real(1));
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		coefficient[i].reserve(neighborVector[i].size());
+		const Real massRatio = particles[i].mass / particleMass;
+		vec diagonal = vec(massRatio);
+		vec fixedVelocities = vec(Real(0));
+		for (auto& j : neighborVector[i])
+		{
+			vec x_ij = getDifference(particles[i].position, particles[j].position);
+			const Real distanceSquared = glm::dot(x_ij, x_ij);
+			if (distanceSquared == 0)
+			{
+				coefficient[i].push_back(Real(0));
+				continue;
+			}
+			// the kernel gradient is parallel to x_ij, so it is replaced by x_ij times a scalar
+			const Real h = getSmoothingLength(i, j);
+			Real factor = glm::dot(x_ij, kernelGradient(particles[i].position, particles[j].position, h)) / distanceSquared;
+			factor /= distanceSquared + Real(0.01) * h * h;
+			if (particles[j].boundary)
+			{
+				factor *= 1 / particles[i].density;
+			}
+			else
+			{
+				factor *= 2 / (particles[i].density + particles[j].density);
+			}
+			factor *= -2 * viscosity * massRatio * particles[j].mass * timeDifference;
+			coefficient[i].push_back(factor);
+			diagonal += factor * x_ij * x_ij;
+
+			// the velocity of a neighbor which isn't solved for is known, so its term moves to the right hand side.
+			// Boundary and sleeping particles are at rest, fluid particles on a time level which isn't updated keep their velocity.
+			if (!isUpdatedThisStep(j))
+			{
+				fixedVelocities += factor * glm::dot(x_ij, particles[j].velocity) * x_ij;
+			}
+		}
+		// the velocity after the non-pressure accelerations is the right hand side and the initial guess
+		x[i] = particles[i].velocity;
+		b[i] = massRatio * particles[i].velocity + fixedVelocities;
+		preconditioner[i] = Real(1) / diagonal;
+	}
+
+	// multiply the system matrix with the vector p
+	auto multiply = [&](const std::vector<vec>& p, std::vector<vec>& result)
+	{
+		#pragma loop(hint_parallel(0))
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			result[i] = vec(Real(0));
+			if (!isUpdatedThisStep(i))
+			{
+				continue;
+			}
+			vec sum = particles[i].mass / particleMass * p[i];
+			for (unsigned int n = 0; n < neighborVector[i].size(); ++n)
+			{
+				const unsigned int j = neighborVector[i][n];
+				vec x_ij = getDifference(particles[i].position, particles[j].position);
+				// the velocities of the neighbors which aren't solved for are on the right hand side
+				vec p_ij = !isUpdatedThisStep(j) ? p[i] : p[i] - p[j];
+				sum += coefficient[i][n] * glm::dot(x_ij, p_ij) * x_ij;
+			}
+			result[i] = sum;
+		}
+	};
+
+	auto dot = [&](const std::vector<vec>& u, const std::vector<vec>& v)
+	{
+		Accumulator sum = 0;
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			sum += glm::dot(u[i], v[i]);
+		}
+		return sum;
+	};
+
+	// preconditioned conjugate gradient method
+	std::vector<vec> r;
+	r.resize(particles.size());
+	std::vector<vec> z;
+	z.resize(particles.size());
+	std::vector<vec> p;
+	p.resize(particles.size());
+	std::vector<vec> q;
+	q.resize(particles.size());
+
+	multiply(x, q);
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		r[i] = b[i] - q[i];
+		z[i] = preconditioner[i] * r[i];
+		p[i] = z[i];
+	}
+	const Accumulator normB = glm::max(dot(b, b), Accumulator(1E-12));
+	Accumulator rz = dot(r, z);
+	int iterations = 0;
+	while (iterations < viscosityMaxIterations && dot(r, r) > viscosityMaxError * viscosityMaxError * normB)
+	{
+		PROFILE_SCOPE("viscosity iteration");
+		multiply(p, q);
+		const Real alpha = Real(rz / dot(p, q));
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			x[i] += alpha * p[i];
+			r[i] -= alpha * q[i];
+			z[i] = preconditioner[i] * r[i];
+		}
+		const Accumulator rzNew = dot(r, z);
+		const Real beta = Real(rzNew / rz);
+		rz = rzNew;
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			p[i] = z[i] + beta * p[i];
+		}
+		++iterations;
+	}
+	lastViscosityIterations = iterations;
+	io->print_viscosity_iterations(steps, iterations);
+
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		particles[i].velocity = x[i];
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+std::vector<typename Dimension<Dim, Real>::vec> BasicSimulation<Dim, Real, Accumulator>::computePressureAccelerations(const std::vector<std::vector<unsigned>>& neighborVector) const
 {
-	std::vector<glm::vec2> acc;
+	PROFILE_SCOPE("pressure accelerations");
+	std::vector<vec> acc;
 	acc.reserve(particles.size());
 
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isUpdatedThisStep(i))
 		{
-			acc.push_back(glm::vec2(0.f, 0.f));
+			acc.push_back(vec(Real(0)));
 			continue;
 		}
-		glm::vec2 acc_p = glm::vec2(0.f, 0.f);
+		// the boundary mirrors the pressure of the fluid particle, like the boundary particles do
+		vec acc_p = -(particles[i].pressure / (particles[i].density * particles[i].density) + particles[i].pressure / (fluidDensity * fluidDensity))
+						  * getBoundarySample(i).densityGradient;
 
 		// compute pressure acceleration
 		for (auto& j : neighborVector[i])
 		{
-			float factor;
+			Real factor;
 			if (particles[j].boundary)
 			{
 				factor = particles[i].pressure / (particles[i].density * particles[i].density);
@@ -285,9 +1111,8 @@ std::vector<glm::vec2> Simulation::computePressureAccelerations(const std::vecto
 				factor = particles[i].pressure / (particles[i].density * particles[i].density);
 				factor += particles[j].pressure / (particles[j].density * particles[j].density);
 			}
-			acc_p -= factor * kernelGradient(particles[i].position, particles[j].position);
+			acc_p -= particles[j].mass * factor * kernelGradient(particles[i].position, particles[j].position, getSmoothingLength(i, j));
 		}
-		acc_p *= particleMass;
 		acc.push_back(acc_p);
 	}
 	return acc;
@@ -295,82 +1120,112 @@ std::vector<glm::vec2> Simulation::computePressureAccelerations(const std::vecto
 
 
 
-float Simulation::kernelFunction(glm::vec2 xi, glm::vec2 xj) const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::kernelFunction(vec xi, vec xj) const
+{
+	return kernelFunction(xi, xj, particleSize);
+}
+
+
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::kernelFunction(Real q) const
 {
-	return kernelFunction(glm::distance(xi, xj) / particleSize);
+	return kernelFunction(q, particleSize);
 }
 
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::kernelFunction(vec xi, vec xj, Real smoothingLength) const
+{
+	return kernelFunction(glm::length(getDifference(xi, xj)) / smoothingLength, smoothingLength);
+}
 
-float Simulation::kernelFunction(float q) const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::kernelFunction(Real q, Real smoothingLength) const
 {
-	float t1 = glm::max(1 - q, 0.f);
-	float t2 = glm::max(2 - q, 0.f);
-	float sigma = 5.f / (14.f * PI_F * particleSize * particleSize);
+	Real t1 = glm::max(1 - q, Real(0));
+	Real t2 = glm::max(2 - q, Real(0));
+	Real sigma = Dimension<Dim, Real>::kernelNormalization(smoothingLength);
 	return sigma * (t2 * t2 * t2 - 4 * t1 * t1 * t1);
 }
 
-glm::vec2 Simulation::kernelGradient(glm::vec2 xi, glm::vec2 xj) const
+template <int Dim, typename Real, typename Accumulator>
+typename Dimension<Dim, Real>::vec BasicSimulation<Dim, Real, Accumulator>::kernelGradient(vec xi, vec xj) const
+{
+	return kernelGradient(xi, xj, particleSize);
+}
+
+template <int Dim, typename Real, typename Accumulator>
+typename Dimension<Dim, Real>::vec BasicSimulation<Dim, Real, Accumulator>::kernelGradient(vec xi, vec xj, Real smoothingLength) const
 {
-	float q = glm::distance(xi, xj) / particleSize;
+	const vec x_ij = getDifference(xi, xj);
+	Real q = glm::length(x_ij) / smoothingLength;
 	if (q == 0)
 	{
-		return glm::vec2(0.f, 0.f);
+		return vec(Real(0));
 	}
 	
-	float t1 = glm::max(1 - q, 0.f);
-	float t2 = glm::max(2 - q, 0.f);
-	float sigma = 5.f / (14.f * PI_F * particleSize * particleSize);
-	return sigma * (xi - xj) / (q * particleSize * particleSize) * (-3 * t2 * t2 + 12 * t1 * t1);
+	Real t1 = glm::max(1 - q, Real(0));
+	Real t2 = glm::max(2 - q, Real(0));
+	Real sigma = Dimension<Dim, Real>::kernelNormalization(smoothingLength);
+	return sigma * x_ij / (q * smoothingLength * smoothingLength) * (-3 * t2 * t2 + 12 * t1 * t1);
 }
 
-void Simulation::updateVelocity(std::vector<glm::vec2>& acc, float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::updateVelocity(std::vector<vec>& acc, Real timeDifference)
 {
+	PROFILE_SCOPE("integration");
 	// update the velocity of all particles not belonging to the boundary
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isUpdatedThisStep(i))
 		{
 			continue;
 		}
 
-		particles[i].velocity += timeDifference * acc[i];
+		particles[i].velocity += getParticleTimeStep(i, timeDifference) * acc[i];
 	}
 }
 
-void Simulation::updatePosition(float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::updatePosition(Real timeDifference)
 {
+	PROFILE_SCOPE("integration");
 	// update the position of all particles not belonging to the boundary
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isUpdatedThisStep(i))
 		{
 			continue;
 		}
 
-		particles[i].position += timeDifference * particles[i].velocity;
+		particles[i].position += getParticleTimeStep(i, timeDifference) * particles[i].velocity;
 	}
 }
 
 
-void Simulation::updateColor(float timeDifference)
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::updateColor(Real timeDifference)
 {
+	PROFILE_SCOPE("color");
+	const Real PI_F = glm::pi<Real>();
+
 	#pragma loop(hint_parallel(0))
 	for (unsigned int i = 0; i < particles.size(); ++i)
 	{
-		if (particles[i].boundary)
+		if (!isActive(i))
 		{
 			continue;
 		}
 
 		// change color according to the speed of the particle
-		float speed = glm::length(particles[i].velocity);
-		const float maxSpeed = this->particleSize / timeDifference;
+		Real speed = glm::length(particles[i].velocity);
+		const Real maxSpeed = this->particleSize / timeDifference;
 		float red, green, blue;
 		if (speed < maxSpeed / 2)
 		{
-			red = 0.f;
+			red = Real(0);
 			green = glm::sin(PI_F / maxSpeed * speed) * glm::sin(PI_F / maxSpeed * speed);
 			blue = glm::cos(PI_F / maxSpeed * speed) * glm::cos(PI_F / maxSpeed * speed);
 			particles[i].color = glm::vec3(red, green, blue);
@@ -379,7 +1234,7 @@ void Simulation::updateColor(float timeDifference)
 		{
 			red = glm::cos(PI_F / maxSpeed * speed) * glm::cos(PI_F / maxSpeed * speed);
 			green = glm::sin(PI_F / maxSpeed * speed) * glm::sin(PI_F / maxSpeed * speed);
-			blue = 0.f;
+			blue = Real(0);
 			particles[i].color = glm::vec3(red, green, blue);
 		}
 		else
@@ -391,42 +1246,421 @@ void Simulation::updateColor(float timeDifference)
 
 
 
-float Simulation::getFluidDensity() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getFluidDensity() const
 {
 	return fluidDensity;
 }
 
-float Simulation::getKernelSupport() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getKernelSupport() const
 {
 	return kernelSupport;
 }
 
-float Simulation::getParticleMass() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getParticleMass() const
 {
 	return particleMass;
 }
 
-float Simulation::getParticleSize() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getParticleSize() const
 {
 	return particleSize;
 }
 
-float Simulation::getViscosity() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getViscosity() const
 {
 	return viscosity;
 }
 
-float Simulation::getGravity() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getGravity() const
 {
 	return gravity;
 }
 
-int Simulation::getWidth() const
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setAdaptiveTimeStep(Real minTimeStep, Real maxTimeStep, Real cflNumber)
+{
+	this->adaptiveTimeStep = true;
+	this->minTimeStep = minTimeStep;
+	this->maxTimeStep = glm::max(minTimeStep, maxTimeStep);
+	this->cflNumber = cflNumber;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getLastTimeStep() const
+{
+	return lastTimeStep;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getSteps() const
+{
+	return steps;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getLastSolverIterations() const
+{
+	return lastSolverIterations;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getLastViscosityIterations() const
+{
+	return viscosityMethod == ViscosityComputationMethod::implicitIntegration ? lastViscosityIterations : 0;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getMaxSpeed() const
+{
+	Real maxSpeed = 0;
+	for (const Particle& particle : particles)
+	{
+		if (particle.boundary)
+		{
+			continue;
+		}
+		maxSpeed = glm::max(maxSpeed, glm::length(particle.velocity));
+	}
+	return maxSpeed;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setSleeping(Real velocityThreshold, Real densityErrorThreshold, int steps)
+{
+	sleepingEnabled = true;
+	sleepVelocity = velocityThreshold;
+	sleepDensityError = densityErrorThreshold;
+	sleepSteps = steps;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getAwakeParticles() const
+{
+	int awakeParticles = 0;
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (isActive(i))
+		{
+			++awakeParticles;
+		}
+	}
+	return awakeParticles;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setMultirate(int levels)
+{
+	multirateLevels = glm::max(levels, 0);
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setAdaptiveResolution(Real mergeDistance, Real splitDistance, Real vorticityThreshold)
+{
+	this->adaptiveResolution = true;
+	this->mergeDistance = mergeDistance;
+	this->splitDistance = glm::min(splitDistance, mergeDistance);
+	this->vorticityThreshold = vorticityThreshold;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getMergedParticles() const
+{
+	int mergedParticles = 0;
+	for (const Particle& particle : particles)
+	{
+		if (!particle.boundary && particle.size > particleSize)
+		{
+			++mergedParticles;
+		}
+	}
+	return mergedParticles;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::createBoundaryDensityMap(Real spacing)
+{
+	boundaryMap = BoundaryDensityMap(spacing, domainSize);
+	Grid grid(kernelSupport, domainSize);
+	grid.initializeGrid(particles);
+
+	// sum up the contribution of all boundary particles within the kernel support of each node
+	#pragma loop(hint_parallel(0))
+	for (unsigned int node = 0; node < boundaryMap.getNodeCount(); ++node)
+	{
+		const vec position = boundaryMap.getNodePosition(node);
+		BoundarySample sample;
+		for (auto& j : getPossibleNeighbors(position, kernelSupport, grid))
+		{
+			if (!particles[j].boundary || glm::length(getDifference(position, particles[j].position)) >= kernelSupport)
+			{
+				continue;
+			}
+			const vec gradient = particles[j].mass * kernelGradient(position, particles[j].position);
+			sample.density += particles[j].mass * kernelFunction(position, particles[j].position);
+			sample.densityGradient += gradient;
+			sample.gradientSquared += glm::dot(gradient, gradient);
+		}
+		boundaryMap.setNode(node, sample);
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::addBoundaryShape(std::unique_ptr<BoundaryShape> shape)
+{
+	if (boundaryProfile.empty())
+	{
+		computeBoundaryProfile();
+	}
+	boundaryShapes.push_back(std::move(shape));
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::computeBoundaryProfile()
+{
+	// the floor is filled with layers of boundary particles below y = 0, the first layer is half a particle size below the surface.
+	// The fluid particle is moved along the other axes to average over its position relative to the boundary particles.
+	const int layers = int(glm::ceil(2 * kernelSupport / particleSize)) + 1;
+	const int offsets = 8;
+	ivec firstOffset = ivec(0);
+	ivec lastOffset = ivec(offsets - 1);
+	lastOffset[1] = 0;
+	ivec firstParticle = ivec(-layers);
+	ivec lastParticle = ivec(layers);
+	firstParticle[1] = 0;
+	lastParticle[1] = layers - 1;
+	const int samples = int(std::pow(offsets, Dim - 1));
+	const int entries = 2 * profileResolution * int(glm::ceil(kernelSupport / particleSize)) + 1;
+	const Real spacing = 2 * kernelSupport / Real(entries - 1);
+	boundaryProfile.resize(entries);
+	for (int n = 0; n < entries; ++n)
+	{
+		BoundarySample sample;
+		const Real distance = -kernelSupport + Real(n) * spacing;
+		forEachCell<Dim>(firstOffset, lastOffset, [&](const ivec& offset)
+		{
+			vec position = vec(offset) / Real(offsets) * particleSize;
+			position[1] = distance;
+			forEachCell<Dim>(firstParticle, lastParticle, [&](const ivec& lattice)
+			{
+				vec boundaryPosition = particleSize * vec(lattice);
+				boundaryPosition[1] = particleSize * (-Real(0.5) - Real(lattice[1]));
+				const vec gradient = particleMass * kernelGradient(position, boundaryPosition);
+				sample.density += particleMass * kernelFunction(position, boundaryPosition);
+				sample.densityGradient += gradient;
+				sample.gradientSquared += glm::dot(gradient, gradient);
+			});
+		});
+		sample.density /= Real(samples);
+		sample.densityGradient /= Real(samples);
+		sample.gradientSquared /= Real(samples);
+		boundaryProfile[n] = sample;
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+typename BasicSimulation<Dim, Real, Accumulator>::BoundarySample BasicSimulation<Dim, Real, Accumulator>::sampleBoundary(vec position) const
+{
+	BoundarySample sample = boundaryMap.sample(position);
+	if (boundaryShapes.empty())
+	{
+		return sample;
+	}
+
+	// Overlapping shapes, e.g. walls meeting at a corner, would count the boundary in the overlap twice. The fractions f of the
+	// full boundary density are combined like independent probabilities, 1 - (1 - f_1)(1 - f_2), which is exact for a kernel
+	// that is separable along the axes and close to it for the cubic spline. Three walls meet at the corners of a 3D container,
+	// where adding up the contributions overestimates the density by several percent.
+	const Real fullDensity = boundaryProfile.front().density;
+	const Real spacing = 2 * kernelSupport / Real(boundaryProfile.size() - 1);
+	for (auto& shape : boundaryShapes)
+	{
+		const Real distance = shape->signedDistance(position);
+		if (distance >= kernelSupport)
+		{
+			continue;
+		}
+		// interpolate the profile linearly, deeper inside the shape the deepest entry is used
+		const Real t = glm::max(distance + kernelSupport, Real(0)) / spacing;
+		const int n = glm::min(int(t), int(boundaryProfile.size()) - 2);
+		const Real weight = glm::min(t - Real(n), Real(1));
+		const BoundarySample& lower = boundaryProfile[n];
+		const BoundarySample& upper = boundaryProfile[n + 1];
+
+		// the profile belongs to a floor, so the y component of its gradient is the derivative along the normal
+		const Real density = glm::mix(lower.density, upper.density, weight);
+		const vec densityGradient = glm::mix(lower.densityGradient[1], upper.densityGradient[1], weight) * shape->distanceGradient(position);
+		const Real gradientSquared = glm::mix(lower.gradientSquared, upper.gradientSquared, weight);
+
+		const Real uncovered = 1 - density / fullDensity;
+		const Real sampleUncovered = 1 - sample.density / fullDensity;
+		sample.density += density * sampleUncovered;
+		sample.densityGradient = sample.densityGradient * uncovered + densityGradient * sampleUncovered;
+		sample.gradientSquared = sample.gradientSquared * uncovered + gradientSquared * sampleUncovered;
+	}
+	return sample;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::sampleBoundaries()
+{
+	PROFILE_SCOPE("boundary samples");
+	boundarySamples.resize(particles.size());
+	boundarySamplePositions.resize(particles.size());
+	#pragma loop(hint_parallel(0))
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!isUpdatedThisStep(i))
+		{
+			continue;
+		}
+		boundarySamples[i] = sampleBoundary(particles[i].position);
+		boundarySamplePositions[i] = particles[i].position;
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+typename BasicSimulation<Dim, Real, Accumulator>::BoundarySample BasicSimulation<Dim, Real, Accumulator>::getBoundarySample(unsigned int i, vec position) const
+{
+	BoundarySample sample = boundarySamples[i];
+	sample.density += glm::dot(sample.densityGradient, getDifference(position, boundarySamplePositions[i]));
+	return sample;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setPeriodic(int axis, bool periodic)
+{
+	this->periodic[axis] = periodic;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setGravityDirection(vec direction)
+{
+	gravityDirection = glm::normalize(direction);
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::wrapPositions()
+{
+	if (std::find(periodic.begin(), periodic.end(), true) == periodic.end())
+	{
+		return;
+	}
+	#pragma loop(hint_parallel(0))
+	for (auto& particle : particles)
+	{
+		for (int axis = 0; axis < Dim; ++axis)
+		{
+			if (!periodic[axis])
+			{
+				continue;
+			}
+			// rounding can leave a tiny negative coordinate at the upper end, which belongs to the first cell
+			const Real size = Real(domainSize[axis]);
+			particle.position[axis] -= size * glm::floor(particle.position[axis] / size);
+			particle.position[axis] = particle.position[axis] >= size ? Real(0) : particle.position[axis];
+		}
+	}
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::setViscosityMethod(ViscosityComputationMethod method, Real maxError, int maxIterations)
+{
+	viscosityMethod = method;
+	viscosityMaxError = maxError;
+	viscosityMaxIterations = maxIterations;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+void BasicSimulation<Dim, Real, Accumulator>::saveState(std::ostream& stream) const
+{
+	// the layout of the particles, a state can only be loaded by the same instantiation
+	const uint32_t layout[4] = { uint32_t(Dim), uint32_t(sizeof(Real)), uint32_t(sizeof(Accumulator)), uint32_t(sizeof(Particle)) };
+	const uint64_t particleCount = particles.size();
+	stream.write(reinterpret_cast<const char*>(layout), sizeof(layout));
+	stream.write(reinterpret_cast<const char*>(&particleCount), sizeof(particleCount));
+	stream.write(reinterpret_cast<const char*>(particles.data()), std::streamsize(particles.size() * sizeof(Particle)));
+	stream.write(reinterpret_cast<const char*>(&nextParticleId), sizeof(nextParticleId));
+	stream.write(reinterpret_cast<const char*>(&lastTimeStep), sizeof(lastTimeStep));
+	stream.write(reinterpret_cast<const char*>(&lastSolverIterations), sizeof(lastSolverIterations));
+	stream.write(reinterpret_cast<const char*>(&multirateStep), sizeof(multirateStep));
+	stream.write(reinterpret_cast<const char*>(&resolutionSteps), sizeof(resolutionSteps));
+	stream.write(reinterpret_cast<const char*>(&steps), sizeof(steps));
+}
+
+template <int Dim, typename Real, typename Accumulator>
+bool BasicSimulation<Dim, Real, Accumulator>::loadState(std::istream& stream)
+{
+	uint32_t layout[4];
+	uint64_t particleCount = 0;
+	stream.read(reinterpret_cast<char*>(layout), sizeof(layout));
+	stream.read(reinterpret_cast<char*>(&particleCount), sizeof(particleCount));
+	if (!stream || layout[0] != Dim || layout[1] != sizeof(Real) || layout[2] != sizeof(Accumulator) || layout[3] != sizeof(Particle))
+	{
+		std::cout << "the state belongs to another kind of simulation" << std::endl;
+		return false;
+	}
+
+	std::vector<Particle> loadedParticles(particleCount);
+	stream.read(reinterpret_cast<char*>(loadedParticles.data()), std::streamsize(particleCount * sizeof(Particle)));
+	stream.read(reinterpret_cast<char*>(&nextParticleId), sizeof(nextParticleId));
+	stream.read(reinterpret_cast<char*>(&lastTimeStep), sizeof(lastTimeStep));
+	stream.read(reinterpret_cast<char*>(&lastSolverIterations), sizeof(lastSolverIterations));
+	stream.read(reinterpret_cast<char*>(&multirateStep), sizeof(multirateStep));
+	stream.read(reinterpret_cast<char*>(&resolutionSteps), sizeof(resolutionSteps));
+	stream.read(reinterpret_cast<char*>(&steps), sizeof(steps));
+	if (!stream)
+	{
+		std::cout << "the state ends early" << std::endl;
+		return false;
+	}
+	particles = std::move(loadedParticles);
+	return true;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+ViscosityComputationMethod BasicSimulation<Dim, Real, Accumulator>::getViscosityMethod() const
+{
+	return viscosityMethod;
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getWidth() const
+{
+	return domainSize[0];
+}
+
+template <int Dim, typename Real, typename Accumulator>
+int BasicSimulation<Dim, Real, Accumulator>::getHeight() const
+{
+	return domainSize[1];
+}
+
+template <int Dim, typename Real, typename Accumulator>
+typename Dimension<Dim, Real>::ivec BasicSimulation<Dim, Real, Accumulator>::getDomainSize() const
 {
-	return width;
+	return domainSize;
 }
 
-int Simulation::getHeight() const
+template <int Dim, typename Real, typename Accumulator>
+Real BasicSimulation<Dim, Real, Accumulator>::getBoundaryDistance(vec position) const
 {
-	return height;
+	Real distance = std::numeric_limits<Real>::max();
+	for (auto& shape : boundaryShapes)
+	{
+		distance = glm::min(distance, shape->signedDistance(position));
+	}
+	return distance;
 }
+
+template class BasicSimulation<2, float, float>;
+template class BasicSimulation<2, double, double>;
+template class BasicSimulation<2, float, double>;
+template class BasicSimulation<3, float, float>;
+template class BasicSimulation<3, double, double>;
+template class BasicSimulation<3, float, double>;
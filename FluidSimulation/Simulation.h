@@ -1,16 +1,38 @@
 #pragma once
 #include <vector>
+#include <memory>
+#include <array>
+#include <iosfwd>
 #include <glm/glm.hpp>
 
 #include "IO.h"
+#include "Dimension.h"
 #include "Particle.h"
 #include "ParticleUniformGrid.h"
-
-class Simulation
+#include "BoundaryDensityMap.h"
+#include "BoundaryShape.h"
+
+/**
+ *	SPH simulation of a fluid in Dim dimensions, the base of all pressure solvers
+ *	@tparam Real scalar type of the particle data, positions and velocities
+ *	@tparam Accumulator scalar type of the density sums, the solver residuals and the other reductions,
+ *	        double with float particle data keeps the storage small while the sums over many particles stay accurate
+ */
+template <int Dim, typename Real = float, typename Accumulator = Real>
+class BasicSimulation
 {
 public:
+	using vec = typename Dimension<Dim, Real>::vec;
+	using ivec = typename Dimension<Dim, Real>::ivec;
+	using Particle = BasicParticle<Dim, Real>;
+	using Grid = BasicParticleUniformGrid<Dim, Real>;
+	using BoundarySample = BasicBoundarySample<Dim, Real>;
+	using BoundaryDensityMap = BasicBoundaryDensityMap<Dim, Real>;
+	using BoundaryShape = BasicBoundaryShape<Dim, Real>;
+
 	/**
 	 *	Create new simulation
+	 *	@param size the size of the simulation space along each axis
 	 *	@param particleSize the size of a particle
 	 *	@param kernelSupport kernel support size, default value: 2 * particleSize
 	 *	@param fluidDensity fluid density, default value: 1
@@ -18,9 +40,9 @@ public:
 	 *	@param stiffness stiffness of the fluid, default value: 2000
 	 *	@param gravity gravitational constant
 	 */
-	Simulation(int width, int height, float particleSize, float fluidDensity, float viscosity, float gravity, IO* io);
+	BasicSimulation(ivec size, Real particleSize, Real fluidDensity, Real viscosity, Real gravity, IO* io);
 
-	virtual ~Simulation();
+	virtual ~BasicSimulation();
 
 	/**
 		Add a new particle to the simulation
@@ -28,7 +50,7 @@ public:
 		@param color color of the new particle
 		@param boundary true if particle belongs to the boundary
 	*/
-	void addParticle(glm::vec2 position, glm::vec3 color, bool boundary);
+	void addParticle(vec position, glm::vec3 color, bool boundary);
 
 	/**
 	 *	Add a new particle to the simulation
@@ -41,19 +63,68 @@ public:
 	 *	Get the positions of all particles in the simulation
 	 *	@return a vector containing the positions of the particles
 	 */
-	std::vector<glm::vec2>* getParticlePositions() const;
+	std::vector<vec>* getParticlePositions() const;
 
 	/**
 	 *	Get all particles in the simulation
 	 *	@return a vector containing all particles in the simulation
 	 */
 	const std::vector<Particle>& getParticles() const;
+
+	/**
+	 *	Write the state which changes while the simulation runs: the particles, whose pressures are the initial guess
+	 *	of the solvers, and the counters of the time stepping. The parameters are not written, a simulation is restored
+	 *	by creating it with the same parameters and scenario and loading the state afterwards.
+	 *	@param stream binary stream the state is appended to
+	 */
+	virtual void saveState(std::ostream& stream) const;
+
+	/**
+	 *	Replace the state by a state written with saveState
+	 *	@param stream binary stream positioned at the state
+	 *	@return false if the stream ends early or the state belongs to a simulation with other dimensions or scalar types
+	 */
+	virtual bool loadState(std::istream& stream);
 	
 	/**
-	 *	Do a simulation step, compute accelerations and change velocity and position of the particles
+	 *	Do a simulation step, compute accelerations and change velocity and position of the particles.
+	 *	With an adaptive time step the step is divided into substeps whose size is chosen by the CFL condition.
 	 *	@param timeDifference the time which has passed since the last simulation step
 	 */
-	void performSimulationStep(float timeDifference);
+	void performSimulationStep(Real timeDifference);
+
+	/**
+	 *	Choose the time step of each substep adaptively, must not be combined with individual time stepping (setMultirate)
+	 *	@param minTimeStep smallest allowed time step
+	 *	@param maxTimeStep largest allowed time step
+	 *	@param cflNumber fraction of a particle size which the fastest particle may travel in one time step
+	 */
+	void setAdaptiveTimeStep(Real minTimeStep, Real maxTimeStep, Real cflNumber = Real(0.4));
+
+	/**
+	 *	@return the size of the last accepted (sub)step
+	 */
+	Real getLastTimeStep() const;
+
+	/**
+	 *	@return the number of simulation steps performed so far, which numbers the rows of the measured values
+	 */
+	int getSteps() const;
+
+	/**
+	 *	@return the iterations of the last pressure solve, 0 if the pressure is not computed iteratively
+	 */
+	int getLastSolverIterations() const;
+
+	/**
+	 *	@return the conjugate gradient iterations of the last implicit viscosity solve, 0 with explicit viscosity
+	 */
+	int getLastViscosityIterations() const;
+
+	/**
+	 *	@return the speed of the fastest particle
+	 */
+	Real getMaxSpeed() const;
 
 	/**
 	 *	kernel function used by the simulation
@@ -61,14 +132,27 @@ public:
 	 *	@param xj the position of the second particle, typically the position of a neighboring particle of the first particle
 	 *	@return value of the kernel function taking the distance between the two particles divided by the particle size as input
 	 */
-	float kernelFunction(glm::vec2 xi, glm::vec2 xj) const;
+	Real kernelFunction(vec xi, vec xj) const;
 
 	/**
 	 *	kernel function used by the simulation
 	 *	@param q the distance between two particles, divided by the particle size
 	 *	@return value of the kernel function
 	 */
-	float kernelFunction(float q) const;
+	Real kernelFunction(Real q) const;
+
+	/**
+	 *	kernel function with a smoothing length other than the particle size
+	 *	@param smoothingLength the smoothing length h, the kernel support is 2 * h
+	 */
+	Real kernelFunction(vec xi, vec xj, Real smoothingLength) const;
+
+	/**
+	 *	kernel function with a smoothing length other than the particle size
+	 *	@param q the distance between two particles, divided by the smoothing length
+	 *	@param smoothingLength the smoothing length h, the kernel support is 2 * h
+	 */
+	Real kernelFunction(Real q, Real smoothingLength) const;
 
 	/**
 	 *	kernel gradient used by the simulation
@@ -76,64 +160,424 @@ public:
 	 *	@param xj the position of the second particle, typically the position of a neighboring particle of the first particle
 	 *	@return gradient of the kernel function taking the distance between the two particles divided by the particle size as input
 	 */
-	glm::vec2 kernelGradient(glm::vec2 xi, glm::vec2 xj) const;
+	vec kernelGradient(vec xi, vec xj) const;
 
 	/**
-	 *	Get all neighbor particles of a certain particle in the simulation
+	 *	kernel gradient with a smoothing length other than the particle size
+	 *	@param smoothingLength the smoothing length h, the kernel support is 2 * h
+	 */
+	vec kernelGradient(vec xi, vec xj, Real smoothingLength) const;
+
+	/**
+	 *	Get all neighbor particles of a certain particle in a grid, i.e. the particles closer than the kernel support of the pair
 	 *	@param particleIndex index of the particle whose neighbors we are looking for
+	 *	@param grid uniform grid where the particles are stored, its cells are at least as large as the kernel support of each pair
+	 *	@return a vector containing all indices of neighboring particles of the given particle in the grid
+	 */
+	std::vector<unsigned int> getNeighbors(unsigned int particleIndex, const Grid& grid) const;
+
+	/**
+	 *	Get all particles in the grid cells which are closer to a position than a radius
+	 *	@param position the center of the search
+	 *	@param radius the search radius, a multiple of the cell width searches more cells
 	 *	@param grid uniform grid where the particles are stored
-	 *	@return a vector containing all indices of neighboring particles of the given particle in the simulation
+	 *	@return a vector containing the indices of all particles which could be closer than the radius
 	 */
-	std::vector<unsigned int> getNeighbors(unsigned int particleIndex, const ParticleUniformGrid& grid) const;
+	std::vector<unsigned int> getPossibleNeighbors(vec position, Real radius, const Grid& grid) const;
 	
-	float getParticleSize() const;
+	Real getParticleSize() const;
+
+	Real getKernelSupport() const;
+
+	Real getFluidDensity() const;
+
+	Real getParticleMass() const;
+
+	Real getViscosity() const;
+
+	Real getGravity() const;
 
-	float getKernelSupport() const;
+	/**
+	 *	Choose how viscosity is integrated
+	 *	@param method explicit integration or implicit integration with a conjugate gradient solver
+	 *	@param maxError maximum relative residual of the implicit viscosity solve
+	 *	@param maxIterations maximum number of conjugate gradient iterations of the implicit viscosity solve
+	 */
+	void setViscosityMethod(ViscosityComputationMethod method, Real maxError = Real(1E-4), int maxIterations = 100);
+
+	ViscosityComputationMethod getViscosityMethod() const;
+
+	/**
+	 *	Freeze fluid particles which have been calm for some steps, they are skipped by the integration and the solvers
+	 *	but stay neighbors of other particles. A sleeping particle wakes up when one of its neighbors moves faster
+	 *	than twice the velocity threshold. Only the compressible solver supports sleeping particles, their frozen density
+	 *	gives their pressure. The iterative solvers would read the stale pressures of sleeping neighbors in their sums.
+	 *	@param velocityThreshold maximum speed of a calm particle
+	 *	@param densityErrorThreshold maximum relative compression of a calm particle
+	 *	@param steps number of calm steps after which a particle falls asleep
+	 */
+	void setSleeping(Real velocityThreshold, Real densityErrorThreshold, int steps);
+
+	/**
+	 *	@return the number of fluid particles which are not sleeping
+	 */
+	int getAwakeParticles() const;
+
+	/**
+	 *	Integrate slow particles with larger time steps (individual time stepping). A particle on time level l
+	 *	is only updated every 2^l steps, with 2^l times the time step. The level is chosen by the local CFL condition,
+	 *	changes only when the particle is synchronized with the global time and the new level, and is at most one above the level of its neighbors.
+	 *	The pressure is applied like a force, so this is meant for pressures from a state equation (CompressibleSimulation).
+	 *	The time step of the highest level has to stay below the stability limit of the stiffness.
+	 *	The levels need a constant base time step, so they must not be combined with an adaptive time step (validateRunParameters rejects it).
+	 *	@param levels number of time levels above the base time step, 0 disables individual time stepping
+	 */
+	void setMultirate(int levels);
 
-	float getFluidDensity() const;
+	/**
+	 *	Merge groups of 2^Dim fluid particles (2x2 in 2D) deep inside the fluid into one particle with twice the size,
+	 *	and split them again when they come close to the surface, a boundary or a vortex. Mass and momentum are conserved.
+	 *	Merged particles are merged again further inside, a particle on level l has 2^l times the particle size and is
+	 *	merged from particles deeper than (2^l - 1) * mergeDistance, so each level fills a band twice as wide as the level above.
+	 *	The smoothing length of a particle is its size, pairs use the mean smoothing length of both.
+	 *	Like individual time stepping, this is meant for pressures from a state equation (CompressibleSimulation).
+	 *	@param mergeDistance minimum distance to the surface of a particle which is merged
+	 *	@param splitDistance a merged particle closer to the surface than this is split, smaller than mergeDistance,
+	 *		scaled like mergeDistance for the higher levels
+	 *	@param vorticityThreshold a merged particle with a larger vorticity is split, half of it prevents merging
+	 */
+	void setAdaptiveResolution(Real mergeDistance, Real splitDistance, Real vorticityThreshold);
 
-	float getParticleMass() const;
+	/**
+	 *	@return the number of fluid particles which are larger than the particle size
+	 */
+	int getMergedParticles() const;
 
-	float getViscosity() const;
+	/**
+	 *	Replace the boundary particles in the density and pressure computation by a map of their precomputed contribution.
+	 *	The boundary particles are left out of the neighbor search afterwards, they are only kept for drawing.
+	 *	The map has no friction, so the walls are free-slip. Call this after all boundary particles are added.
+	 *	@param spacing distance between two nodes of the map, a fraction of the particle size
+	 */
+	void createBoundaryDensityMap(Real spacing);
 
-	float getGravity() const;
+	/**
+	 *	Add a solid boundary given by its signed distance, it replaces boundary particles without being a particle itself.
+	 *	Near the surface each shape acts like a plane filled with boundary particles, whose contribution is looked up
+	 *	by the signed distance. Overlapping shapes, e.g. at corners, are combined so that the overlap is counted once.
+	 *	Like the density map, shapes have no friction.
+	 *	@param shape the shape of the boundary, the simulation takes ownership
+	 */
+	void addBoundaryShape(std::unique_ptr<BoundaryShape> shape);
+
+	/**
+	 *	Make the simulation space periodic along an axis. Particles leaving the space on one side enter it
+	 *	on the other side, and particles near opposite sides are neighbors (minimum image convention).
+	 *	The size of the space along a periodic axis should be a multiple of the particle size, so that regularly placed
+	 *	particles stay regular across the periodic boundary.
+	 *	@param axis the axis, 0 for x, 1 for y and 2 for z
+	 *	@param periodic true if the axis is periodic
+	 */
+	void setPeriodic(int axis, bool periodic = true);
+
+	/**
+	 *	Choose the direction of the gravity, e.g. to drive the flow along a periodic channel like on a slope
+	 *	@param direction direction of the gravity, default value: negative y-axis
+	 */
+	void setGravityDirection(vec direction);
 
 	int getWidth() const;
 
 	int getHeight() const;
 
+	/**
+	 *	@return the size of the simulation space along each axis
+	 */
+	ivec getDomainSize() const;
+
+	/**
+	 *	@param position a position in the simulation space
+	 *	@return the signed distance of the position to the nearest boundary shape, the largest value of Real without shapes
+	 */
+	Real getBoundaryDistance(vec position) const;
+
 protected:
 	// all particles in the simulation
 	std::vector<Particle> particles;
 
+	// id of the next particle which is added, merged or split
+	unsigned int nextParticleId = 0;
+
 	// the particle size
-	float particleSize;
+	Real particleSize;
 
 	// the kernel support
-	float kernelSupport;
+	Real kernelSupport;
 
 	// the density of the fluid
-	float fluidDensity;
+	Real fluidDensity;
 
 	// mass of a particle
-	float particleMass;
+	Real particleMass;
 
 	// viscosity of the fluid
-	float viscosity;
+	Real viscosity;
 
 	// gravitational constant
-	float gravity;
+	Real gravity;
+
+	// normalized direction of the gravity
+	vec gravityDirection;
+
+	// true for each axis along which the simulation space is periodic
+	std::array<bool, Dim> periodic{};
+
+	// integration of the viscosity
+	ViscosityComputationMethod viscosityMethod = ViscosityComputationMethod::explicitIntegration;
+
+	// maximum relative residual of the implicit viscosity solve
+	Real viscosityMaxError = Real(1E-4);
+
+	// maximum number of iterations of the implicit viscosity solve
+	int viscosityMaxIterations = 100;
+
+	// true if the time step is chosen adaptively
+	bool adaptiveTimeStep = false;
+
+	// bounds of the adaptive time step
+	Real minTimeStep = 0;
+	Real maxTimeStep = 0;
+
+	// fraction of a particle size which the fastest particle may travel in one adaptive time step
+	Real cflNumber = Real(0.4);
+
+	// size of the last accepted (sub)step
+	Real lastTimeStep = 0;
+
+	// number of simulation steps performed so far
+	int steps = 0;
+
+	// iterations of the last pressure solve, 0 if the pressure is not computed iteratively
+	int lastSolverIterations = 0;
+
+	// iterations of the last implicit viscosity solve
+	int lastViscosityIterations = 0;
+
+	// desired number of pressure solver iterations, more iterations reduce the adaptive time step
+	const int targetSolverIterations = 30;
+
+	// the fields of a particle which a substep changes
+	struct IntegratedState
+	{
+		vec position;
+		vec velocity;
+		Real density;
+		Real pressure;
+		int calmSteps;
+		bool sleeping;
+	};
+
+	// the integrated fields of the particles before the current substep, to roll back a substep which violates the CFL condition
+	std::vector<IntegratedState> rollbackState;
+
+	// true if calm particles fall asleep
+	bool sleepingEnabled = false;
+
+	// maximum speed of a calm particle
+	Real sleepVelocity = 0;
+
+	// maximum relative compression of a calm particle
+	Real sleepDensityError = 0;
+
+	// number of calm steps after which a particle falls asleep
+	int sleepSteps = 0;
+
+	// number of time levels above the base time step, 0 if all particles use the same time step
+	int multirateLevels = 0;
+
+	// number of base time steps done so far, decides which time levels are updated
+	unsigned int multirateStep = 0;
+
+	// number of particle updates in the current simulation step
+	int particleUpdates = 0;
+
+	// true if particles are merged and split
+	bool adaptiveResolution = false;
+
+	// minimum distance to the surface of a merged particle
+	Real mergeDistance = 0;
+
+	// maximum distance to the surface of a particle which is split
+	Real splitDistance = 0;
+
+	// vorticity above which a merged particle is split
+	Real vorticityThreshold = 0;
+
+	// fraction of the difference between the kernel sum and the integrated density which is corrected in each step
+	const Real densityRelaxation = Real(0.02);
+
+	// level of the largest merged particles, which have 2^maxResolutionLevel times the particle size
+	const int maxResolutionLevel = 3;
+
+	// number of simulation steps between two merge and split passes
+	const unsigned int resolutionInterval = 10;
+
+	// number of simulation steps done with adaptive resolution
+	unsigned int resolutionSteps = 0;
+
+	// precomputed contribution of the boundary particles, empty if the boundary particles are neighbors of the fluid particles
+	BoundaryDensityMap boundaryMap;
+
+	// solid boundaries given by their signed distance
+	std::vector<std::unique_ptr<BoundaryShape>> boundaryShapes;
+
+	// contribution of a floor filled with boundary particles, from a signed distance of -kernelSupport to kernelSupport
+	std::vector<BoundarySample> boundaryProfile;
+
+	// number of intervals of the boundary profile per particle size
+	const int profileResolution = 16;
+
+	/**
+	 *	Compute the contribution of a floor filled with boundary particles to a fluid particle at each distance of the profile,
+	 *	averaged over the position of the fluid particle along the floor
+	 */
+	void computeBoundaryProfile();
+
+	/**
+	 *	Get the contribution of the boundary density map and all boundary shapes at a position,
+	 *	boundary particles are not included because they are neighbors of the fluid particles
+	 */
+	BoundarySample sampleBoundary(vec position) const;
+
+	// boundary sample of each updated particle and the position where sampleBoundaries took it
+	std::vector<BoundarySample> boundarySamples;
+	std::vector<vec> boundarySamplePositions;
+
+	/**
+	 *	Sample the boundary once at the position of each updated particle. The densities, the pressure accelerations and
+	 *	the iterations of the pressure solvers read the samples with getBoundarySample instead of sampling the map and
+	 *	the shapes again. Call this whenever the positions change by more than a predicted movement, e.g. after the neighbor search.
+	 */
+	void sampleBoundaries();
+
+	/**
+	 *	@return the boundary sample of a particle at its current position
+	 */
+	BoundarySample getBoundarySample(unsigned int i) const
+	{
+		return getBoundarySample(i, particles[i].position);
+	}
+
+	/**
+	 *	Get the boundary sample of a particle at a position close to the one of sampleBoundaries, e.g. a predicted position.
+	 *	The density is extrapolated linearly with its gradient, the movement within a time step is a fraction of a particle size.
+	 *	@return the boundary sample at the position
+	 */
+	BoundarySample getBoundarySample(unsigned int i, vec position) const;
+
+	/**
+	 *	@return true if the particle is neither a boundary particle nor sleeping, i.e. it moves with the fluid
+	 */
+	bool isActive(unsigned int particleIndex) const
+	{
+		return !particles[particleIndex].boundary && !particles[particleIndex].sleeping;
+	}
+
+	/**
+	 *	@return true if the particle is active and its time level is updated in this step, i.e. it is integrated and solved for.
+	 *	        Without individual time stepping this is the same as isActive.
+	 */
+	bool isUpdatedThisStep(unsigned int particleIndex) const
+	{
+		const unsigned int levelMask = (1u << particles[particleIndex].timeLevel) - 1;
+		return isActive(particleIndex) && (multirateStep & levelMask) == 0;
+	}
+
+	/**
+	 *	@return the time step of the particle, the base time step multiplied by 2^timeLevel
+	 */
+	Real getParticleTimeStep(unsigned int particleIndex, Real timeDifference) const
+	{
+		return timeDifference * Real(1u << particles[particleIndex].timeLevel);
+	}
+
+	/**
+	 *	@return the vector from xj to xi, along a periodic axis the shortest one across the periodic boundary
+	 */
+	vec getDifference(vec xi, vec xj) const
+	{
+		vec difference = xi - xj;
+		for (int axis = 0; axis < Dim; ++axis)
+		{
+			if (periodic[axis])
+			{
+				difference[axis] -= Real(domainSize[axis]) * glm::round(difference[axis] / Real(domainSize[axis]));
+			}
+		}
+		return difference;
+	}
+
+	/**
+	 *	Move particles which left the simulation space along a periodic axis back into it
+	 */
+	void wrapPositions();
+
+	/**
+	 *	@return the smoothing length of the interaction of two particles, the mean of their smoothing lengths.
+	 *		It is symmetric, so both particles of a pair find each other.
+	 */
+	Real getSmoothingLength(unsigned int i, unsigned int j) const
+	{
+		return Real(0.5) * (particles[i].size + particles[j].size);
+	}
+
+	/**
+	 *	@return the level of a particle in the merge hierarchy, its size is 2^level times the particle size
+	 */
+	int getResolutionLevel(unsigned int i) const
+	{
+		return int(glm::round(glm::log2(particles[i].size / particleSize)));
+	}
+
+	/**
+	 *	Merge calm particles deep inside the fluid and split merged particles near the surface
+	 */
+	void adaptResolution();
+
+	/**
+	 *	Switch the particles which are updated in this step to the time level chosen at their last update.
+	 *	A particle on level l has been integrated up to this step, so it may go down to any level,
+	 *	but it may only go up if the step is also a step of the higher level.
+	 */
+	void switchTimeLevels();
+
+	/**
+	 *	Choose the next time level of the updated particles from their local CFL condition and force condition
+	 *	@param acc acceleration which limits the time step of each particle
+	 */
+	void updateTimeLevels(const std::vector<std::vector<unsigned int>>& neighborVector, const std::vector<vec>& acc, Real timeDifference);
+
+	/**
+	 *	Put calm particles to sleep and wake up sleeping neighbors of fast particles
+	 */
+	void updateSleepingParticles(const std::vector<std::vector<unsigned int>>& neighborVector);
 
 	// io
 	IO* io;
 
-	// width of the simulation
-	int width;
+	// size of the simulation space along each axis
+	ivec domainSize;
 
-	// height of the simulation
-	int height;
+	/**
+	 *	Advance the particles by one time step, without updating their colors
+	 *	@param timeDifference size of the time step
+	 */
+	virtual void advance(Real timeDifference);
 
-	const float  PI_F = 3.14159265358979f;
+	/**
+	 *	Choose the size of the next substep from the maximum particle speed, the viscosity and the solver iterations
+	 */
+	Real computeAdaptiveTimeStep() const;
 
 	/**
 	 *	Compute and return a vector that contains vectors of each neighbor of each particle
@@ -145,41 +589,60 @@ protected:
 	 */
 	void computeDensitiesExplicit(const std::vector<std::vector<unsigned int>>& neighborVector);
 
+	/**
+	 *	Compute density of each particle by integrating the continuity equation and relaxing the result towards the kernel sum.
+	 *	At the interface of small and merged particles the kernel sum has errors of a few percent, which would cause strong
+	 *	pressures with a stiff state equation. Relaxing slowly lets the particles rearrange instead.
+	 */
+	void computeDensitiesBlended(const std::vector<std::vector<unsigned int>>& neighborVector, Real timeDifference);
+
 	/**
 	 *	Compute density of each particle using differential
 	 */
-	void computeDensitiesDifferential(const std::vector<std::vector<unsigned int>>& neighborVector, float timeDifference);
+	void computeDensitiesDifferential(const std::vector<std::vector<unsigned int>>& neighborVector, Real timeDifference);
 
 	/**
 	 *	Compute and return pressure of each particle
 	 */
-	virtual void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, float timeDifference);
+	virtual void computePressures(const std::vector<std::vector<unsigned>>& neighborVector, Real timeDifference);
 
 	/**
 	 *	Compute and return non-pressure accelerations
 	 */
-	std::vector<glm::vec2> computeNonPressureAccelerations(const std::vector<std::vector<unsigned int>>& neighborVector) const;
+	std::vector<vec> computeNonPressureAccelerations(const std::vector<std::vector<unsigned int>>& neighborVector) const;
+
+	/**
+	 *	Compute and return viscosity accelerations
+	 */
+	std::vector<vec> computeViscosityAccelerations(const std::vector<std::vector<unsigned int>>& neighborVector) const;
+
+	/**
+	 *	Integrate viscosity implicitly, solve (I - timeDifference * L) v = v* with a matrix-free conjugate gradient method,
+	 *	where L is the viscosity operator over the neighbor graph
+	 */
+	void solveViscosityImplicit(const std::vector<std::vector<unsigned int>>& neighborVector, Real timeDifference);
 
 
 	/**
 	 *	Compute and return pressure acceleration
 	 */
-	std::vector<glm::vec2> computePressureAccelerations(const std::vector<std::vector<unsigned int>>& neighborVector) const;
+	std::vector<vec> computePressureAccelerations(const std::vector<std::vector<unsigned int>>& neighborVector) const;
 
 	
 	/**
 	 *	Update velocity
 	 */
-	void updateVelocity(std::vector<glm::vec2>& acc, float timeDifference);
+	void updateVelocity(std::vector<vec>& acc, Real timeDifference);
 
 	/**
 	 *	Update position
 	 */
-	void updatePosition(float timeDifference);
+	void updatePosition(Real timeDifference);
 
 	/**
 	 *	Update colors of each particle
 	 */
-	void updateColor(float timeDifference);
+	void updateColor(Real timeDifference);
 };
 
+using Simulation = BasicSimulation<2>;
@@ -0,0 +1,406 @@
+#include "Snapshot.h"
+#include "Profiler.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint32_t snapshotVersion = 1;
+	const size_t headerSize = 24;
+	const size_t frameHeaderSize = 16;
+	const size_t footerSize = 16;
+
+	// size of a block padded to a multiple of 8 bytes
+	size_t paddedSize(size_t size)
+	{
+		return (size + 7) / 8 * 8;
+	}
+
+	template <typename T>
+	T readValue(const char* data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& file_name)
+{
+	file.open(file_name, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+	if (!file.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+	}
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	if (!file.is_open() || !headerWritten)
+	{
+		return;
+	}
+	const uint64_t indexOffset = static_cast<uint64_t>(file.tellp());
+	file.write(reinterpret_cast<const char*>(frameOffsets.data()), frameOffsets.size() * sizeof(uint64_t));
+	const uint32_t frames = static_cast<uint32_t>(frameOffsets.size());
+	file.write(reinterpret_cast<const char*>(&indexOffset), sizeof(indexOffset));
+	file.write(reinterpret_cast<const char*>(&frames), sizeof(frames));
+	file.write("FLSI", 4);
+}
+
+void SnapshotWriter::writeBlock(const void* data, size_t size)
+{
+	static const char padding[8] = {};
+	file.write(static_cast<const char*>(data), size);
+	file.write(padding, paddedSize(size) - size);
+}
+
+template <int Dim, typename Real>
+bool SnapshotWriter::writeFrame(const std::vector<BasicParticle<Dim, Real>>& particles, double time)
+{
+	PROFILE_SCOPE("write snapshot");
+	if (!file.is_open())
+	{
+		return false;
+	}
+	if (!headerWritten)
+	{
+		dimensions = Dim;
+		scalarSize = sizeof(Real);
+		const uint64_t reserved = 0;
+		file.write("FLSN", 4);
+		file.write(reinterpret_cast<const char*>(&snapshotVersion), sizeof(snapshotVersion));
+		file.write(reinterpret_cast<const char*>(&dimensions), sizeof(dimensions));
+		file.write(reinterpret_cast<const char*>(&scalarSize), sizeof(scalarSize));
+		file.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+		headerWritten = true;
+	}
+	else if (dimensions != Dim || scalarSize != sizeof(Real))
+	{
+		std::cout << "snapshot frames need the same dimensions and scalar type" << std::endl;
+		return false;
+	}
+
+	uint32_t count = 0;
+	for (auto& particle : particles)
+	{
+		if (!particle.boundary)
+		{
+			++count;
+		}
+	}
+
+	frameOffsets.push_back(static_cast<uint64_t>(file.tellp()));
+	const uint32_t reserved = 0;
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	file.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+	file.write(reinterpret_cast<const char*>(&time), sizeof(time));
+
+	// gather each quantity of the fluid particles into one block, members selects the scalars of a particle
+	auto writeQuantity = [&](size_t valueSize, auto members)
+	{
+		block.resize(size_t(count) * valueSize);
+		char* destination = block.data();
+		for (auto& particle : particles)
+		{
+			if (!particle.boundary)
+			{
+				members(particle, destination);
+				destination += valueSize;
+			}
+		}
+		writeBlock(block.data(), block.size());
+	};
+	writeQuantity(Dim * sizeof(Real), [](const BasicParticle<Dim, Real>& particle, char* destination)
+	{
+		std::memcpy(destination, &particle.position[0], Dim * sizeof(Real));
+	});
+	writeQuantity(Dim * sizeof(Real), [](const BasicParticle<Dim, Real>& particle, char* destination)
+	{
+		std::memcpy(destination, &particle.velocity[0], Dim * sizeof(Real));
+	});
+	writeQuantity(sizeof(Real), [](const BasicParticle<Dim, Real>& particle, char* destination)
+	{
+		std::memcpy(destination, &particle.density, sizeof(Real));
+	});
+	writeQuantity(sizeof(Real), [](const BasicParticle<Dim, Real>& particle, char* destination)
+	{
+		std::memcpy(destination, &particle.pressure, sizeof(Real));
+	});
+	writeQuantity(sizeof(uint32_t), [](const BasicParticle<Dim, Real>& particle, char* destination)
+	{
+		const uint32_t id = particle.id;
+		std::memcpy(destination, &id, sizeof(id));
+	});
+	return file.good();
+}
+
+int SnapshotWriter::getFrames() const
+{
+	return static_cast<int>(frameOffsets.size());
+}
+
+
+SnapshotReader::SnapshotReader(const std::string& file_name)
+{
+#ifdef _WIN32
+	file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		std::cout << "failed to open " << file_name << std::endl;
+		return;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	size = static_cast<size_t>(fileSize.QuadPart);
+	if (size > 0)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+		{
+			data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+	}
+#else
+	const int descriptor = open(file_name.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+		return;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+	{
+		size = static_cast<size_t>(status.st_size);
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		data = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+	}
+	// the mapping stays valid after the file is closed
+	::close(descriptor);
+#endif
+	if (!data)
+	{
+		std::cout << "failed to map " << file_name << std::endl;
+		close();
+		return;
+	}
+
+	// check the header, then read the index given by the footer
+	const bool valid = size >= headerSize && std::memcmp(data, "FLSN", 4) == 0 && readValue<uint32_t>(data + 4) == snapshotVersion;
+	if (valid)
+	{
+		dimensions = readValue<uint32_t>(data + 8);
+		scalarSize = readValue<uint32_t>(data + 12);
+	}
+	if (!valid || (dimensions != 2 && dimensions != 3) || (scalarSize != sizeof(float) && scalarSize != sizeof(double)))
+	{
+		std::cout << file_name << " is not a snapshot file" << std::endl;
+		close();
+		return;
+	}
+	if (size >= headerSize + footerSize && std::memcmp(data + size - 4, "FLSI", 4) == 0)
+	{
+		const uint64_t indexOffset = readValue<uint64_t>(data + size - footerSize);
+		const uint32_t frames = readValue<uint32_t>(data + size - footerSize + 8);
+		if (indexOffset + uint64_t(frames) * sizeof(uint64_t) + footerSize == size)
+		{
+			frameOffsets.resize(frames);
+			std::memcpy(frameOffsets.data(), data + indexOffset, frames * sizeof(uint64_t));
+			return;
+		}
+	}
+
+	// the writer of a killed run didn't write the index, the last frame may be incomplete
+	findFrames();
+	std::cout << file_name << " has no index, " << frameOffsets.size() << " complete frames were found" << std::endl;
+}
+
+void SnapshotReader::findFrames()
+{
+	uint64_t offset = headerSize;
+	while (offset + frameHeaderSize <= size)
+	{
+		const uint32_t particleCount = readValue<uint32_t>(data + offset);
+		const uint64_t frameSize = frameHeaderSize + 2 * paddedSize(size_t(particleCount) * dimensions * scalarSize)
+								   + 2 * paddedSize(size_t(particleCount) * scalarSize) + paddedSize(size_t(particleCount) * sizeof(uint32_t));
+		if (offset + frameSize > size)
+		{
+			break;
+		}
+		frameOffsets.push_back(offset);
+		offset += frameSize;
+	}
+}
+
+SnapshotReader::~SnapshotReader()
+{
+	close();
+}
+
+void SnapshotReader::close()
+{
+#ifdef _WIN32
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	if (file)
+	{
+		CloseHandle(file);
+	}
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data)
+	{
+		munmap(const_cast<char*>(data), size);
+	}
+#endif
+	data = nullptr;
+	size = 0;
+	frameOffsets.clear();
+}
+
+bool SnapshotReader::isOpen() const
+{
+	return data != nullptr;
+}
+
+int SnapshotReader::getFrames() const
+{
+	return static_cast<int>(frameOffsets.size());
+}
+
+int SnapshotReader::getDimensions() const
+{
+	return static_cast<int>(dimensions);
+}
+
+int SnapshotReader::getScalarSize() const
+{
+	return static_cast<int>(scalarSize);
+}
+
+SnapshotFrame SnapshotReader::getFrame(int frame) const
+{
+	SnapshotFrame result;
+	if (frame < 0 || frame >= getFrames())
+	{
+		return result;
+	}
+	const char* position = data + frameOffsets[frame];
+	if (frameOffsets[frame] + frameHeaderSize > size)
+	{
+		return result;
+	}
+	const uint32_t particleCount = readValue<uint32_t>(position);
+	const size_t vectorBlock = paddedSize(size_t(particleCount) * dimensions * scalarSize);
+	const size_t scalarBlock = paddedSize(size_t(particleCount) * scalarSize);
+	const size_t idBlock = paddedSize(size_t(particleCount) * sizeof(uint32_t));
+	if (frameOffsets[frame] + frameHeaderSize + 2 * vectorBlock + 2 * scalarBlock + idBlock > size)
+	{
+		return result;
+	}
+	result.particleCount = particleCount;
+	result.time = readValue<double>(position + 8);
+	position += frameHeaderSize;
+
+	result.positions = position;
+	position += vectorBlock;
+	result.velocities = position;
+	position += vectorBlock;
+	result.densities = position;
+	position += scalarBlock;
+	result.pressures = position;
+	position += scalarBlock;
+	result.ids = reinterpret_cast<const uint32_t*>(position);
+	return result;
+}
+
+
+namespace
+{
+	template <int Dim, typename Real>
+	void dumpParticles(const SnapshotReader& reader, const SnapshotFrame& frame)
+	{
+		const glm::vec<Dim, Real>* positions = reader.getPositions<Dim, Real>(frame);
+		const glm::vec<Dim, Real>* velocities = reader.getVelocities<Dim, Real>(frame);
+		const Real* densities = reader.getDensities<Real>(frame);
+		const Real* pressures = reader.getPressures<Real>(frame);
+		std::cout << "id" << "\t" << "position" << "\t" << "velocity" << "\t" << "density" << "\t" << "pressure" << std::endl;
+		for (uint32_t i = 0; i < frame.particleCount; ++i)
+		{
+			std::cout << frame.ids[i] << "\t";
+			for (int axis = 0; axis < Dim; ++axis)
+			{
+				std::cout << (axis > 0 ? " " : "") << positions[i][axis];
+			}
+			std::cout << "\t";
+			for (int axis = 0; axis < Dim; ++axis)
+			{
+				std::cout << (axis > 0 ? " " : "") << velocities[i][axis];
+			}
+			std::cout << "\t" << densities[i] << "\t" << pressures[i] << std::endl;
+		}
+	}
+}
+
+int dumpSnapshot(const std::string& file_name, int frame)
+{
+	SnapshotReader reader(file_name);
+	if (!reader.isOpen())
+	{
+		return 1;
+	}
+	std::cout << file_name << ": " << reader.getFrames() << " frames, " << reader.getDimensions() << "D, "
+			  << 8 * reader.getScalarSize() << " bit scalars" << std::endl;
+	if (frame < 0)
+	{
+		std::cout << "frame" << "\t" << "time" << "\t" << "particles" << std::endl;
+		for (int i = 0; i < reader.getFrames(); ++i)
+		{
+			const SnapshotFrame snapshotFrame = reader.getFrame(i);
+			std::cout << i << "\t" << snapshotFrame.time << "\t" << snapshotFrame.particleCount << std::endl;
+		}
+		return 0;
+	}
+	if (frame >= reader.getFrames())
+	{
+		std::cout << "the file has no frame " << frame << std::endl;
+		return 1;
+	}
+
+	const SnapshotFrame snapshotFrame = reader.getFrame(frame);
+	std::cout << "frame " << frame << ", time " << snapshotFrame.time << ", " << snapshotFrame.particleCount << " particles" << std::endl;
+	const bool single = reader.getScalarSize() == sizeof(float);
+	if (reader.getDimensions() == 2)
+	{
+		single ? dumpParticles<2, float>(reader, snapshotFrame) : dumpParticles<2, double>(reader, snapshotFrame);
+	}
+	else
+	{
+		single ? dumpParticles<3, float>(reader, snapshotFrame) : dumpParticles<3, double>(reader, snapshotFrame);
+	}
+	return 0;
+}
+
+template bool SnapshotWriter::writeFrame(const std::vector<BasicParticle<2, float>>& particles, double time);
+template bool SnapshotWriter::writeFrame(const std::vector<BasicParticle<2, double>>& particles, double time);
+template bool SnapshotWriter::writeFrame(const std::vector<BasicParticle<3, float>>& particles, double time);
+template bool SnapshotWriter::writeFrame(const std::vector<BasicParticle<3, double>>& particles, double time);
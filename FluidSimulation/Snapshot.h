@@ -0,0 +1,173 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Particle.h"
+
+/**
+ *	Appends the fluid particles of the simulation to a binary snapshot file, one frame per call of writeFrame.
+ *	Layout, all numbers in the byte order of the machine (little endian on x86), every block starts at a multiple of 8 bytes:
+ *	header:		"FLSN", uint32 version (1), uint32 dimensions, uint32 bytes per scalar (4 or 8), uint64 reserved
+ *	frames:		uint32 particle count n, uint32 reserved, float64 simulated time,
+ *				then the blocks of the frame, each padded with zeros to a multiple of 8 bytes:
+ *				positions (n * dimensions scalars, the components of a particle one after another),
+ *				velocities (n * dimensions scalars), densities (n scalars), pressures (n scalars), ids (n uint32)
+ *	index:		uint64 offset of each frame
+ *	footer:		uint64 offset of the index, uint32 number of frames, "FLSI"
+ *	Only fluid particles are written, the boundary doesn't move. The index and the footer are written when the writer is destroyed,
+ *	a file without them, e.g. of a killed run, is read by following the sizes of the frames.
+ */
+class SnapshotWriter
+{
+public:
+	/**
+	 *	Create a new snapshot file
+	 *	@param file_name name of the file, an existing file is replaced
+	 */
+	SnapshotWriter(const std::string& file_name);
+
+	// write the index and the footer and close the file
+	~SnapshotWriter();
+
+	SnapshotWriter(const SnapshotWriter&) = delete;
+	SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+	/**
+	 *	Append a frame, all frames of a file need the same dimensions and scalar type
+	 *	@param particles the particles of the simulation, only the fluid particles are written
+	 *	@param time the simulated time of the frame
+	 *	@return true if the frame was written
+	 */
+	template <int Dim, typename Real>
+	bool writeFrame(const std::vector<BasicParticle<Dim, Real>>& particles, double time);
+
+	/**
+	 *	@return the number of frames written so far
+	 */
+	int getFrames() const;
+
+private:
+	void writeBlock(const void* data, size_t size);
+
+	std::ofstream file;
+	bool headerWritten = false;
+	uint32_t dimensions = 0;
+	uint32_t scalarSize = 0;
+	std::vector<uint64_t> frameOffsets;
+
+	// the data of one block, reused for each frame
+	std::vector<char> block;
+};
+
+/**
+ *	A frame of a snapshot file, the pointers point directly into the mapped file and stay valid as long as the reader exists
+ */
+struct SnapshotFrame
+{
+	uint32_t particleCount = 0;
+	double time = 0;
+	const void* positions = nullptr;
+	const void* velocities = nullptr;
+	const void* densities = nullptr;
+	const void* pressures = nullptr;
+	const uint32_t* ids = nullptr;
+};
+
+/**
+ *	Reads a snapshot file through a read-only memory mapping, frames are accessed without reading the frames before them
+ */
+class SnapshotReader
+{
+public:
+	/**
+	 *	Map a snapshot file into memory, check isOpen for errors
+	 *	@param file_name name of the file
+	 */
+	SnapshotReader(const std::string& file_name);
+
+	// unmap the file
+	~SnapshotReader();
+
+	SnapshotReader(const SnapshotReader&) = delete;
+	SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+	/**
+	 *	@return true if the file was mapped and has a valid header, without an index only the complete frames are read
+	 */
+	bool isOpen() const;
+
+	int getFrames() const;
+	int getDimensions() const;
+
+	/**
+	 *	@return the number of bytes of a scalar, 4 for float and 8 for double
+	 */
+	int getScalarSize() const;
+
+	/**
+	 *	@param frame number of the frame, from 0 to getFrames() - 1
+	 *	@return the frame, a frame without particles if the number is invalid
+	 */
+	SnapshotFrame getFrame(int frame) const;
+
+	/**
+	 *	Typed access to the positions of a frame
+	 *	@return the positions, nullptr if Dim or Real don't match the file
+	 */
+	template <int Dim, typename Real>
+	const glm::vec<Dim, Real>* getPositions(const SnapshotFrame& frame) const
+	{
+		return matches<Dim, Real>() ? static_cast<const glm::vec<Dim, Real>*>(frame.positions) : nullptr;
+	}
+
+	template <int Dim, typename Real>
+	const glm::vec<Dim, Real>* getVelocities(const SnapshotFrame& frame) const
+	{
+		return matches<Dim, Real>() ? static_cast<const glm::vec<Dim, Real>*>(frame.velocities) : nullptr;
+	}
+
+	template <typename Real>
+	const Real* getDensities(const SnapshotFrame& frame) const
+	{
+		return scalarSize == sizeof(Real) ? static_cast<const Real*>(frame.densities) : nullptr;
+	}
+
+	template <typename Real>
+	const Real* getPressures(const SnapshotFrame& frame) const
+	{
+		return scalarSize == sizeof(Real) ? static_cast<const Real*>(frame.pressures) : nullptr;
+	}
+
+private:
+	template <int Dim, typename Real>
+	bool matches() const
+	{
+		return dimensions == Dim && scalarSize == sizeof(Real) && sizeof(glm::vec<Dim, Real>) == Dim * sizeof(Real);
+	}
+
+	void close();
+
+	// find the complete frames by following their sizes from the first frame, for files without an index
+	void findFrames();
+
+	const char* data = nullptr;
+	size_t size = 0;
+	uint32_t dimensions = 0;
+	uint32_t scalarSize = 0;
+	std::vector<uint64_t> frameOffsets;
+
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
+
+/**
+ *	Print the header and the frame index of a snapshot file and the particles of one frame
+ *	@param file_name name of the snapshot file
+ *	@param frame the frame whose particles are printed, -1 to print only the index
+ *	@return 0 on success, 1 if the file can't be read
+ */
+int dumpSnapshot(const std::string& file_name, int frame);
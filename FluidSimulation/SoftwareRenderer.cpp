@@ -0,0 +1,87 @@
+#include "SoftwareRenderer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, float particleSize)
+{
+	this->width = width;
+	this->height = height;
+	this->particleSize = particleSize;
+	pixels.assign(size_t(width) * size_t(height), glm::vec3(0.f));
+	background = pixels;
+}
+
+bool SoftwareRenderer::update()
+{
+	return true;
+}
+
+void SoftwareRenderer::draw(const std::vector<Particle>& particles)
+{
+	PROFILE_SCOPE("rendering");
+	pixels = background;
+
+	for (const Particle& particle : particles)
+	{
+		// merged particles are larger
+		const float radius = 0.5f * (particle.size > 0 ? particle.size : particleSize);
+
+		// the pixels whose centers can lie inside the particle
+		const int left = std::max(int(std::floor(particle.position.x - radius)), 0);
+		const int right = std::min(int(std::ceil(particle.position.x + radius)), width - 1);
+		const int bottom = std::max(int(std::floor(particle.position.y - radius)), 0);
+		const int top = std::min(int(std::ceil(particle.position.y + radius)), height - 1);
+		for (int y = bottom; y <= top; ++y)
+		{
+			for (int x = left; x <= right; ++x)
+			{
+				// the same soft edge as the fragment shader: opaque inside 80% of the radius, transparent outside
+				const glm::vec2 center = glm::vec2(float(x) + 0.5f, float(y) + 0.5f);
+				const float distance = glm::length(center - particle.position) / radius;
+				if (distance >= 1.f)
+				{
+					continue;
+				}
+				const float alpha = glm::smoothstep(1.f, 0.8f, distance);
+				glm::vec3& pixel = pixels[size_t(y) * size_t(width) + size_t(x)];
+				pixel = alpha * particle.color + (1.f - alpha) * pixel;
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::set_boundary(const std::vector<float>& coverage, int width, int height)
+{
+	// the same color as the boundary particles
+	const glm::vec3 color = glm::vec3(0.5f);
+	for (int y = 0; y < std::min(height, this->height); ++y)
+	{
+		for (int x = 0; x < std::min(width, this->width); ++x)
+		{
+			background[size_t(y) * size_t(this->width) + size_t(x)] = coverage[size_t(y) * size_t(width) + size_t(x)] * color;
+		}
+	}
+}
+
+void SoftwareRenderer::get_picture_data(char* buffer, int width, int height) const
+{
+	PROFILE_SCOPE("readback");
+	// parts outside of the image stay black, as outside of the window
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			const glm::vec3 color = x < this->width && y < this->height ? pixels[size_t(y) * size_t(this->width) + size_t(x)] : glm::vec3(0.f);
+			char* pixel = buffer + 3 * (size_t(y) * size_t(width) + size_t(x));
+			pixel[0] = static_cast<char>(static_cast<unsigned char>(glm::clamp(color.b, 0.f, 1.f) * 255.f + 0.5f));
+			pixel[1] = static_cast<char>(static_cast<unsigned char>(glm::clamp(color.g, 0.f, 1.f) * 255.f + 0.5f));
+			pixel[2] = static_cast<char>(static_cast<unsigned char>(glm::clamp(color.r, 0.f, 1.f) * 255.f + 0.5f));
+		}
+	}
+}
+
+bool SoftwareRenderer::fast_forward_requested()
+{
+	return false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "Renderer.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ *	Draws the particles on the CPU into an image in memory, for runs without a display or OpenGL.
+ *	The pictures look like the pictures of the window: round particles with a soft edge on a black background.
+ */
+class SoftwareRenderer : public Renderer
+{
+public:
+	/**
+	 *	Create a new renderer with a black image
+	 *	@param width the width of the image in pixels, which is the width of the simulated domain
+	 *	@param height the height of the image in pixels
+	 *	@param particleSize diameter of the particles which weren't merged
+	 */
+	SoftwareRenderer(int width, int height, float particleSize);
+
+	// there are no events without a window, the run ends by other means
+	bool update() override;
+
+	void draw(const std::vector<Particle>& particles) override;
+
+	void set_boundary(const std::vector<float>& coverage, int width, int height) override;
+
+	void get_picture_data(char* buffer, int width, int height) const override;
+
+	bool fast_forward_requested() override;
+
+private:
+	int width;
+	int height;
+	float particleSize;
+	// colors of the pixels, the lowest row first
+	std::vector<glm::vec3> pixels;
+	// colors of the pixels without particles, black outside of the boundary
+	std::vector<glm::vec3> background;
+};
@@ -0,0 +1,650 @@
+#include "Trajectory.h"
+#include "Profiler.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	const uint32_t trajectoryVersion = 1;
+	const size_t headerSize = 32;
+	const size_t frameHeaderSize = 24;
+	const size_t footerSize = 16;
+
+	template <typename T>
+	T readValue(const char* data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void writeValue(std::ofstream& file, T value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	// signed values with a small magnitude become small unsigned values: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+	uint64_t zigzag(uint64_t value)
+	{
+		return (value << 1) ^ (0 - (value >> 63));
+	}
+
+	uint64_t unzigzag(uint64_t value)
+	{
+		return (value >> 1) ^ (0 - (value & 1));
+	}
+
+	// probabilities of the range coder have 11 bits and adapt with a rate of 1/32
+	const int probabilityBits = 11;
+	const uint16_t initialProbability = 1 << (probabilityBits - 1);
+	const int adaptationShift = 5;
+	const uint32_t topValue = 1u << 24;
+
+	/**
+	 *	Adaptive model of unsigned values: the number of bits of value + 1 is coded with a binary tree of adaptive probabilities,
+	 *	the bits below the highest one with fixed probabilities
+	 */
+	struct ValueModel
+	{
+		uint16_t bitCount[64];
+
+		ValueModel()
+		{
+			std::fill(std::begin(bitCount), std::end(bitCount), initialProbability);
+		}
+	};
+
+	/**
+	 *	Binary range encoder in the style of LZMA
+	 */
+	class RangeEncoder
+	{
+	public:
+		RangeEncoder(std::vector<char>& result) : result(result)
+		{
+			result.clear();
+		}
+
+		void encodeBit(uint16_t& probability, uint32_t bit)
+		{
+			const uint32_t bound = (range >> probabilityBits) * probability;
+			if (bit == 0)
+			{
+				range = bound;
+				probability += ((1 << probabilityBits) - probability) >> adaptationShift;
+			}
+			else
+			{
+				low += bound;
+				range -= bound;
+				probability -= probability >> adaptationShift;
+			}
+			normalize();
+		}
+
+		void encodeDirect(uint64_t value, int bits)
+		{
+			for (int i = bits - 1; i >= 0; --i)
+			{
+				range >>= 1;
+				if ((value >> i) & 1)
+				{
+					low += range;
+				}
+				normalize();
+			}
+		}
+
+		// the value is read, the same interface as the decoder
+		void codeValue(ValueModel& model, uint64_t& value)
+		{
+			const uint64_t shifted = value + 1;
+			int bits = 0;
+			while (bits < 63 && (shifted >> (bits + 1)) != 0)
+			{
+				++bits;
+			}
+			uint32_t node = 1;
+			for (int i = 5; i >= 0; --i)
+			{
+				const uint32_t bit = (bits >> i) & 1;
+				encodeBit(model.bitCount[node], bit);
+				node = (node << 1) | bit;
+			}
+			encodeDirect(shifted, bits);
+		}
+
+		void flush()
+		{
+			for (int i = 0; i < 5; ++i)
+			{
+				shiftLow();
+			}
+		}
+
+	private:
+		void normalize()
+		{
+			while (range < topValue)
+			{
+				range <<= 8;
+				shiftLow();
+			}
+		}
+
+		void shiftLow()
+		{
+			// a byte is held back while a carry can still change it
+			if (uint32_t(low) < 0xFF000000u || (low >> 32) != 0)
+			{
+				const uint8_t carry = uint8_t(low >> 32);
+				uint8_t byte = cache;
+				do
+				{
+					result.push_back(char(uint8_t(byte + carry)));
+					byte = 0xFF;
+				} while (--cacheSize != 0);
+				cache = uint8_t(low >> 24);
+			}
+			++cacheSize;
+			low = (low & 0x00FFFFFF) << 8;
+		}
+
+		std::vector<char>& result;
+		uint64_t low = 0;
+		uint32_t range = 0xFFFFFFFF;
+		uint8_t cache = 0;
+		uint64_t cacheSize = 1;
+	};
+
+	class RangeDecoder
+	{
+	public:
+		RangeDecoder(const char* data, size_t size) : data(reinterpret_cast<const uint8_t*>(data)), size(size)
+		{
+			for (int i = 0; i < 5; ++i)
+			{
+				code = (code << 8) | nextByte();
+			}
+		}
+
+		uint32_t decodeBit(uint16_t& probability)
+		{
+			const uint32_t bound = (range >> probabilityBits) * probability;
+			uint32_t bit;
+			if (code < bound)
+			{
+				range = bound;
+				probability += ((1 << probabilityBits) - probability) >> adaptationShift;
+				bit = 0;
+			}
+			else
+			{
+				code -= bound;
+				range -= bound;
+				probability -= probability >> adaptationShift;
+				bit = 1;
+			}
+			normalize();
+			return bit;
+		}
+
+		uint64_t decodeDirect(int bits)
+		{
+			uint64_t value = 0;
+			for (int i = 0; i < bits; ++i)
+			{
+				range >>= 1;
+				uint32_t bit = 0;
+				if (code >= range)
+				{
+					code -= range;
+					bit = 1;
+				}
+				value = (value << 1) | bit;
+				normalize();
+			}
+			return value;
+		}
+
+		// the value is written, the same interface as the encoder
+		void codeValue(ValueModel& model, uint64_t& value)
+		{
+			uint32_t node = 1;
+			for (int i = 0; i < 6; ++i)
+			{
+				node = (node << 1) | decodeBit(model.bitCount[node]);
+			}
+			const int bits = int(node - 64);
+			value = ((uint64_t(1) << bits) | decodeDirect(bits)) - 1;
+		}
+
+		/**
+		 *	@return true if the decoder needed more bytes than the data has
+		 */
+		bool isDamaged() const
+		{
+			return position > size;
+		}
+
+	private:
+		uint32_t nextByte()
+		{
+			return position < size ? data[position++] : (++position, 0u);
+		}
+
+		void normalize()
+		{
+			while (range < topValue)
+			{
+				range <<= 8;
+				code = (code << 8) | nextByte();
+			}
+		}
+
+		const uint8_t* data;
+		size_t size;
+		size_t position = 0;
+		uint32_t range = 0xFFFFFFFF;
+		uint32_t code = 0;
+	};
+
+	/**
+	 *	Code the ids and the values of a frame, used for encoding and for decoding so that both predict the values in the same way.
+	 *	The encoder reads the ids and values, the decoder writes them.
+	 *	@param components number of values of a particle
+	 *	@return false if the decoded ids are invalid
+	 */
+	template <typename Coder>
+	bool codeFrame(Coder& coder, int components, std::vector<uint32_t>& ids, std::vector<int64_t>& values,
+				   const std::vector<uint32_t>& previousIds, const std::vector<int64_t>& previousValues)
+	{
+		// the values of particles which were in the previous frame, of new particles and the gaps between the ids have separate models
+		ValueModel idModel;
+		std::vector<ValueModel> differenceModels(components);
+		std::vector<ValueModel> newModels(components);
+
+		size_t previous = 0;
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			const uint64_t expected = i == 0 ? 0 : uint64_t(ids[i - 1]) + 1;
+			uint64_t gap = ids[i] - expected;
+			coder.codeValue(idModel, gap);
+			if (gap > 0xFFFFFFFFu - expected)
+			{
+				return false;
+			}
+			ids[i] = uint32_t(expected + gap);
+
+			while (previous < previousIds.size() && previousIds[previous] < ids[i])
+			{
+				++previous;
+			}
+			const bool found = previous < previousIds.size() && previousIds[previous] == ids[i];
+			for (int component = 0; component < components; ++component)
+			{
+				const size_t index = i * components + component;
+				int64_t predicted = 0;
+				if (found)
+				{
+					predicted = previousValues[previous * components + component];
+				}
+				else if (i > 0)
+				{
+					predicted = values[index - components];
+				}
+				// unsigned arithmetic, so that damaged files can't overflow
+				uint64_t residual = zigzag(uint64_t(values[index]) - uint64_t(predicted));
+				coder.codeValue(found ? differenceModels[component] : newModels[component], residual);
+				values[index] = int64_t(uint64_t(predicted) + unzigzag(residual));
+			}
+		}
+		return true;
+	}
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string& file_name, double particle_size, double position_error, double velocity_error, int keyframe_interval)
+{
+	// a value is rounded to the nearest point of its grid, so the largest error is half the spacing
+	positionSpacing = 2 * std::max(position_error, 1E-6) * particle_size;
+	velocitySpacing = 2 * std::max(velocity_error, 1E-6) * particle_size;
+	keyframeInterval = uint32_t(std::max(keyframe_interval, 1));
+	file.open(file_name, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+	if (!file.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+	}
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	if (!file.is_open() || !headerWritten)
+	{
+		return;
+	}
+	const uint64_t indexOffset = static_cast<uint64_t>(file.tellp());
+	file.write(reinterpret_cast<const char*>(frameOffsets.data()), frameOffsets.size() * sizeof(uint64_t));
+	writeValue<uint64_t>(file, indexOffset);
+	writeValue<uint32_t>(file, static_cast<uint32_t>(frameOffsets.size()));
+	file.write("FLTI", 4);
+}
+
+template <int Dim, typename Real>
+bool TrajectoryWriter::writeFrame(const std::vector<BasicParticle<Dim, Real>>& particles, double time)
+{
+	PROFILE_SCOPE("write trajectory");
+	if (!file.is_open())
+	{
+		return false;
+	}
+	if (!headerWritten)
+	{
+		dimensions = Dim;
+		file.write("FLTR", 4);
+		writeValue<uint32_t>(file, trajectoryVersion);
+		writeValue<uint32_t>(file, dimensions);
+		writeValue<uint32_t>(file, keyframeInterval);
+		writeValue<double>(file, positionSpacing);
+		writeValue<double>(file, velocitySpacing);
+		bytes += headerSize;
+		headerWritten = true;
+	}
+	else if (dimensions != Dim)
+	{
+		std::cout << "trajectory frames need the same dimensions" << std::endl;
+		return false;
+	}
+
+	// the fluid particles ordered by their ids, which don't change when the simulation reorders the particles
+	std::vector<unsigned int> order;
+	for (unsigned int i = 0; i < particles.size(); ++i)
+	{
+		if (!particles[i].boundary)
+		{
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return particles[a].id < particles[b].id; });
+
+	ids.resize(order.size());
+	values.resize(order.size() * 2 * Dim);
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const BasicParticle<Dim, Real>& particle = particles[order[i]];
+		ids[i] = particle.id;
+		for (int axis = 0; axis < Dim; ++axis)
+		{
+			values[i * 2 * Dim + axis] = std::llround(double(particle.position[axis]) / positionSpacing);
+			values[i * 2 * Dim + Dim + axis] = std::llround(double(particle.velocity[axis]) / velocitySpacing);
+		}
+	}
+	return writeQuantizedFrame(time);
+}
+
+bool TrajectoryWriter::writeQuantizedFrame(double time)
+{
+	const bool keyframe = frameOffsets.size() % keyframeInterval == 0;
+	if (keyframe)
+	{
+		previousIds.clear();
+		previousValues.clear();
+	}
+	RangeEncoder encoder(compressed);
+	codeFrame(encoder, 2 * dimensions, ids, values, previousIds, previousValues);
+	encoder.flush();
+
+	frameOffsets.push_back(static_cast<uint64_t>(file.tellp()));
+	writeValue<uint32_t>(file, static_cast<uint32_t>(ids.size()));
+	writeValue<uint32_t>(file, keyframe ? 1 : 0);
+	writeValue<double>(file, time);
+	writeValue<uint64_t>(file, compressed.size());
+	file.write(compressed.data(), compressed.size());
+	bytes += frameHeaderSize + compressed.size();
+
+	std::swap(ids, previousIds);
+	std::swap(values, previousValues);
+	return file.good();
+}
+
+int TrajectoryWriter::getFrames() const
+{
+	return static_cast<int>(frameOffsets.size());
+}
+
+uint64_t TrajectoryWriter::getBytes() const
+{
+	return bytes;
+}
+
+
+TrajectoryReader::TrajectoryReader(const std::string& file_name)
+{
+	std::ifstream file_in(file_name, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+	if (!file_in.is_open())
+	{
+		std::cout << "failed to open " << file_name << std::endl;
+		return;
+	}
+	data.resize(static_cast<size_t>(file_in.tellg()));
+	file_in.seekg(0);
+	file_in.read(data.data(), data.size());
+
+	// check the header, then read the index given by the footer
+	const size_t size = data.size();
+	const bool valid = file_in && size >= headerSize && std::memcmp(data.data(), "FLTR", 4) == 0 && readValue<uint32_t>(data.data() + 4) == trajectoryVersion;
+	if (valid)
+	{
+		dimensions = readValue<uint32_t>(data.data() + 8);
+		keyframeInterval = readValue<uint32_t>(data.data() + 12);
+		positionSpacing = readValue<double>(data.data() + 16);
+		velocitySpacing = readValue<double>(data.data() + 24);
+	}
+	if (!valid || (dimensions != 2 && dimensions != 3))
+	{
+		std::cout << file_name << " is not a trajectory file" << std::endl;
+		data.clear();
+		return;
+	}
+	if (size >= headerSize + footerSize && std::memcmp(data.data() + size - 4, "FLTI", 4) == 0)
+	{
+		const uint64_t indexOffset = readValue<uint64_t>(data.data() + size - footerSize);
+		const uint32_t frames = readValue<uint32_t>(data.data() + size - footerSize + 8);
+		if (indexOffset + uint64_t(frames) * sizeof(uint64_t) + footerSize == size)
+		{
+			frameOffsets.resize(frames);
+			std::memcpy(frameOffsets.data(), data.data() + indexOffset, frames * sizeof(uint64_t));
+			if (std::all_of(frameOffsets.begin(), frameOffsets.end(), [&](uint64_t offset) { return offset + frameHeaderSize <= indexOffset; }))
+			{
+				return;
+			}
+			frameOffsets.clear();
+		}
+	}
+
+	// the writer of a killed run didn't write the index, the last frame may be incomplete
+	findFrames();
+	std::cout << file_name << " has no index, " << frameOffsets.size() << " complete frames were found" << std::endl;
+}
+
+void TrajectoryReader::findFrames()
+{
+	// the first frame is a keyframe, every following frame is decoded from the frames before it
+	uint64_t offset = headerSize;
+	while (offset + frameHeaderSize <= data.size())
+	{
+		const char* header = data.data() + offset;
+		const uint32_t keyframe = readValue<uint32_t>(header + 4);
+		const uint64_t compressedSize = readValue<uint64_t>(header + 16);
+		if (keyframe > 1 || (frameOffsets.empty() && keyframe == 0) || compressedSize > data.size() - offset - frameHeaderSize)
+		{
+			break;
+		}
+		frameOffsets.push_back(offset);
+		offset += frameHeaderSize + compressedSize;
+	}
+}
+
+bool TrajectoryReader::isOpen() const
+{
+	return !data.empty();
+}
+
+int TrajectoryReader::getFrames() const
+{
+	return static_cast<int>(frameOffsets.size());
+}
+
+int TrajectoryReader::getDimensions() const
+{
+	return static_cast<int>(dimensions);
+}
+
+int TrajectoryReader::getKeyframeInterval() const
+{
+	return static_cast<int>(keyframeInterval);
+}
+
+double TrajectoryReader::getPositionError() const
+{
+	return positionSpacing / 2;
+}
+
+double TrajectoryReader::getVelocityError() const
+{
+	return velocitySpacing / 2;
+}
+
+bool TrajectoryReader::decodeFrame(int frame)
+{
+	const char* header = data.data() + frameOffsets[frame];
+	const uint32_t particleCount = readValue<uint32_t>(header);
+	const bool keyframe = readValue<uint32_t>(header + 4) != 0;
+	const uint64_t compressedSize = readValue<uint64_t>(header + 16);
+	// each particle takes more than a bit of compressed data, a larger count belongs to a damaged frame
+	if (compressedSize > data.size() - frameOffsets[frame] - frameHeaderSize || particleCount > 16 * compressedSize + 16 ||
+		(!keyframe && decodedFrame != frame - 1))
+	{
+		return false;
+	}
+
+	std::vector<uint32_t> frameIds(particleCount);
+	std::vector<int64_t> frameValues(size_t(particleCount) * 2 * dimensions);
+	RangeDecoder decoder(header + frameHeaderSize, size_t(compressedSize));
+	if (keyframe)
+	{
+		ids.clear();
+		values.clear();
+	}
+	if (!codeFrame(decoder, 2 * dimensions, frameIds, frameValues, ids, values) || decoder.isDamaged())
+	{
+		decodedFrame = -1;
+		return false;
+	}
+	ids = std::move(frameIds);
+	values = std::move(frameValues);
+	time = readValue<double>(header + 8);
+	decodedFrame = frame;
+	return true;
+}
+
+bool TrajectoryReader::readFrame(int frame, TrajectoryFrame& result)
+{
+	if (frame < 0 || frame >= getFrames())
+	{
+		return false;
+	}
+
+	// continue after the frame decoded last if there is no keyframe in between, otherwise start at the keyframe before the frame
+	auto isKeyframe = [&](int i) { return readValue<uint32_t>(data.data() + frameOffsets[i] + 4) != 0; };
+	int start = frame;
+	while (start != decodedFrame && start != decodedFrame + 1 && start > 0 && !isKeyframe(start))
+	{
+		--start;
+	}
+	for (int i = start; i <= frame; ++i)
+	{
+		if (decodedFrame != i && !decodeFrame(i))
+		{
+			std::cout << "frame " << i << " of the trajectory is damaged" << std::endl;
+			return false;
+		}
+	}
+
+	const size_t particleCount = ids.size();
+	result.time = time;
+	result.ids = ids;
+	result.positions.resize(particleCount * dimensions);
+	result.velocities.resize(particleCount * dimensions);
+	for (size_t i = 0; i < particleCount; ++i)
+	{
+		for (uint32_t axis = 0; axis < dimensions; ++axis)
+		{
+			result.positions[i * dimensions + axis] = double(values[i * 2 * dimensions + axis]) * positionSpacing;
+			result.velocities[i * dimensions + axis] = double(values[i * 2 * dimensions + dimensions + axis]) * velocitySpacing;
+		}
+	}
+	return true;
+}
+
+
+int dumpTrajectory(const std::string& file_name, int frame)
+{
+	TrajectoryReader reader(file_name);
+	if (!reader.isOpen())
+	{
+		return 1;
+	}
+	std::cout << file_name << ": " << reader.getFrames() << " frames, " << reader.getDimensions() << "D, a keyframe every "
+			  << reader.getKeyframeInterval() << " frames, errors up to " << reader.getPositionError() << " (position) and "
+			  << reader.getVelocityError() << " (velocity)" << std::endl;
+	TrajectoryFrame trajectoryFrame;
+	if (frame < 0)
+	{
+		std::cout << "frame" << "\t" << "time" << "\t" << "particles" << std::endl;
+		for (int i = 0; i < reader.getFrames(); ++i)
+		{
+			if (!reader.readFrame(i, trajectoryFrame))
+			{
+				return 1;
+			}
+			std::cout << i << "\t" << trajectoryFrame.time << "\t" << trajectoryFrame.ids.size() << std::endl;
+		}
+		return 0;
+	}
+	if (frame >= reader.getFrames())
+	{
+		std::cout << "the file has no frame " << frame << std::endl;
+		return 1;
+	}
+	if (!reader.readFrame(frame, trajectoryFrame))
+	{
+		return 1;
+	}
+
+	const int dimensions = reader.getDimensions();
+	std::cout << "frame " << frame << ", time " << trajectoryFrame.time << ", " << trajectoryFrame.ids.size() << " particles" << std::endl;
+	std::cout << "id" << "\t" << "position" << "\t" << "velocity" << std::endl;
+	for (size_t i = 0; i < trajectoryFrame.ids.size(); ++i)
+	{
+		std::cout << trajectoryFrame.ids[i] << "\t";
+		for (int axis = 0; axis < dimensions; ++axis)
+		{
+			std::cout << (axis > 0 ? " " : "") << trajectoryFrame.positions[i * dimensions + axis];
+		}
+		std::cout << "\t";
+		for (int axis = 0; axis < dimensions; ++axis)
+		{
+			std::cout << (axis > 0 ? " " : "") << trajectoryFrame.velocities[i * dimensions + axis];
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
+
+template bool TrajectoryWriter::writeFrame(const std::vector<BasicParticle<2, float>>& particles, double time);
+template bool TrajectoryWriter::writeFrame(const std::vector<BasicParticle<2, double>>& particles, double time);
+template bool TrajectoryWriter::writeFrame(const std::vector<BasicParticle<3, float>>& particles, double time);
+template bool TrajectoryWriter::writeFrame(const std::vector<BasicParticle<3, double>>& particles, double time);
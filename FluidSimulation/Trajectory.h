@@ -0,0 +1,161 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "Particle.h"
+
+/**
+ *	Records the trajectory of the fluid particles with bounded errors, a fraction of the size of a snapshot.
+ *	The positions are rounded to a grid anchored at the origin of the simulation space whose spacing is a fraction of the particle size,
+ *	the velocities likewise to a spacing in particle sizes per second. The error bounds hold for each axis on its own,
+ *	the length of the error vector can be up to sqrt(dimensions) times the bound. In a frame the particles are ordered by their ids.
+ *	Each value is stored as the difference to the value of the same particle in the previous frame, a particle which
+ *	wasn't in the previous frame, e.g. a merged one, as the difference to the particle before it.
+ *	The differences are compressed with an adaptive range coder.
+ *	Every keyframe interval frames a keyframe doesn't refer to the previous frame, so that a reader can start decoding there.
+ *	Layout, all numbers in the byte order of the machine:
+ *	header:		"FLTR", uint32 version (1), uint32 dimensions, uint32 keyframe interval,
+ *				float64 spacing of the positions, float64 spacing of the velocities
+ *	frames:		uint32 particle count, uint32 1 for a keyframe and 0 otherwise, float64 simulated time,
+ *				uint64 size of the compressed data, the compressed data
+ *	index:		uint64 offset of each frame
+ *	footer:		uint64 offset of the index, uint32 number of frames, "FLTI"
+ */
+class TrajectoryWriter
+{
+public:
+	/**
+	 *	Create a new trajectory file
+	 *	@param file_name name of the file, an existing file is replaced
+	 *	@param particle_size size of the particles, the unit of the error bounds
+	 *	@param position_error largest error of each component of a position in particle sizes
+	 *	@param velocity_error largest error of each component of a velocity in particle sizes per second
+	 *	@param keyframe_interval number of frames from one keyframe to the next
+	 */
+	TrajectoryWriter(const std::string& file_name, double particle_size, double position_error, double velocity_error, int keyframe_interval);
+
+	// write the index and the footer and close the file
+	~TrajectoryWriter();
+
+	TrajectoryWriter(const TrajectoryWriter&) = delete;
+	TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+	/**
+	 *	Append a frame, all frames of a file need the same dimensions
+	 *	@param particles the particles of the simulation, only the fluid particles are written
+	 *	@param time the simulated time of the frame
+	 *	@return true if the frame was written
+	 */
+	template <int Dim, typename Real>
+	bool writeFrame(const std::vector<BasicParticle<Dim, Real>>& particles, double time);
+
+	/**
+	 *	@return the number of frames written so far
+	 */
+	int getFrames() const;
+
+	/**
+	 *	@return the number of bytes written so far
+	 */
+	uint64_t getBytes() const;
+
+private:
+	// compress the quantized values of a frame and append it to the file
+	bool writeQuantizedFrame(double time);
+
+	std::ofstream file;
+	bool headerWritten = false;
+	uint32_t dimensions = 0;
+	uint32_t keyframeInterval;
+	double positionSpacing;
+	double velocitySpacing;
+	std::vector<uint64_t> frameOffsets;
+	uint64_t bytes = 0;
+
+	// the ids and the quantized positions and velocities of the current and the previous frame,
+	// 2 * dimensions values per particle, first the position and then the velocity
+	std::vector<uint32_t> ids;
+	std::vector<int64_t> values;
+	std::vector<uint32_t> previousIds;
+	std::vector<int64_t> previousValues;
+
+	// the compressed data of a frame, reused for each frame
+	std::vector<char> compressed;
+};
+
+/**
+ *	A decoded frame of a trajectory file, the particles are ordered by their ids
+ */
+struct TrajectoryFrame
+{
+	double time = 0;
+	std::vector<uint32_t> ids;
+	// dimensions values per particle
+	std::vector<double> positions;
+	std::vector<double> velocities;
+};
+
+/**
+ *	Reads a trajectory file. A frame is decoded from the keyframe before it, reading the frames in order decodes each frame once.
+ */
+class TrajectoryReader
+{
+public:
+	/**
+	 *	Read a trajectory file, check isOpen for errors. Without an index the complete frames are found by their sizes.
+	 *	@param file_name name of the file
+	 */
+	TrajectoryReader(const std::string& file_name);
+
+	/**
+	 *	@return true if the file was read and has a valid header
+	 */
+	bool isOpen() const;
+
+	int getFrames() const;
+	int getDimensions() const;
+	int getKeyframeInterval() const;
+
+	/**
+	 *	@return the largest error of each component of the positions and velocities, half the spacing of their grids
+	 */
+	double getPositionError() const;
+	double getVelocityError() const;
+
+	/**
+	 *	Decode a frame
+	 *	@param frame number of the frame, from 0 to getFrames() - 1
+	 *	@param result the decoded frame
+	 *	@return false if the number is invalid or the frame is damaged
+	 */
+	bool readFrame(int frame, TrajectoryFrame& result);
+
+private:
+	// decode the quantized values of a frame, using the values of the previous frame if it isn't a keyframe
+	bool decodeFrame(int frame);
+
+	// find the complete frames by following their sizes from the first frame, for files without an index
+	void findFrames();
+
+	std::vector<char> data;
+	uint32_t dimensions = 0;
+	uint32_t keyframeInterval = 0;
+	double positionSpacing = 0;
+	double velocitySpacing = 0;
+	std::vector<uint64_t> frameOffsets;
+
+	// the frame decoded last, -1 if there is none
+	int decodedFrame = -1;
+	double time = 0;
+	std::vector<uint32_t> ids;
+	std::vector<int64_t> values;
+};
+
+/**
+ *	Print the header and the frame index of a trajectory file and the particles of one frame
+ *	@param file_name name of the trajectory file
+ *	@param frame the frame whose particles are printed, -1 to print only the index
+ *	@return 0 on success, 1 if the file can't be read
+ */
+int dumpTrajectory(const std::string& file_name, int frame);
@@ -14,6 +14,23 @@ void SimulationTest::SetUp()
 		}
 	}
 	particles = simulation.getParticles();
-	grid = ParticleUniformGrid(20, 1000, 1000);
+	grid = ParticleUniformGrid(simulation.getKernelSupport(), glm::ivec2(1000, 1000));
+	grid.initializeGrid(particles);
+}
+
+void VolumeSimulationTest::SetUp()
+{
+	// the first axis changes fastest in the particle index
+	for (int k = 0; k < 200; k += 10)
+	{
+		for (int j = 0; j < 200; j += 10)
+		{
+			for (int i = 0; i < 200; i += 10)
+			{
+				simulation.addParticle(glm::vec3(i, j, k), glm::vec3(0.5f, 0.5f, 0.5f), false);
+			}
+		}
+	}
+	particles = simulation.getParticles();
 	grid.initializeGrid(particles);
 }
@@ -5,10 +5,24 @@
 class SimulationTest : public ::testing::Test
 {
 protected:
-	Simulation simulation = Simulation(1000, 1000, 10);
+	Simulation simulation = Simulation(glm::ivec2(1000, 1000), 10, 1, 0, 9.81f, nullptr);
 	std::vector<Particle> particles;
 	unsigned int testingParticle = 50 * 100 + 50;
-	ParticleUniformGrid grid = ParticleUniformGrid(simulation.getKernelSupport(), 1000, 1000);
+	ParticleUniformGrid grid = ParticleUniformGrid(simulation.getKernelSupport(), glm::ivec2(1000, 1000));
+	void SetUp() override;
+};
+
+/**
+ *	Particles on a regular lattice in 3D, one particle size apart
+ */
+class VolumeSimulationTest : public ::testing::Test
+{
+protected:
+	BasicSimulation<3> simulation = BasicSimulation<3>(glm::ivec3(200, 200, 200), 10, 1, 0, 9.81f, nullptr);
+	std::vector<BasicParticle<3>> particles;
+	// the particle in the middle of the lattice
+	unsigned int testingParticle = (10 * 20 + 10) * 20 + 10;
+	BasicParticleUniformGrid<3> grid = BasicParticleUniformGrid<3>(simulation.getKernelSupport(), glm::ivec3(200, 200, 200));
 	void SetUp() override;
 };
 
@@ -1,8 +1,26 @@
 #include "pch.h"
 #include "../FluidSimulation/Simulation.h"
+#include "../FluidSimulation/IncompressibleSimulation.h"
+#include "../FluidSimulation/PredictiveCorrectiveSimulation.h"
+#include "../FluidSimulation/PositionBasedSimulation.h"
+#include "../FluidSimulation/Scenario.h"
+#include "../FluidSimulation/FrameController.h"
+#include "../FluidSimulation/Checkpoint.h"
+#include "../FluidSimulation/Snapshot.h"
+#include "../FluidSimulation/Trajectory.h"
+#include "../FluidSimulation/RunConfiguration.h"
+#include "../FluidSimulation/FrameEncoder.h"
+#include "../FluidSimulation/Metrics.h"
 #include "SimulationTest.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_access.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <set>
+#include <cstring>
+#include <thread>
 
 glm::vec2 roundVector(const glm::vec2& vector, float factor = 10000000000.f)
 {
@@ -149,4 +167,879 @@ TEST_F(SimulationTest, GridSortedListTest)
 	EXPECT_EQ(grid.getCellIndex(particles[sortedList[5]].position), 1);
 	EXPECT_EQ(grid.getCellIndex(particles[sortedList[100]].position), 25);
 	EXPECT_EQ(grid.getCellIndex(particles[sortedList[200]].position), 51);
+}
+
+TEST_F(VolumeSimulationTest, GridCellIndexTest)
+{
+	// 11 cells along each axis, the first axis changes fastest
+	EXPECT_EQ(grid.getCellIndex(glm::vec3(0, 0, 0)), 0);
+	EXPECT_EQ(grid.getCellIndex(glm::vec3(20, 19, 19)), 1);
+	EXPECT_EQ(grid.getCellIndex(glm::vec3(19, 20, 19)), 11);
+	EXPECT_EQ(grid.getCellIndex(glm::vec3(19, 19, 20)), 121);
+	EXPECT_EQ(grid.getCellIndex(glm::vec3(25, 45, 65)), 1 + 2 * 11 + 3 * 121);
+}
+
+TEST_F(VolumeSimulationTest, NeighborTest)
+{
+	// the neighbors in the 27 surrounding cells are found, also across the edges and corners of the cells
+	for (unsigned int i = 0; i < particles.size(); i += 7)
+	{
+		std::vector<unsigned int> neighbors = simulation.getNeighbors(i, grid);
+		for (unsigned int j = 0; j < particles.size(); ++j)
+		{
+			if (std::find(neighbors.begin(), neighbors.end(), j) == neighbors.end())
+			{
+				EXPECT_GE(glm::distance(particles[i].position, particles[j].position), simulation.getKernelSupport());
+			}
+			else
+			{
+				EXPECT_LT(glm::distance(particles[i].position, particles[j].position), simulation.getKernelSupport());
+			}
+		}
+	}
+	// 1 + 6 + 12 + 8 particles closer than two particle sizes
+	EXPECT_EQ(simulation.getNeighbors(testingParticle, grid).size(), 27);
+}
+
+TEST_F(VolumeSimulationTest, KernelFunctionTest)
+{
+	// the volumes of the neighbors add up to one, the lattice sum of the cubic spline is exact to 0.2%
+	float sum = 0;
+	for (auto& neighbor : simulation.getNeighbors(testingParticle, grid))
+	{
+		sum += simulation.kernelFunction(particles[testingParticle].position, particles[neighbor].position);
+	}
+	EXPECT_NEAR(sum * simulation.getParticleMass() / simulation.getFluidDensity(), 1.f, 2E-3f);
+}
+
+TEST_F(VolumeSimulationTest, KernelGradientTest)
+{
+	glm::vec3 sumV = glm::vec3(0.f);
+	glm::mat3 sumM = glm::mat3(0.f);
+	for (auto& neighbor : simulation.getNeighbors(testingParticle, grid))
+	{
+		const glm::vec3 xi = particles[testingParticle].position;
+		const glm::vec3 xj = particles[neighbor].position;
+		sumV += simulation.kernelGradient(xi, xj);
+		sumM += glm::outerProduct(xi - xj, simulation.kernelGradient(xi, xj));
+	}
+
+	// the gradients cancel out, and the sum of the outer products is the negative identity divided by the volume,
+	// which the lattice sum of the cubic spline matches to 2%
+	const float volume = simulation.getParticleMass() / simulation.getFluidDensity();
+	for (int row = 0; row < 3; ++row)
+	{
+		EXPECT_NEAR(sumV[row] * volume, 0.f, 1E-6f);
+		for (int column = 0; column < 3; ++column)
+		{
+			EXPECT_NEAR(sumM[column][row] * volume, row == column ? -1.f : 0.f, 3E-2f);
+		}
+	}
+}
+
+TEST(CheckpointTest, ResumeTest)
+{
+	// a run which is continued from a checkpoint ends exactly like the run without interruption
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationCheckpointTest";
+	std::filesystem::create_directories(folder);
+	const std::string fileName = (folder / "checkpoint.flcp").string();
+	{
+		// the metrics of both runs are written into the folder until the io is deleted
+		IO io(folder.string());
+		RunParameters parameters;
+		parameters.width = 200;
+		parameters.height = 300;
+		parameters.fluid_depth = 10;
+
+		IncompressibleSimulation simulation(glm::ivec2(parameters.width, parameters.height), parameters.particle_size, 1, 0, 9.81f, &io, 1E-3f);
+		createSimulationScenario(simulation, SimulationScenario::breakingDam, parameters.fluid_depth);
+		FrameController frameController(parameters.timeStep, 2, 0);
+		for (int frame = 0; frame < 5; ++frame)
+		{
+			frameController.advanceFrame(simulation);
+		}
+		{
+			// the writer finishes the checkpoint when it is deleted
+			CheckpointWriter writer(fileName, parameters);
+			EXPECT_TRUE(writer.write(simulation, frameController, 5));
+		}
+		for (int frame = 0; frame < 5; ++frame)
+		{
+			frameController.advanceFrame(simulation);
+		}
+
+		CheckpointReader reader(fileName);
+		ASSERT_TRUE(reader.isOpen());
+		EXPECT_EQ(reader.getPictures(), 5);
+		EXPECT_EQ(reader.getParameters().height, parameters.height);
+		IncompressibleSimulation resumed(glm::ivec2(parameters.width, parameters.height), parameters.particle_size, 1, 0, 9.81f, &io, 1E-3f);
+		createSimulationScenario(resumed, SimulationScenario::breakingDam, parameters.fluid_depth);
+		FrameController resumedController(parameters.timeStep, 2, 0);
+		ASSERT_TRUE(reader.restore(resumed, resumedController));
+		EXPECT_EQ(resumedController.getSteps(), 10);
+		for (int frame = 0; frame < 5; ++frame)
+		{
+			resumedController.advanceFrame(resumed);
+		}
+
+		EXPECT_EQ(resumedController.getSteps(), frameController.getSteps());
+		EXPECT_EQ(resumedController.getSimulatedTime(), frameController.getSimulatedTime());
+		const std::vector<Particle>& expected = simulation.getParticles();
+		const std::vector<Particle>& particles = resumed.getParticles();
+		ASSERT_EQ(particles.size(), expected.size());
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			EXPECT_EQ(particles[i].id, expected[i].id);
+			EXPECT_EQ(particles[i].position, expected[i].position);
+			EXPECT_EQ(particles[i].velocity, expected[i].velocity);
+			EXPECT_EQ(particles[i].density, expected[i].density);
+		}
+	}
+	std::filesystem::remove_all(folder);
+}
+
+// average compression of the fluid particles relative to the rest density, the density error which the pressure solvers correct
+template <typename Simulation>
+float averageCompression(const Simulation& simulation)
+{
+	float compression = 0;
+	int count = 0;
+	for (auto& particle : simulation.getParticles())
+	{
+		if (!particle.boundary)
+		{
+			compression += glm::max(particle.density / simulation.getFluidDensity() - 1, 0.f);
+			++count;
+		}
+	}
+	return compression / count;
+}
+
+TEST(SolverTest, PredictiveCorrectiveTest)
+{
+	// the predict-correct iterations reach the desired density error before the largest number of iterations in every step,
+	// the fluid at rest stays at the rest density
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationSolverTest";
+	std::filesystem::create_directories(folder);
+	{
+		IO io(folder.string());
+		RunParameters parameters;
+		PredictiveCorrectiveSimulation simulation(glm::ivec2(200, 300), parameters.particle_size, 1, parameters.viscosity, 9.81f, &io,
+			parameters.max_error, parameters.min_iterations, parameters.max_iterations);
+		createSimulationScenario(simulation, SimulationScenario::restingFluid, 10);
+		for (int step = 0; step < 200; ++step)
+		{
+			simulation.performSimulationStep(parameters.timeStep);
+			EXPECT_GE(simulation.getLastSolverIterations(), parameters.min_iterations);
+			EXPECT_LT(simulation.getLastSolverIterations(), parameters.max_iterations) << "step " << step;
+			// the densities of the step are computed at the positions which the previous pressure solve corrected
+			EXPECT_LT(averageCompression(simulation), parameters.max_error) << "step " << step;
+		}
+		EXPECT_LT(simulation.getMaxSpeed(), parameters.particle_size);
+	}
+	std::filesystem::remove_all(folder);
+}
+
+TEST(SolverTest, PositionBasedTest)
+{
+	// Jacobi iterations don't project exactly onto the density constraints, but a resting fluid is compressed by less than
+	// the desired density error after the default number of iterations in every step, and more iterations compress it less
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationSolverTest";
+	std::filesystem::create_directories(folder);
+	{
+		IO io(folder.string());
+		RunParameters parameters;
+		float largestCompression[2] = {};
+		const int iterations[2] = { 5, parameters.max_iterations };
+		for (int run = 0; run < 2; ++run)
+		{
+			PositionBasedSimulation simulation(glm::ivec2(200, 300), parameters.particle_size, 1, parameters.viscosity, 9.81f, &io, iterations[run]);
+			createSimulationScenario(simulation, SimulationScenario::restingFluid, 10);
+			EXPECT_EQ(simulation.getIterations(), iterations[run]);
+			for (int step = 0; step < 200; ++step)
+			{
+				// the densities are computed at the corrected positions after the last iteration
+				simulation.performSimulationStep(parameters.timeStep);
+				for (auto& particle : simulation.getParticles())
+				{
+					if (!particle.boundary)
+					{
+						largestCompression[run] = glm::max(largestCompression[run], particle.density / simulation.getFluidDensity() - 1);
+					}
+				}
+			}
+			EXPECT_LT(simulation.getMaxSpeed(), parameters.particle_size);
+		}
+		EXPECT_LT(largestCompression[1], parameters.max_error);
+		EXPECT_LT(largestCompression[1], largestCompression[0]);
+	}
+	std::filesystem::remove_all(folder);
+}
+
+TEST(SolverTest, ImplicitViscosityTest)
+{
+	// For a small time step the implicit viscosity integration changes the velocities like the explicit one. The shear flow fills
+	// a periodic space, so all particles have the same density, which the implicit integration averages between the neighbors.
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationSolverTest";
+	std::filesystem::create_directories(folder);
+	{
+		IO io(folder.string());
+		// the viscosity changes the velocities by about a thousandth in the step, the difference of both integrations is of second order
+		const float viscosity = 2000;
+		const float maxError = 1E-5f;
+		const int maxIterations = 100;
+		const float timeStep = 1E-3f;
+		std::vector<Particle> results[2];
+		std::vector<Particle> initial;
+		for (int run = 0; run < 2; ++run)
+		{
+			// without gravity and pressure the velocities only change by the viscosity
+			Simulation simulation(glm::ivec2(200, 200), 10, 1, viscosity, 0, &io);
+			simulation.setPeriodic(0);
+			simulation.setPeriodic(1);
+			simulation.setViscosityMethod(run == 0 ? ViscosityComputationMethod::explicitIntegration : ViscosityComputationMethod::implicitIntegration,
+				maxError, maxIterations);
+			for (int y = 5; y < 200; y += 10)
+			{
+				for (int x = 5; x < 200; x += 10)
+				{
+					Particle particle = { glm::vec2(x, y), glm::vec3(0.5f), false };
+					particle.velocity = glm::vec2(20 * std::sin(2 * glm::pi<float>() * y / 100), 0);
+					simulation.addParticle(particle);
+				}
+			}
+			initial = simulation.getParticles();
+			simulation.performSimulationStep(timeStep);
+			results[run] = simulation.getParticles();
+			if (run == 1)
+			{
+				EXPECT_GT(simulation.getLastViscosityIterations(), 0);
+				EXPECT_LT(simulation.getLastViscosityIterations(), maxIterations);
+			}
+		}
+
+		float largestChange = 0;
+		float largestDifference = 0;
+		for (unsigned int i = 0; i < initial.size(); ++i)
+		{
+			largestChange = glm::max(largestChange, glm::length(results[0][i].velocity - initial[i].velocity));
+			largestDifference = glm::max(largestDifference, glm::length(results[1][i].velocity - results[0][i].velocity));
+		}
+		EXPECT_GT(largestChange, 0);
+		EXPECT_LT(largestDifference, 0.01f * largestChange);
+	}
+	std::filesystem::remove_all(folder);
+}
+
+TEST(PeriodicTest, NeighborTest)
+{
+	// along a periodic axis particles find their neighbors across the boundary at the shortest distance. The sizes aren't multiples
+	// of the cell width, in the small spaces the cells of a periodic axis are all searched, in the large one only the nearby cells
+	const glm::ivec2 sizes[] = { glm::ivec2(55, 60), glm::ivec2(95, 60), glm::ivec2(310, 130) };
+	for (const glm::ivec2& size : sizes)
+	{
+		const bool periodicY = size.y > 100;
+		Simulation simulation(size, 10, 1, 0, 9.81f, nullptr);
+		simulation.setPeriodic(0);
+		simulation.setPeriodic(1, periodicY);
+		// two particles on opposite sides of the periodic axis, 4 apart across the boundary
+		simulation.addParticle(glm::vec2(2, 30), glm::vec3(0.5f), false);
+		simulation.addParticle(glm::vec2(size.x - 2, 30), glm::vec3(0.5f), false);
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> x(0, float(size.x));
+		std::uniform_real_distribution<float> y(0, float(size.y));
+		for (int i = 0; i < 300; ++i)
+		{
+			simulation.addParticle(glm::vec2(x(random), y(random)), glm::vec3(0.5f), false);
+		}
+		const std::vector<Particle>& particles = simulation.getParticles();
+		ParticleUniformGrid grid(simulation.getKernelSupport(), size);
+		grid.initializeGrid(particles);
+
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			std::vector<unsigned int> neighbors = simulation.getNeighbors(i, grid);
+			if (i < 2)
+			{
+				EXPECT_NE(std::find(neighbors.begin(), neighbors.end(), 1 - i), neighbors.end());
+			}
+			for (unsigned int j = 0; j < particles.size(); ++j)
+			{
+				glm::vec2 difference = particles[i].position - particles[j].position;
+				difference.x -= size.x * glm::round(difference.x / size.x);
+				if (periodicY)
+				{
+					difference.y -= size.y * glm::round(difference.y / size.y);
+				}
+				const bool neighbor = std::find(neighbors.begin(), neighbors.end(), j) != neighbors.end();
+				EXPECT_EQ(neighbor, glm::length(difference) < simulation.getKernelSupport()) << "size " << size.x << " particles " << i << " and " << j;
+			}
+			EXPECT_EQ(std::set<unsigned int>(neighbors.begin(), neighbors.end()).size(), neighbors.size());
+		}
+	}
+}
+
+// fluid particles moving on a circle and one boundary particle, the particles are stored in a different order in each frame
+std::vector<Particle> movingParticles(int frame, float particleSize)
+{
+	std::vector<Particle> particles;
+	for (unsigned int id = 0; id < 20; ++id)
+	{
+		const float angle = 0.3f * id + 0.05f * frame;
+		Particle particle;
+		particle.position = glm::vec2(100, 80) + glm::vec2(std::cos(angle), std::sin(angle)) * (10.f + 3.7f * id);
+		particle.velocity = glm::vec2(-std::sin(angle), std::cos(angle)) * (13.f + 0.9f * id * frame);
+		particle.density = 1.f + 0.01f * id;
+		particle.pressure = 0.5f * frame;
+		particle.boundary = false;
+		particle.size = particleSize;
+		particle.id = id;
+		particles.push_back(particle);
+	}
+	std::rotate(particles.begin(), particles.begin() + frame % particles.size(), particles.end());
+	Particle boundary;
+	boundary.position = glm::vec2(0, 0);
+	boundary.boundary = true;
+	boundary.id = 1000;
+	particles.insert(particles.begin() + 5, boundary);
+	return particles;
+}
+
+// check a snapshot frame against the fluid particles it was written from
+void expectSnapshotFrame(const SnapshotReader& reader, int frame, const std::vector<Particle>& particles)
+{
+	const SnapshotFrame snapshot = reader.getFrame(frame);
+	EXPECT_EQ(snapshot.time, 0.25 * frame);
+	ASSERT_EQ(snapshot.particleCount, 20u);
+	const glm::vec2* positions = reader.getPositions<2, float>(snapshot);
+	const glm::vec2* velocities = reader.getVelocities<2, float>(snapshot);
+	const float* densities = reader.getDensities<float>(snapshot);
+	const float* pressures = reader.getPressures<float>(snapshot);
+	ASSERT_NE(positions, nullptr);
+	ASSERT_NE(velocities, nullptr);
+	ASSERT_NE(densities, nullptr);
+	ASSERT_NE(pressures, nullptr);
+	EXPECT_EQ((reader.getPositions<2, double>(snapshot)), nullptr);
+	EXPECT_EQ((reader.getPositions<3, float>(snapshot)), nullptr);
+	unsigned int i = 0;
+	for (const Particle& particle : particles)
+	{
+		if (particle.boundary)
+		{
+			continue;
+		}
+		EXPECT_EQ(snapshot.ids[i], particle.id);
+		EXPECT_EQ(positions[i], particle.position);
+		EXPECT_EQ(velocities[i], particle.velocity);
+		EXPECT_EQ(densities[i], particle.density);
+		EXPECT_EQ(pressures[i], particle.pressure);
+		++i;
+	}
+}
+
+TEST(SnapshotTest, RoundTripTest)
+{
+	// the frames read through the mapping are the written fluid particles, with and without the index of the file
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationSnapshotTest";
+	std::filesystem::create_directories(folder);
+	const std::string fileName = (folder / "snapshots.flsn").string();
+	{
+		SnapshotWriter writer(fileName);
+		for (int frame = 0; frame < 3; ++frame)
+		{
+			EXPECT_TRUE(writer.writeFrame(movingParticles(frame, 2.f), 0.25 * frame));
+		}
+		EXPECT_EQ(writer.getFrames(), 3);
+		std::vector<BasicParticle<3>> volume(1);
+		EXPECT_FALSE(writer.writeFrame(volume, 1.0));
+	}
+	{
+		SnapshotReader reader(fileName);
+		ASSERT_TRUE(reader.isOpen());
+		EXPECT_EQ(reader.getDimensions(), 2);
+		EXPECT_EQ(reader.getScalarSize(), int(sizeof(float)));
+		ASSERT_EQ(reader.getFrames(), 3);
+		for (int frame = 2; frame >= 0; --frame)
+		{
+			expectSnapshotFrame(reader, frame, movingParticles(frame, 2.f));
+		}
+		EXPECT_EQ(reader.getFrame(3).particleCount, 0u);
+		EXPECT_EQ(reader.getFrame(-1).particleCount, 0u);
+	}
+
+	// a killed run leaves a file without the index and the footer, 16 bytes, and the last frame may be incomplete
+	const uintmax_t indexSize = 3 * sizeof(uint64_t) + 16;
+	std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - indexSize);
+	{
+		SnapshotReader reader(fileName);
+		ASSERT_TRUE(reader.isOpen());
+		ASSERT_EQ(reader.getFrames(), 3);
+		expectSnapshotFrame(reader, 2, movingParticles(2, 2.f));
+	}
+	std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - 8);
+	{
+		SnapshotReader reader(fileName);
+		ASSERT_TRUE(reader.isOpen());
+		ASSERT_EQ(reader.getFrames(), 2);
+		for (int frame = 0; frame < 2; ++frame)
+		{
+			expectSnapshotFrame(reader, frame, movingParticles(frame, 2.f));
+		}
+	}
+	std::filesystem::remove_all(folder);
+}
+
+TEST(TrajectoryTest, ErrorBoundTest)
+{
+	// each axis of a decoded position and velocity is within the error bound, also after a keyframe and when a frame is read out of order
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationTrajectoryTest";
+	std::filesystem::create_directories(folder);
+	const std::string fileName = (folder / "trajectory.fltr").string();
+	const float particleSize = 2.f;
+	const double positionError = 0.02;
+	const double velocityError = 0.1;
+	const int frames = 7;
+	{
+		TrajectoryWriter writer(fileName, particleSize, positionError, velocityError, 3);
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			EXPECT_TRUE(writer.writeFrame(movingParticles(frame, particleSize), 0.25 * frame));
+		}
+		EXPECT_EQ(writer.getFrames(), frames);
+	}
+
+	TrajectoryReader reader(fileName);
+	ASSERT_TRUE(reader.isOpen());
+	EXPECT_EQ(reader.getDimensions(), 2);
+	EXPECT_EQ(reader.getKeyframeInterval(), 3);
+	ASSERT_EQ(reader.getFrames(), frames);
+	EXPECT_NEAR(reader.getPositionError(), positionError * particleSize, 1E-12);
+	EXPECT_NEAR(reader.getVelocityError(), velocityError * particleSize, 1E-12);
+	// the frames in order, then frames in the middle of a keyframe interval without the frames before them
+	const int order[] = { 0, 1, 2, 3, 4, 5, 6, 5, 1, 4 };
+	for (int frame : order)
+	{
+		TrajectoryFrame decoded;
+		ASSERT_TRUE(reader.readFrame(frame, decoded));
+		EXPECT_EQ(decoded.time, 0.25 * frame);
+		std::vector<Particle> particles = movingParticles(frame, particleSize);
+		particles.erase(std::remove_if(particles.begin(), particles.end(), [](const Particle& particle) { return particle.boundary; }), particles.end());
+		std::sort(particles.begin(), particles.end(), [](const Particle& a, const Particle& b) { return a.id < b.id; });
+		ASSERT_EQ(decoded.ids.size(), particles.size());
+		for (unsigned int i = 0; i < particles.size(); ++i)
+		{
+			EXPECT_EQ(decoded.ids[i], particles[i].id);
+			for (int axis = 0; axis < 2; ++axis)
+			{
+				EXPECT_LE(std::abs(decoded.positions[i * 2 + axis] - particles[i].position[axis]), positionError * particleSize + 1E-9);
+				EXPECT_LE(std::abs(decoded.velocities[i * 2 + axis] - particles[i].velocity[axis]), velocityError * particleSize + 1E-9);
+			}
+		}
+	}
+	TrajectoryFrame decoded;
+	EXPECT_FALSE(reader.readFrame(frames, decoded));
+	std::filesystem::remove_all(folder);
+}
+
+TEST(ConfigurationTest, ParseTest)
+{
+	// a configuration file with the flags of the command line after it, as given to the program
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationConfigurationTest";
+	std::filesystem::create_directories(folder);
+	const std::string fileName = (folder / "run.cfg").string();
+	{
+		std::ofstream file(fileName);
+		file << "# a narrow tank" << std::endl;
+		file << std::endl;
+		file << "  scenario = resting_fluid" << std::endl;
+		file << "method=position_based" << std::endl;
+		file << "width = 300\r" << std::endl;
+		file << "particle_size = 4" << std::endl;
+		file << "time_step = 0.005" << std::endl;
+		file << "adaptive_time_step = no" << std::endl;
+		file << "frame_encoding = 3" << std::endl;
+		file << "metrics_format = binary" << std::endl;
+	}
+	RunParameters parameters;
+	ASSERT_TRUE(loadRunConfiguration(fileName, parameters));
+	EXPECT_TRUE(setRunParameter(parameters, "width", "320"));
+	EXPECT_TRUE(setRunParameter(parameters, "max_iterations", "7"));
+	ASSERT_TRUE(validateRunParameters(parameters));
+
+	RunParameters defaults;
+	EXPECT_EQ(parameters.scenario, SimulationScenario::restingFluid);
+	EXPECT_EQ(parameters.method, PressureComputationMethod::positionBased);
+	EXPECT_EQ(parameters.width, 320);
+	EXPECT_EQ(parameters.height, defaults.height);
+	EXPECT_EQ(parameters.particle_size, 4.f);
+	EXPECT_EQ(parameters.timeStep, 0.005f);
+	EXPECT_FALSE(parameters.adaptive_time_step);
+	EXPECT_EQ(parameters.frame_encoding, FrameEncoding::qoi);
+	EXPECT_EQ(parameters.metrics_format, MetricsFormat::binary);
+	EXPECT_EQ(parameters.max_iterations, 7);
+	// the parameters which follow from others
+	EXPECT_EQ(parameters.min_iterations, 7);
+	EXPECT_EQ(parameters.min_time_step, 0.005f);
+	EXPECT_EQ(parameters.max_time_step, 0.005f);
+
+	// every invalid line is reported, the valid lines are still read
+	{
+		std::ofstream file(fileName);
+		file << "width = 250" << std::endl;
+		file << "width 260" << std::endl;
+		file << "unknown = 1" << std::endl;
+		file << "method = implicit" << std::endl;
+		file << "height = 12.5" << std::endl;
+	}
+	RunParameters invalid;
+	EXPECT_FALSE(loadRunConfiguration(fileName, invalid));
+	EXPECT_EQ(invalid.width, 250);
+	EXPECT_EQ(invalid.method, defaults.method);
+	EXPECT_EQ(invalid.height, defaults.height);
+	EXPECT_FALSE(loadRunConfiguration((folder / "missing.cfg").string(), invalid));
+	EXPECT_FALSE(isRunParameter("timeStep"));
+	EXPECT_TRUE(isRunParameter("time_step"));
+
+	// combinations which the solvers can't simulate
+	RunParameters sleeping;
+	EXPECT_TRUE(setRunParameter(sleeping, "sleeping", "true"));
+	EXPECT_FALSE(validateRunParameters(sleeping));
+	EXPECT_TRUE(setRunParameter(sleeping, "method", "compressible"));
+	EXPECT_TRUE(validateRunParameters(sleeping));
+	RunParameters deep;
+	EXPECT_TRUE(setRunParameter(deep, "fluid_depth", "100"));
+	EXPECT_FALSE(validateRunParameters(deep));
+	std::filesystem::remove_all(folder);
+}
+
+TEST(ConfigurationTest, RoundTripTest)
+{
+	// a written configuration is read as the same parameters
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationConfigurationTest";
+	std::filesystem::create_directories(folder);
+	const std::string fileName = (folder / "run.cfg").string();
+	RunParameters parameters;
+	parameters.scenario = SimulationScenario::periodicChannel;
+	parameters.width = 513;
+	parameters.particle_size = 0.1f;
+	parameters.method = PressureComputationMethod::compressible;
+	parameters.max_error = 3.3E-4f;
+	parameters.stiffness = 123456.7f;
+	parameters.timeStep = 1.f / 3;
+	parameters.sleeping = true;
+	parameters.multirate_levels = 3;
+	parameters.boundary_method = BoundaryHandlingMethod::shapes;
+	parameters.frame_format = FrameOutputFormat::none;
+	parameters.trajectory_position_error = 0.0125f;
+	parameters.metrics_format = MetricsFormat::binary;
+	parameters.checkpoint_interval = 25;
+	{
+		std::ofstream file(fileName);
+		writeRunConfiguration(file, parameters);
+	}
+	RunParameters loaded;
+	ASSERT_TRUE(loadRunConfiguration(fileName, loaded));
+	EXPECT_EQ(loaded.scenario, parameters.scenario);
+	EXPECT_EQ(loaded.width, parameters.width);
+	EXPECT_EQ(loaded.particle_size, parameters.particle_size);
+	EXPECT_EQ(loaded.method, parameters.method);
+	EXPECT_EQ(loaded.max_error, parameters.max_error);
+	EXPECT_EQ(loaded.stiffness, parameters.stiffness);
+	EXPECT_EQ(loaded.timeStep, parameters.timeStep);
+	EXPECT_EQ(loaded.sleeping, parameters.sleeping);
+	EXPECT_EQ(loaded.multirate_levels, parameters.multirate_levels);
+	EXPECT_EQ(loaded.boundary_method, parameters.boundary_method);
+	EXPECT_EQ(loaded.frame_format, parameters.frame_format);
+	EXPECT_EQ(loaded.trajectory_position_error, parameters.trajectory_position_error);
+	EXPECT_EQ(loaded.metrics_format, parameters.metrics_format);
+	EXPECT_EQ(loaded.checkpoint_interval, parameters.checkpoint_interval);
+
+	// all other parameters as well
+	std::ostringstream written;
+	std::ostringstream rewritten;
+	writeRunConfiguration(written, parameters);
+	writeRunConfiguration(rewritten, loaded);
+	EXPECT_EQ(rewritten.str(), written.str());
+	std::filesystem::remove_all(folder);
+}
+
+// a picture as read from the window, BGR with the lowest row first, with long runs, small and large steps and repeated colors
+std::vector<char> testPicture(int width, int height)
+{
+	std::vector<char> picture(size_t(width) * height * 3);
+	std::mt19937 random(3);
+	const unsigned char palette[4][3] = { { 10, 200, 30 }, { 255, 255, 255 }, { 0, 0, 0 }, { 90, 17, 240 } };
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			unsigned char* pixel = reinterpret_cast<unsigned char*>(picture.data()) + (size_t(y) * width + x) * 3;
+			unsigned char bgr[3];
+			switch (y % 4)
+			{
+			case 0:
+				// a run longer than a packet, then another color
+				bgr[0] = bgr[1] = bgr[2] = x < width - 20 ? 70 : 71;
+				break;
+			case 1:
+				// small and medium steps between the neighbors
+				bgr[0] = (unsigned char)(x / 2);
+				bgr[1] = (unsigned char)(x * 3);
+				bgr[2] = (unsigned char)(x * 7 + (x % 3));
+				break;
+			case 2:
+				// colors which were seen before
+				std::memcpy(bgr, palette[(x / 3) % 4], 3);
+				break;
+			default:
+				for (int channel = 0; channel < 3; ++channel)
+				{
+					bgr[channel] = (unsigned char)(random() % 256);
+				}
+				break;
+			}
+			std::memcpy(pixel, bgr, 3);
+		}
+	}
+	return picture;
+}
+
+// decode a run-length encoded TGA into the layout of the picture it was encoded from, empty if the packets are invalid
+std::vector<char> decodeRleTga(const std::vector<char>& file, int& width, int& height)
+{
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+	if (file.size() < 18 || data[2] != 10 || data[16] != 24)
+	{
+		return {};
+	}
+	width = data[12] | (data[13] << 8);
+	height = data[14] | (data[15] << 8);
+	std::vector<char> picture;
+	size_t position = 18;
+	for (int y = 0; y < height; ++y)
+	{
+		// the packets of the encoder don't cross rows
+		int x = 0;
+		while (x < width)
+		{
+			if (position >= file.size())
+			{
+				return {};
+			}
+			const unsigned char header = data[position++];
+			const int count = (header & 0x7F) + 1;
+			const bool run = (header & 0x80) != 0;
+			if (x + count > width || position + (run ? 3 : 3 * size_t(count)) > file.size())
+			{
+				return {};
+			}
+			for (int i = 0; i < count; ++i)
+			{
+				picture.insert(picture.end(), file.begin() + position, file.begin() + position + 3);
+				position += run ? 0 : 3;
+			}
+			position += run ? 3 : 0;
+			x += count;
+		}
+	}
+	return position == file.size() ? picture : std::vector<char>();
+}
+
+// decode a QOI image with three channels into the layout of the picture it was encoded from, empty if the image is invalid
+std::vector<char> decodeQoi(const std::vector<char>& file, int& width, int& height)
+{
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+	const unsigned char end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	if (file.size() < 22 || std::memcmp(data, "qoif", 4) != 0 || data[12] != 3 || std::memcmp(data + file.size() - 8, end, 8) != 0)
+	{
+		return {};
+	}
+	auto readBigEndian = [&](size_t position) { return int((data[position] << 24) | (data[position + 1] << 16) | (data[position + 2] << 8) | data[position + 3]); };
+	width = readBigEndian(4);
+	height = readBigEndian(8);
+
+	std::vector<char> picture(size_t(width) * height * 3);
+	unsigned char seen[64][4] = {};
+	unsigned char pixel[4] = { 0, 0, 0, 255 };
+	size_t position = 14;
+	int run = 0;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			if (run > 0)
+			{
+				--run;
+			}
+			else
+			{
+				if (position >= file.size() - 8)
+				{
+					return {};
+				}
+				const unsigned char tag = data[position++];
+				if (tag == 0xFE)
+				{
+					std::memcpy(pixel, data + position, 3);
+					position += 3;
+				}
+				else if (tag == 0xFF)
+				{
+					std::memcpy(pixel, data + position, 4);
+					position += 4;
+				}
+				else if ((tag & 0xC0) == 0x00)
+				{
+					std::memcpy(pixel, seen[tag], 4);
+				}
+				else if ((tag & 0xC0) == 0x40)
+				{
+					pixel[0] += ((tag >> 4) & 3) - 2;
+					pixel[1] += ((tag >> 2) & 3) - 2;
+					pixel[2] += (tag & 3) - 2;
+				}
+				else if ((tag & 0xC0) == 0x80)
+				{
+					const int dg = (tag & 0x3F) - 32;
+					const unsigned char next = data[position++];
+					pixel[0] += dg + ((next >> 4) & 0x0F) - 8;
+					pixel[1] += dg;
+					pixel[2] += dg + (next & 0x0F) - 8;
+				}
+				else
+				{
+					run = tag & 0x3F;
+				}
+				std::memcpy(seen[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+			}
+			// QOI stores RGB with the highest row first
+			char* destination = picture.data() + (size_t(height - 1 - y) * width + x) * 3;
+			destination[0] = char(pixel[2]);
+			destination[1] = char(pixel[1]);
+			destination[2] = char(pixel[0]);
+		}
+	}
+	return position == file.size() - 8 && run == 0 ? picture : std::vector<char>();
+}
+
+TEST(FrameEncoderTest, RoundTripTest)
+{
+	// the lossless encoders give the picture back exactly, also for widths which end a packet in the middle of a row
+	const FrameEncoding encodings[] = { FrameEncoding::rleTga, FrameEncoding::qoi };
+	for (FrameEncoding encoding : encodings)
+	{
+		std::unique_ptr<FrameEncoder> encoder = FrameEncoder::create(encoding);
+		ASSERT_NE(encoder, nullptr);
+		EXPECT_EQ(encoder->getExtension(), encoding == FrameEncoding::qoi ? "qoi" : "tga");
+		const glm::ivec2 sizes[] = { glm::ivec2(300, 9), glm::ivec2(1, 1), glm::ivec2(129, 4) };
+		for (const glm::ivec2& size : sizes)
+		{
+			const std::vector<char> picture = testPicture(size.x, size.y);
+			std::vector<char> file;
+			encoder->encode(picture.data(), size.x, size.y, file);
+			int width = 0;
+			int height = 0;
+			const std::vector<char> decoded = encoding == FrameEncoding::qoi ? decodeQoi(file, width, height) : decodeRleTga(file, width, height);
+			EXPECT_EQ(width, size.x);
+			EXPECT_EQ(height, size.y);
+			EXPECT_TRUE(decoded == picture) << encoder->getExtension() << " " << size.x << "x" << size.y;
+		}
+	}
+}
+
+TEST(MetricsTest, BinaryTest)
+{
+	// the rows recorded by several threads are all written, each row in one piece and the rows of a thread in their order
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationMetricsTest";
+	std::filesystem::create_directories(folder);
+	const int threads = 4;
+	const int rows = 5000;
+	{
+		MetricsSink sink(folder.string(), MetricsFormat::binary, std::chrono::milliseconds(5));
+		const int handle = sink.addSeries("werte", { "Thread", "Schritt" });
+		EXPECT_EQ(sink.addSeries("andere", { "Wert" }), handle + 1);
+		EXPECT_EQ(sink.addSeries("werte", { "ignoriert" }), handle);
+		std::vector<std::thread> recorders;
+		for (int thread = 0; thread < threads; ++thread)
+		{
+			recorders.emplace_back([&sink, handle, thread]()
+			{
+				for (int row = 0; row < rows; ++row)
+				{
+					sink.record(handle, { double(thread), double(row) });
+				}
+			});
+		}
+		for (auto& recorder : recorders)
+		{
+			recorder.join();
+		}
+		// a row with the wrong number of values is rejected
+		sink.record(handle, { 1.0 });
+		sink.record(handle + 1, std::vector<double>{ 0.5 });
+		sink.flush();
+		EXPECT_EQ(sink.getRecordedRows(), threads * rows + 1);
+	}
+
+	std::ifstream file((folder / "werte.flmt").string(), std::ios_base::binary);
+	ASSERT_TRUE(file.is_open());
+	char magic[4];
+	uint32_t header[2];
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	EXPECT_EQ(std::string(magic, 4), "FLMT");
+	EXPECT_EQ(header[0], 1u);
+	EXPECT_EQ(header[1], 2u);
+	std::string column;
+	std::getline(file, column, '\0');
+	EXPECT_EQ(column, "Thread");
+	std::getline(file, column, '\0');
+	EXPECT_EQ(column, "Schritt");
+
+	std::vector<int> nextRow(threads, 0);
+	uint32_t blockHeader[2];
+	while (file.read(reinterpret_cast<char*>(blockHeader), sizeof(blockHeader)))
+	{
+		// the values of a block are stored column after column
+		std::vector<double> block(size_t(blockHeader[0]) * 2);
+		ASSERT_TRUE(file.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(double)));
+		for (uint32_t row = 0; row < blockHeader[0]; ++row)
+		{
+			const int thread = int(block[row]);
+			ASSERT_TRUE(thread >= 0 && thread < threads);
+			EXPECT_EQ(block[blockHeader[0] + row], double(nextRow[thread]));
+			++nextRow[thread];
+		}
+	}
+	EXPECT_EQ(nextRow, std::vector<int>(threads, rows));
+	file.close();
+	std::filesystem::remove_all(folder);
+}
+
+TEST(MetricsTest, TextTest)
+{
+	// a sink of a continued run appends its rows to the existing file without a second line of column names
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "FluidSimulationMetricsTest";
+	std::filesystem::create_directories(folder);
+	for (int run = 0; run < 2; ++run)
+	{
+		MetricsSink sink(folder.string(), MetricsFormat::text);
+		const int handle = sink.addSeries("werte", { "Schritt", "Wert" });
+		for (int row = 0; row < 3; ++row)
+		{
+			sink.record(handle, { double(run * 3 + row), 0.25 * row });
+		}
+	}
+
+	std::ifstream file((folder / "werte.txt").string());
+	std::string line;
+	std::vector<std::string> lines;
+	while (std::getline(file, line))
+	{
+		lines.push_back(line);
+	}
+	const std::vector<std::string> expected = { "Schritt\tWert", "0\t0", "1\t0.25", "2\t0.5", "3\t0", "4\t0.25", "5\t0.5" };
+	EXPECT_EQ(lines, expected);
+	file.close();
+	std::filesystem::remove_all(folder);
 }
\ No newline at end of file